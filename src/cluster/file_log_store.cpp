@@ -0,0 +1,635 @@
+#include "cluster/file_log_store.h"
+#include <butil/crc32c.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <stdexcept>
+#include "common/file_util.h"
+#include "libnuraft/nuraft.hxx"
+#include "logger/logger.h"
+
+namespace vectordb {
+
+namespace {
+
+constexpr const char *SEGMENT_PREFIX = "raft_";
+constexpr const char *SEGMENT_SUFFIX = ".log";
+
+auto SegmentName(uint64_t first_index) -> std::string {
+  char name[64];
+  snprintf(name, sizeof(name), "%s%020" PRIu64 "%s", SEGMENT_PREFIX, first_index, SEGMENT_SUFFIX);
+  return name;
+}
+
+auto ParseSegmentName(const std::string &name, uint64_t *first_index) -> bool {
+  std::string prefix(SEGMENT_PREFIX);
+  std::string suffix(SEGMENT_SUFFIX);
+  if (name.size() <= prefix.size() + suffix.size() || name.compare(0, prefix.size(), prefix) != 0 ||
+      name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) {
+    return false;
+  }
+  std::string digits = name.substr(prefix.size(), name.size() - prefix.size() - suffix.size());
+  if (!std::all_of(digits.begin(), digits.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+    return false;
+  }
+  *first_index = std::stoull(digits);
+  return true;
+}
+
+auto FrameCrc(uint64_t index, uint64_t term, const char *body, size_t size) -> uint32_t {
+  uint32_t crc = butil::crc32c::Value(reinterpret_cast<const char *>(&index), sizeof(index));
+  crc = butil::crc32c::Extend(crc, reinterpret_cast<const char *>(&term), sizeof(term));
+  return butil::crc32c::Extend(crc, body, size);
+}
+
+void ReadFully(int fd, char *data, size_t size, uint64_t offset, const std::string &path) {
+  while (size > 0) {
+    ssize_t bytes = pread(fd, data, size, static_cast<off_t>(offset));
+    if (bytes < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytes <= 0) {
+      throw std::runtime_error("Failed to read raft log segment " + path + ": " +
+                               (bytes < 0 ? std::strerror(errno) : "unexpected end of file"));
+    }
+    data += bytes;
+    size -= static_cast<size_t>(bytes);
+    offset += static_cast<uint64_t>(bytes);
+  }
+}
+
+// 预分配失败(比如文件系统不支持)不影响正确性, 只是失去连续分配的好处
+void Preallocate(int fd, size_t size, const std::string &path) {
+  int ret = posix_fallocate(fd, 0, static_cast<off_t>(size));
+  if (ret != 0) {
+    global_logger->warn("Failed to preallocate raft log segment {}: {}", path, std::strerror(ret));
+  }
+}
+
+struct FrameHeader {
+  uint32_t len_;
+  uint32_t crc_;
+  uint64_t index_;
+  uint64_t term_;
+};
+static_assert(sizeof(FrameHeader) == FileLogStore::FRAME_HEADER_SIZE);
+
+auto EncodeFrame(uint64_t index, uint64_t term, nuraft::buffer &body) -> std::string {
+  const char *data = reinterpret_cast<const char *>(body.data_begin());
+  FrameHeader header{static_cast<uint32_t>(body.size()), FrameCrc(index, term, data, body.size()), index, term};
+  std::string frame(sizeof(header) + body.size(), '\0');
+  memcpy(frame.data(), &header, sizeof(header));
+  memcpy(frame.data() + sizeof(header), data, body.size());
+  return frame;
+}
+
+// 校验并解析一帧, 不完整或校验失败返回 false
+auto DecodeFrameHeader(const char *data, size_t size, FrameHeader *header) -> bool {
+  if (size < sizeof(FrameHeader)) {
+    return false;
+  }
+  memcpy(header, data, sizeof(FrameHeader));
+  if (header->len_ == 0 || header->len_ > size - sizeof(FrameHeader)) {
+    return false;
+  }
+  return FrameCrc(header->index_, header->term_, data + sizeof(FrameHeader), header->len_) == header->crc_;
+}
+
+auto DecodeEntry(const char *data, size_t size, uint64_t index, const std::string &path)
+    -> nuraft::ptr<nuraft::log_entry> {
+  FrameHeader header{};
+  if (!DecodeFrameHeader(data, size, &header) || header.index_ != index) {
+    throw std::runtime_error("Corrupted raft log entry " + std::to_string(index) + " in " + path);
+  }
+  nuraft::ptr<nuraft::buffer> body = nuraft::buffer::alloc(header.len_);
+  memcpy(body->data_begin(), data + sizeof(FrameHeader), header.len_);
+  body->pos(0);
+  return nuraft::log_entry::deserialize(*body);
+}
+
+}  // namespace
+
+FileLogStore::Segment::~Segment() {
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+FileLogStore::FileLogStore(const std::string &dir, size_t segment_bytes, ulong initial_start_index,
+                           LogFlushScheduler *scheduler)
+    : dir_(dir), segment_bytes_(segment_bytes), scheduler_(scheduler) {
+  // 段内偏移用 uint32 保存
+  if (segment_bytes_ > std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error("Raft log segment size must be less than 4GiB");
+  }
+  std::filesystem::create_directories(dir_);
+  OpenSegments();
+  if (segments_.empty()) {
+    segments_.push_back(CreateSegment(initial_start_index));
+  }
+  start_idx_ = segments_.front()->first_index_;
+  next_idx_ = segments_.back()->first_index_ + segments_.back()->offsets_.size();
+  // 打开时已经把活跃段刷过盘, 读到的日志都是持久的
+  durable_idx_ = next_idx_ - 1;
+  global_logger->info("Raft log store opened at {}: {} segments, log index [{}, {})", dir_, segments_.size(),
+                      start_idx_.load(), next_idx_.load());
+  if (scheduler_ == nullptr) {
+    flush_thread_ = std::thread(&FileLogStore::FlushLoop, this);
+  }
+}
+
+FileLogStore::~FileLogStore() { Close(); }
+
+void FileLogStore::OpenSegments() {
+  std::vector<std::pair<uint64_t, std::string>> files;
+  for (const auto &file : std::filesystem::directory_iterator(dir_)) {
+    uint64_t first_index = 0;
+    if (file.is_regular_file() && ParseSegmentName(file.path().filename().string(), &first_index)) {
+      files.emplace_back(first_index, file.path().string());
+    }
+  }
+  std::sort(files.begin(), files.end());
+
+  // 只有最后一段允许带着崩溃留下的半帧; 前面的段已经封存, 坏帧意味着已确认的日志损坏, 直接拒绝启动
+  bool prev_clean = true;
+  for (const auto &[first_index, path] : files) {
+    auto segment = std::make_shared<Segment>();
+    segment->first_index_ = first_index;
+    segment->path_ = path;
+    segment->fd_ = open(path.c_str(), O_RDWR);
+    if (segment->fd_ < 0) {
+      throw std::runtime_error("Failed to open raft log segment " + path + ": " + std::strerror(errno));
+    }
+    bool clean = LoadSegment(segment);
+    if (!segments_.empty()) {
+      const auto &prev = segments_.back();
+      if (!prev_clean) {
+        throw std::runtime_error("Corrupted raft log segment " + prev->path_ + " at offset " +
+                                 std::to_string(prev->size_) + ", followed by " + path);
+      }
+      if (prev->first_index_ + prev->offsets_.size() != first_index) {
+        // 只有 ResetLocked 建好新段、还没删完旧段时崩溃才会不连续, 其中一边是刚建的空段
+        if (!segment->offsets_.empty() && !prev->offsets_.empty()) {
+          throw std::runtime_error("Raft log segment " + path + " does not follow " + prev->path_);
+        }
+        global_logger->warn("Drop raft log segment {} left by an interrupted reset", path);
+        segment.reset();
+        std::filesystem::remove(path);
+        continue;
+      }
+    }
+    prev_clean = clean;
+    segments_.push_back(std::move(segment));
+  }
+
+  if (!segments_.empty()) {
+    // 清掉活跃段末尾可能残留的半帧, 重新预分配
+    const auto &active = segments_.back();
+    if (ftruncate(active->fd_, static_cast<off_t>(active->size_)) != 0) {
+      throw std::runtime_error("Failed to truncate raft log segment " + active->path_ + ": " + std::strerror(errno));
+    }
+    Preallocate(active->fd_, segment_bytes_, active->path_);
+    fdatasync(active->fd_);
+  }
+}
+
+auto FileLogStore::LoadSegment(const std::shared_ptr<Segment> &segment) -> bool {
+  auto file_size = static_cast<size_t>(std::filesystem::file_size(segment->path_));
+  std::string content(file_size, '\0');
+  ReadFully(segment->fd_, content.data(), content.size(), 0, segment->path_);
+  auto zeros_from = [&content](size_t offset) {
+    return std::all_of(content.begin() + static_cast<ptrdiff_t>(offset), content.end(), [](char c) { return c == 0; });
+  };
+  if (content.size() < sizeof(MAGIC) || memcmp(content.data(), MAGIC, sizeof(MAGIC)) != 0) {
+    // 创建段时写 magic 之前崩溃, 文件里只有预分配的零
+    if (!zeros_from(0)) {
+      throw std::runtime_error("Corrupted raft log segment header in " + segment->path_);
+    }
+    WriteFully(segment->fd_, MAGIC, sizeof(MAGIC), 0, segment->path_);
+    segment->size_ = sizeof(MAGIC);
+    return true;
+  }
+
+  size_t offset = sizeof(MAGIC);
+  FrameHeader header{};
+  while (DecodeFrameHeader(content.data() + offset, content.size() - offset, &header) &&
+         header.index_ == segment->first_index_ + segment->offsets_.size()) {
+    segment->offsets_.push_back(static_cast<uint32_t>(offset));
+    segment->terms_.push_back(header.term_);
+    offset += sizeof(FrameHeader) + header.len_;
+  }
+  segment->size_ = offset;
+  return zeros_from(offset);
+}
+
+auto FileLogStore::CreateSegment(ulong first_index) -> std::shared_ptr<Segment> {
+  auto segment = std::make_shared<Segment>();
+  segment->first_index_ = first_index;
+  segment->path_ = dir_ + "/" + SegmentName(first_index);
+  segment->fd_ = open(segment->path_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (segment->fd_ < 0) {
+    throw std::runtime_error("Failed to create raft log segment " + segment->path_ + ": " + std::strerror(errno));
+  }
+  Preallocate(segment->fd_, segment_bytes_, segment->path_);
+  WriteFully(segment->fd_, MAGIC, sizeof(MAGIC), 0, segment->path_);
+  segment->size_ = sizeof(MAGIC);
+  fdatasync(segment->fd_);
+  SyncDir(dir_);
+  global_logger->debug("Created raft log segment {}", segment->path_);
+  return segment;
+}
+
+void FileLogStore::SealSegment(const std::shared_ptr<Segment> &segment) {
+  // 封存的段截掉预分配的空间, 并在切换前刷盘, 之后后台线程只需要刷活跃段
+  if (ftruncate(segment->fd_, static_cast<off_t>(segment->size_)) != 0 || fsync(segment->fd_) != 0) {
+    throw std::runtime_error("Failed to seal raft log segment " + segment->path_ + ": " + std::strerror(errno));
+  }
+}
+
+void FileLogStore::RemoveSegment(const std::shared_ptr<Segment> &segment) {
+  // 正在读的线程还持有 fd, 文件内容在它们读完之前不会消失
+  std::error_code ec;
+  if (!std::filesystem::remove(segment->path_, ec)) {
+    global_logger->warn("Failed to remove raft log segment {}: {}", segment->path_, ec.message());
+  }
+}
+
+auto FileLogStore::FindSegment(ulong index) const -> std::shared_ptr<Segment> {
+  auto it = std::upper_bound(segments_.begin(), segments_.end(), index,
+                             [](ulong idx, const std::shared_ptr<Segment> &s) { return idx < s->first_index_; });
+  if (it == segments_.begin()) {
+    return nullptr;
+  }
+  --it;
+  if (index - (*it)->first_index_ >= (*it)->offsets_.size()) {
+    return nullptr;
+  }
+  return *it;
+}
+
+void FileLogStore::AppendLocked(ulong index, const nuraft::ptr<nuraft::log_entry> &entry) {
+  nuraft::ptr<nuraft::buffer> body = entry->serialize();
+  std::string frame = EncodeFrame(index, entry->get_term(), *body);
+
+  auto segment = segments_.back();
+  if (!segment->offsets_.empty() && segment->size_ + frame.size() > segment_bytes_) {
+    SealSegment(segment);
+    segment = CreateSegment(index);
+    segments_.push_back(segment);
+  }
+  WriteFully(segment->fd_, frame.data(), frame.size(), segment->size_, segment->path_);
+  segment->offsets_.push_back(static_cast<uint32_t>(segment->size_));
+  segment->terms_.push_back(entry->get_term());
+  segment->size_ += frame.size();
+  next_idx_ = index + 1;
+  last_entry_ = MakeClone(entry);
+}
+
+void FileLogStore::TruncateLocked(ulong index) {
+  if (index == next_idx_) {
+    return;
+  }
+  if (index < start_idx_ || index > next_idx_) {
+    ResetLocked(index);
+    return;
+  }
+
+  ++truncate_gen_;
+  // 先从后往前删除整段, 再截断 index 所在的段; 中途崩溃留下的仍然是原日志的前缀
+  while (segments_.back()->first_index_ > index) {
+    RemoveSegment(segments_.back());
+    segments_.pop_back();
+  }
+  auto segment = segments_.back();
+  size_t pos = index - segment->first_index_;
+  segment->size_ = segment->offsets_[pos];
+  segment->offsets_.resize(pos);
+  segment->terms_.resize(pos);
+  if (ftruncate(segment->fd_, static_cast<off_t>(segment->size_)) != 0) {
+    throw std::runtime_error("Failed to truncate raft log segment " + segment->path_ + ": " + std::strerror(errno));
+  }
+  Preallocate(segment->fd_, segment_bytes_, segment->path_);
+  SyncDir(dir_);
+
+  next_idx_ = index;
+  durable_idx_ = std::min<ulong>(durable_idx_, index - 1);
+  last_entry_ = nullptr;
+}
+
+void FileLogStore::ResetLocked(ulong start_index) {
+  ++truncate_gen_;
+  // 新段先落盘再删旧段, 重启后能从文件名恢复起始位置
+  auto segment = CreateSegment(start_index);
+  for (const auto &old : segments_) {
+    if (old->path_ != segment->path_) {
+      RemoveSegment(old);
+    }
+  }
+  segments_.clear();
+  segments_.push_back(segment);
+  SyncDir(dir_);
+
+  start_idx_ = start_index;
+  next_idx_ = start_index;
+  durable_idx_ = start_index - 1;
+  last_entry_ = nullptr;
+}
+
+auto FileLogStore::MakeClone(const nuraft::ptr<nuraft::log_entry> &entry) -> nuraft::ptr<nuraft::log_entry> {
+  return nuraft::cs_new<nuraft::log_entry>(entry->get_term(), nuraft::buffer::clone(entry->get_buf()),
+                                           entry->get_val_type(), entry->get_timestamp());
+}
+
+auto FileLogStore::DummyEntry() -> nuraft::ptr<nuraft::log_entry> {
+  nuraft::ptr<nuraft::buffer> buf = nuraft::buffer::alloc(sz_ulong);
+  return nuraft::cs_new<nuraft::log_entry>(0, buf);
+}
+
+auto FileLogStore::next_slot() const -> ulong { return next_idx_; }
+
+auto FileLogStore::start_index() const -> ulong { return start_idx_; }
+
+auto FileLogStore::last_entry() const -> nuraft::ptr<nuraft::log_entry> {
+  ulong last = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (last_entry_) {
+      return MakeClone(last_entry_);
+    }
+    if (next_idx_ == start_idx_) {
+      return DummyEntry();
+    }
+    last = next_idx_ - 1;
+  }
+  auto entries = ReadEntries(last, last + 1, 0);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (next_idx_ == last + 1) {
+    last_entry_ = entries->front();
+  }
+  return MakeClone(entries->front());
+}
+
+auto FileLogStore::append(nuraft::ptr<nuraft::log_entry> &entry) -> ulong {
+  ulong idx = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    idx = next_idx_;
+    AppendLocked(idx, entry);
+  }
+  NotifyFlush();
+  return idx;
+}
+
+void FileLogStore::write_at(ulong index, nuraft::ptr<nuraft::log_entry> &entry) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    TruncateLocked(index);
+    AppendLocked(index, entry);
+  }
+  NotifyFlush();
+}
+
+auto FileLogStore::ReadEntries(ulong start, ulong end, int64_t size_hint) const
+    -> nuraft::ptr<std::vector<nuraft::ptr<nuraft::log_entry>>> {
+  auto ret = nuraft::cs_new<std::vector<nuraft::ptr<nuraft::log_entry>>>();
+  if (size_hint < 0) {
+    return ret;
+  }
+  uint64_t budget = size_hint > 0 ? static_cast<uint64_t>(size_hint) : std::numeric_limits<uint64_t>::max();
+
+  ulong idx = start;
+  while (idx < end && budget > 0) {
+    // 持锁只拷贝这一段内要读的帧偏移, pread 在锁外做
+    std::shared_ptr<Segment> segment;
+    std::vector<uint64_t> offsets;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (idx >= start_idx_ && idx < next_idx_) {
+        segment = FindSegment(idx);
+      }
+      if (segment) {
+        size_t pos = idx - segment->first_index_;
+        size_t count = std::min<size_t>(end - idx, segment->offsets_.size() - pos);
+        uint64_t base = segment->offsets_[pos];
+        for (size_t i = pos; i < pos + count; ++i) {
+          offsets.push_back(segment->offsets_[i]);
+          if (segment->EndOffset(i) - base >= budget) {
+            break;
+          }
+        }
+        offsets.push_back(segment->EndOffset(pos + offsets.size() - 1));
+      }
+    }
+    if (!segment) {
+      // 与 compact 并发时日志可能已经删掉; 不能用占位日志充数, 返回空让 nuraft 改发快照
+      global_logger->warn("Raft log entry {} not found, log index [{}, {})", idx, start_idx_.load(), next_idx_.load());
+      if (ret->empty()) {
+        return nullptr;
+      }
+      break;
+    }
+
+    std::string content(offsets.back() - offsets.front(), '\0');
+    ReadFully(segment->fd_, content.data(), content.size(), offsets.front(), segment->path_);
+    for (size_t i = 0; i + 1 < offsets.size(); ++i) {
+      ret->push_back(DecodeEntry(content.data() + (offsets[i] - offsets.front()), offsets[i + 1] - offsets[i], idx,
+                                 segment->path_));
+      ++idx;
+    }
+    budget = content.size() >= budget ? 0 : budget - content.size();
+  }
+  return ret;
+}
+
+auto FileLogStore::log_entries(ulong start, ulong end) -> nuraft::ptr<std::vector<nuraft::ptr<nuraft::log_entry>>> {
+  return ReadEntries(start, end, 0);
+}
+
+auto FileLogStore::log_entries_ext(nuraft::ulong start, nuraft::ulong end, nuraft::int64 batch_size_hint_in_bytes)
+    -> nuraft::ptr<std::vector<nuraft::ptr<nuraft::log_entry>>> {
+  return ReadEntries(start, end, batch_size_hint_in_bytes);
+}
+
+auto FileLogStore::entry_at(ulong index) -> nuraft::ptr<nuraft::log_entry> {
+  auto entries = ReadEntries(index, index + 1, 0);
+  return entries ? entries->front() : DummyEntry();
+}
+
+auto FileLogStore::term_at(ulong index) -> ulong {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (index < start_idx_ || index >= next_idx_) {
+    return 0;
+  }
+  auto segment = FindSegment(index);
+  return segment ? segment->terms_[index - segment->first_index_] : 0;
+}
+
+auto FileLogStore::pack(ulong index, nuraft::int32 cnt) -> nuraft::ptr<nuraft::buffer> {
+  auto entries = ReadEntries(index, index + cnt, 0);
+  if (!entries || entries->size() != static_cast<size_t>(cnt)) {
+    throw std::runtime_error("Raft log entries [" + std::to_string(index) + ", " + std::to_string(index + cnt) +
+                             ") are no longer available");
+  }
+  std::vector<nuraft::ptr<nuraft::buffer>> logs;
+  size_t size_total = 0;
+  for (auto &entry : *entries) {
+    nuraft::ptr<nuraft::buffer> buf = entry->serialize();
+    size_total += buf->size();
+    logs.push_back(buf);
+  }
+
+  nuraft::ptr<nuraft::buffer> buf_out =
+      nuraft::buffer::alloc(sizeof(nuraft::int32) + cnt * sizeof(nuraft::int32) + size_total);
+  buf_out->pos(0);
+  buf_out->put(cnt);
+  for (auto &buf : logs) {
+    buf_out->put(static_cast<nuraft::int32>(buf->size()));
+    buf_out->put(*buf);
+  }
+  return buf_out;
+}
+
+void FileLogStore::apply_pack(ulong index, nuraft::buffer &pack) {
+  pack.pos(0);
+  nuraft::int32 num_logs = pack.get_int();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    TruncateLocked(index);
+    for (nuraft::int32 ii = 0; ii < num_logs; ++ii) {
+      nuraft::int32 buf_size = pack.get_int();
+      nuraft::ptr<nuraft::buffer> buf_local = nuraft::buffer::alloc(buf_size);
+      pack.get(buf_local);
+      AppendLocked(index + ii, nuraft::log_entry::deserialize(*buf_local));
+    }
+  }
+  NotifyFlush();
+}
+
+auto FileLogStore::compact(ulong last_log_index) -> bool {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (last_log_index < start_idx_) {
+    return true;
+  }
+  if (last_log_index + 1 >= next_idx_) {
+    // 快照已经覆盖了全部日志
+    ResetLocked(last_log_index + 1);
+    return true;
+  }
+
+  size_t removed = 0;
+  while (segments_.size() > 1 && segments_.front()->LastIndex() <= last_log_index) {
+    RemoveSegment(segments_.front());
+    segments_.pop_front();
+    ++removed;
+  }
+  if (removed > 0) {
+    SyncDir(dir_);
+    global_logger->info("Raft log compacted up to {}, removed {} segments", last_log_index, removed);
+  }
+  // 段内 last_log_index 之前的日志物理上还在, 逻辑上不再可见
+  start_idx_ = last_log_index + 1;
+  return true;
+}
+
+auto FileLogStore::SyncActive() -> bool {
+  std::lock_guard<std::mutex> sync_lock(sync_mutex_);
+  std::shared_ptr<Segment> segment;
+  ulong target = 0;
+  uint64_t gen = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    segment = segments_.back();
+    target = next_idx_ - 1;
+    gen = truncate_gen_;
+  }
+  if (target <= durable_idx_) {
+    return true;
+  }
+  // 更早的段在封存时已经刷过盘
+  if (fdatasync(segment->fd_) != 0) {
+    global_logger->error("Failed to fdatasync raft log segment {}: {}", segment->path_, std::strerror(errno));
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (gen == truncate_gen_ && target > durable_idx_) {
+    durable_idx_ = target;
+  }
+  return true;
+}
+
+auto FileLogStore::flush() -> bool { return SyncActive(); }
+
+auto FileLogStore::last_durable_index() -> ulong { return durable_idx_; }
+
+void FileLogStore::SetRaftServer(nuraft::raft_server *raft) { raft_server_ = raft; }
+
+void FileLogStore::NotifyFlush() {
+  if (scheduler_ != nullptr) {
+    // 关闭之后不再排队, Close 从线程池移除后线程池不会再访问这个存储
+    std::lock_guard<std::mutex> lock(flush_mutex_);
+    if (!stop_) {
+      scheduler_->Schedule(this);
+    }
+    return;
+  }
+  // 持锁一下再通知, 避免刷盘线程检查完条件、还没睡下时错过唤醒
+  { std::lock_guard<std::mutex> lock(flush_mutex_); }
+  flush_cv_.notify_one();
+}
+
+auto FileLogStore::FlushPending() -> bool {
+  bool ok = SyncActive();
+  nuraft::raft_server *raft = raft_server_;
+  if (raft != nullptr) {
+    raft->notify_log_append_completion(ok);
+  }
+  return ok;
+}
+
+void FileLogStore::FlushLoop() {
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(flush_mutex_);
+      flush_cv_.wait(lock, [this] { return stop_ || next_idx_ - 1 > durable_idx_; });
+      if (stop_) {
+        break;
+      }
+    }
+    // 刷盘期间到达的日志会在下一轮一起刷掉, 形成 group commit
+    if (!FlushPending()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+  }
+}
+
+void FileLogStore::Close() {
+  {
+    std::lock_guard<std::mutex> lock(flush_mutex_);
+    if (stop_) {
+      return;
+    }
+    stop_ = true;
+  }
+  flush_cv_.notify_all();
+  if (flush_thread_.joinable()) {
+    flush_thread_.join();
+  }
+  if (scheduler_ != nullptr) {
+    scheduler_->Remove(this);
+  }
+  SyncActive();
+}
+
+auto FileLogStore::SegmentCount() const -> size_t {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return segments_.size();
+}
+
+}  // namespace vectordb
@@ -0,0 +1,106 @@
+#include "cluster/file_state_mgr.h"
+#include <butil/crc32c.h>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include "common/file_util.h"
+#include "logger/logger.h"
+
+namespace vectordb {
+
+FileStateMgr::FileStateMgr(int srv_id, const std::string &endpoint, const std::string &dir,
+                           nuraft::ptr<FileLogStore> log_store)
+    : my_id_(srv_id),
+      my_endpoint_(endpoint),
+      config_path_(dir + "/" + CONFIG_FILE_NAME),
+      state_path_(dir + "/" + STATE_FILE_NAME),
+      cur_log_store_(std::move(log_store)) {
+  std::filesystem::create_directories(dir);
+  my_srv_config_ = nuraft::cs_new<nuraft::srv_config>(srv_id, endpoint);
+
+  nuraft::ptr<nuraft::buffer> config_buf = ReadFileChecked(config_path_);
+  if (config_buf) {
+    saved_config_ = nuraft::cluster_config::deserialize(*config_buf);
+    global_logger->info("Loaded raft cluster config: log index {}, {} servers", saved_config_->get_log_idx(),
+                        saved_config_->get_servers().size());
+  } else {
+    // 第一次启动: 集群里只有自己
+    saved_config_ = nuraft::cs_new<nuraft::cluster_config>();
+    saved_config_->get_servers().push_back(my_srv_config_);
+  }
+
+  nuraft::ptr<nuraft::buffer> state_buf = ReadFileChecked(state_path_);
+  if (state_buf) {
+    saved_state_ = nuraft::srv_state::deserialize(*state_buf);
+    global_logger->info("Loaded raft server state: term {}, voted for {}", saved_state_->get_term(),
+                        saved_state_->get_voted_for());
+  }
+}
+
+auto FileStateMgr::load_config() -> nuraft::ptr<nuraft::cluster_config> {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return saved_config_;
+}
+
+void FileStateMgr::save_config(const nuraft::cluster_config &config) {
+  nuraft::ptr<nuraft::buffer> buf = config.serialize();
+  std::lock_guard<std::mutex> lock(mutex_);
+  WriteFileAtomic(config_path_, *buf);
+  saved_config_ = nuraft::cluster_config::deserialize(*buf);
+}
+
+void FileStateMgr::save_state(const nuraft::srv_state &state) {
+  nuraft::ptr<nuraft::buffer> buf = state.serialize();
+  std::lock_guard<std::mutex> lock(mutex_);
+  WriteFileAtomic(state_path_, *buf);
+  saved_state_ = nuraft::srv_state::deserialize(*buf);
+}
+
+auto FileStateMgr::read_state() -> nuraft::ptr<nuraft::srv_state> {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return saved_state_;
+}
+
+auto FileStateMgr::load_log_store() -> nuraft::ptr<nuraft::log_store> {
+  return std::static_pointer_cast<nuraft::log_store>(cur_log_store_);
+}
+
+void FileStateMgr::system_exit(int exit_code) {
+  global_logger->critical("Raft server requested system exit with code {}", exit_code);
+}
+
+void FileStateMgr::WriteFileAtomic(const std::string &path, nuraft::buffer &payload) {
+  const char *data = reinterpret_cast<const char *>(payload.data_begin());
+  uint32_t crc = butil::crc32c::Value(data, payload.size());
+  std::string content(reinterpret_cast<const char *>(&crc), sizeof(crc));
+  content.append(data, payload.size());
+
+  // 投票和任期丢失会破坏 raft 的安全性, 写失败直接抛出
+  WriteFileSync(path, content);
+}
+
+auto FileStateMgr::ReadFileChecked(const std::string &path) -> nuraft::ptr<nuraft::buffer> {
+  std::ifstream file(path, std::ios::in | std::ios::binary);
+  if (!file.is_open()) {
+    return nullptr;
+  }
+  std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  uint32_t crc = 0;
+  if (content.size() <= sizeof(crc)) {
+    throw std::runtime_error("Truncated raft state file " + path);
+  }
+  memcpy(&crc, content.data(), sizeof(crc));
+  const char *data = content.data() + sizeof(crc);
+  size_t size = content.size() - sizeof(crc);
+  if (butil::crc32c::Value(data, size) != crc) {
+    throw std::runtime_error("Corrupted raft state file " + path);
+  }
+  nuraft::ptr<nuraft::buffer> buf = nuraft::buffer::alloc(size);
+  memcpy(buf->data_begin(), data, size);
+  buf->pos(0);
+  return buf;
+}
+
+}  // namespace vectordb
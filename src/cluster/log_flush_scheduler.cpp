@@ -0,0 +1,89 @@
+#include "cluster/log_flush_scheduler.h"
+#include <algorithm>
+#include <chrono>
+#include "cluster/file_log_store.h"
+
+namespace vectordb {
+
+LogFlushScheduler::LogFlushScheduler(size_t threads) {
+  threads = std::max<size_t>(threads, 1);
+  for (size_t i = 0; i < threads; ++i) {
+    threads_.emplace_back(&LogFlushScheduler::Loop, this);
+  }
+}
+
+LogFlushScheduler::~LogFlushScheduler() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (auto &thread : threads_) {
+    thread.join();
+  }
+}
+
+void LogFlushScheduler::Schedule(FileLogStore *store) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stop_ || !pending_.insert(store).second) {
+      return;
+    }
+    // 正在刷盘的存储由刷盘线程结束后重新排队
+    if (running_.count(store) != 0) {
+      return;
+    }
+    queue_.push_back(store);
+  }
+  cv_.notify_one();
+}
+
+void LogFlushScheduler::Remove(FileLogStore *store) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_cv_.wait(lock, [this, store] { return running_.count(store) == 0; });
+  // 刷盘失败的存储可能在等待期间重新排了队
+  pending_.erase(store);
+  queue_.erase(std::remove(queue_.begin(), queue_.end(), store), queue_.end());
+}
+
+void LogFlushScheduler::Loop() {
+  while (true) {
+    FileLogStore *store = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+      if (stop_) {
+        break;
+      }
+      store = queue_.front();
+      queue_.pop_front();
+      pending_.erase(store);
+      running_.insert(store);
+    }
+
+    bool ok = store->FlushPending();
+    if (!ok) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    bool requeued = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      running_.erase(store);
+      // 刷盘失败时稍后重试, 与独立刷盘线程的行为一致
+      if (!ok) {
+        pending_.insert(store);
+      }
+      if (!stop_ && pending_.count(store) != 0) {
+        queue_.push_back(store);
+        requeued = true;
+      }
+    }
+    idle_cv_.notify_all();
+    if (requeued) {
+      cv_.notify_one();
+    }
+  }
+}
+
+}  // namespace vectordb
@@ -0,0 +1,177 @@
+#include "cluster/raft_command.h"
+#include <rapidjson/document.h>
+#include <snappy/snappy.h>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include "common/constants.h"
+#include "logger/logger.h"
+
+namespace vectordb {
+
+namespace {
+
+template <typename T>
+void AppendRaw(std::string *out, T value) {
+  out->append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+// 顺序读取 [pos_, end_) 中的字段, 越界时抛出
+struct Cursor {
+  const char *pos_;
+  const char *end_;
+
+  auto Remaining() const -> size_t { return static_cast<size_t>(end_ - pos_); }
+
+  auto Skip(size_t size) -> const char * {
+    if (Remaining() < size) {
+      throw std::runtime_error("Truncated raft log entry");
+    }
+    const char *begin = pos_;
+    pos_ += size;
+    return begin;
+  }
+
+  template <typename T>
+  auto Take() -> T {
+    T value;
+    memcpy(&value, Skip(sizeof(T)), sizeof(T));
+    return value;
+  }
+};
+
+}  // namespace
+
+auto RaftCommand::EncodeUpsert(const UpsertRecord &record) -> std::string {
+  size_t vector_bytes = record.vector_.size() * sizeof(float);
+  std::string out;
+  out.reserve(sizeof(uint8_t) + sizeof(uint64_t) + sizeof(int8_t) + sizeof(uint32_t) * 2 + vector_bytes +
+              record.attributes_.size());
+  AppendRaw<uint8_t>(&out, static_cast<uint8_t>(Op::UPSERT));
+  AppendRaw<uint64_t>(&out, record.id_);
+  AppendRaw<int8_t>(&out, static_cast<int8_t>(record.index_type_));
+  AppendRaw<uint32_t>(&out, static_cast<uint32_t>(record.vector_.size()));
+  out.append(reinterpret_cast<const char *>(record.vector_.data()), vector_bytes);
+  AppendRaw<uint32_t>(&out, static_cast<uint32_t>(record.attributes_.size()));
+  out.append(record.attributes_);
+  return out;
+}
+
+auto RaftCommand::EncodeBatch(const std::vector<std::string> &records, bool compress) -> nuraft::ptr<nuraft::buffer> {
+  size_t body_bytes = 0;
+  for (const auto &record : records) {
+    body_bytes += sizeof(uint32_t) + record.size();
+  }
+  std::string body;
+  body.reserve(body_bytes);
+  for (const auto &record : records) {
+    AppendRaw<uint32_t>(&body, static_cast<uint32_t>(record.size()));
+    body.append(record);
+  }
+
+  uint8_t flags = 0;
+  if (compress) {
+    std::string compressed;
+    snappy::Compress(body.data(), body.size(), &compressed);
+    if (compressed.size() < body.size()) {
+      body.swap(compressed);
+      flags |= FLAG_SNAPPY;
+    }
+  }
+
+  std::string header;
+  AppendRaw<int32_t>(&header, RECORD_BATCH_MARKER);
+  AppendRaw<uint8_t>(&header, flags);
+  AppendRaw<uint32_t>(&header, static_cast<uint32_t>(records.size()));
+  nuraft::ptr<nuraft::buffer> buf = nuraft::buffer::alloc(header.size() + body.size());
+  memcpy(buf->data_begin(), header.data(), header.size());
+  memcpy(buf->data_begin() + header.size(), body.data(), body.size());
+  buf->pos(0);
+  return buf;
+}
+
+auto RaftCommand::Decode(nuraft::buffer &data) -> std::vector<UpsertRecord> {
+  const char *begin = reinterpret_cast<const char *>(data.data_begin());
+  Cursor cursor{begin + data.pos(), begin + data.size()};
+  auto head = cursor.Take<int32_t>();
+  std::vector<UpsertRecord> records;
+
+  if (head == RECORD_BATCH_MARKER) {
+    auto flags = cursor.Take<uint8_t>();
+    auto count = cursor.Take<uint32_t>();
+    std::string uncompressed;
+    if ((flags & FLAG_SNAPPY) != 0) {
+      if (!snappy::Uncompress(cursor.pos_, cursor.Remaining(), &uncompressed)) {
+        throw std::runtime_error("Failed to decompress raft log entry");
+      }
+      cursor = Cursor{uncompressed.data(), uncompressed.data() + uncompressed.size()};
+    }
+    if (count > cursor.Remaining() / sizeof(uint32_t)) {
+      throw std::runtime_error("Invalid raft log entry record count");
+    }
+    records.resize(count);
+    for (auto &record : records) {
+      auto len = cursor.Take<uint32_t>();
+      const char *pos = cursor.Skip(len);
+      DecodeRecord(pos, pos + len, &record);
+    }
+    return records;
+  }
+
+  auto add_json = [&records](const char *json, size_t size) {
+    UpsertRecord record;
+    if (DecodeJson(json, size, &record)) {
+      records.push_back(std::move(record));
+    }
+  };
+  if (head != BATCH_MARKER) {
+    if (head < 0) {
+      throw std::runtime_error("Invalid raft log entry length");
+    }
+    add_json(cursor.Skip(static_cast<size_t>(head)), static_cast<size_t>(head));
+    return records;
+  }
+  auto count = cursor.Take<uint32_t>();
+  for (uint32_t i = 0; i < count; ++i) {
+    auto len = cursor.Take<uint32_t>();
+    add_json(cursor.Skip(len), len);
+  }
+  return records;
+}
+
+void RaftCommand::DecodeRecord(const char *pos, const char *end, UpsertRecord *record) {
+  Cursor cursor{pos, end};
+  auto op = cursor.Take<uint8_t>();
+  if (op != static_cast<uint8_t>(Op::UPSERT)) {
+    throw std::runtime_error("Unknown raft command op " + std::to_string(op));
+  }
+  record->id_ = cursor.Take<uint64_t>();
+  record->index_type_ = static_cast<IndexFactory::IndexType>(cursor.Take<int8_t>());
+  auto dim = cursor.Take<uint32_t>();
+  if (dim > cursor.Remaining() / sizeof(float)) {
+    throw std::runtime_error("Truncated raft log entry");
+  }
+  record->vector_.resize(dim);
+  memcpy(record->vector_.data(), cursor.Skip(dim * sizeof(float)), dim * sizeof(float));
+  auto attributes_len = cursor.Take<uint32_t>();
+  record->attributes_.assign(cursor.Skip(attributes_len), attributes_len);
+}
+
+auto RaftCommand::DecodeJson(const char *data, size_t size, UpsertRecord *record) -> bool {
+  rapidjson::Document doc;
+  doc.Parse(data, size);
+  if (doc.HasParseError() || !doc.IsObject() || !doc.HasMember(REQUEST_ID) || !doc[REQUEST_ID].IsUint64()) {
+    global_logger->error("Skip invalid JSON request in raft log");
+    return false;
+  }
+  try {
+    *record = VectorDatabase::MakeUpsertRecord(doc[REQUEST_ID].GetUint64(), doc,
+                                               VectorDatabase::GetIndexTypeFromRequest(doc));
+  } catch (const std::exception &e) {
+    global_logger->error("Skip invalid JSON request in raft log: {}", e.what());
+    return false;
+  }
+  return true;
+}
+
+}  // namespace vectordb
@@ -0,0 +1,94 @@
+#include "cluster/raft_group_manager.h"
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include "cluster/raft_logger_wrapper.h"
+#include "common/constants.h"
+#include "common/vector_cfg.h"
+#include "logger/logger.h"
+
+namespace vectordb {
+
+RaftGroupManager::~RaftGroupManager() {
+  // 先停掉所有组, 再停共用的 asio 线程池
+  groups_.clear();
+  if (asio_service_) {
+    asio_service_->stop();
+    while (asio_service_->get_active_workers() > 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+}
+
+void RaftGroupManager::Init() {
+  const Cfg &cfg = Cfg::Instance();
+  const MultiRaftCfg &multi_raft = cfg.MultiRaft();
+  std::string log_file_name = "./srv" + std::to_string(cfg.RaftNodeId()) + ".log";
+  logger_ = nuraft::cs_new<LoggerWrapper>(log_file_name);
+  nuraft::asio_service::options asio_opt;
+  asio_opt.thread_pool_size_ = multi_raft.asio_threads_;
+  asio_service_ = nuraft::cs_new<nuraft::asio_service>(asio_opt, logger_);
+  flush_scheduler_ = std::make_unique<LogFlushScheduler>(multi_raft.log_flush_threads_);
+  compact_scheduler_ = std::make_unique<TaskScheduler>(multi_raft.compact_threads_);
+  batch_scheduler_ = std::make_unique<TaskScheduler>(multi_raft.batch_threads_);
+  decode_scheduler_ = std::make_unique<TaskScheduler>(multi_raft.decode_threads_);
+
+  for (int group_id : cfg.RaftGroups()) {
+    groups_[group_id] = CreateGroup(group_id);
+    global_logger->info("Raft group {} initialized", group_id);
+  }
+}
+
+auto RaftGroupManager::Get(int group_id) const -> RaftGroup * {
+  auto it = groups_.find(group_id);
+  return it == groups_.end() ? nullptr : it->second.get();
+}
+
+auto RaftGroupManager::GroupPort(int port, int group_id) -> int {
+  int group_port = port + group_id * Cfg::Instance().MultiRaft().port_stride_;
+  if (group_port > 65535) {
+    throw std::runtime_error("Raft port of group " + std::to_string(group_id) + " exceeds 65535");
+  }
+  return group_port;
+}
+
+auto RaftGroupManager::GroupEndpoint(const std::string &endpoint, int group_id) -> std::string {
+  size_t pos = endpoint.rfind(':');
+  if (group_id == 0 || pos == std::string::npos) {
+    return endpoint;
+  }
+  int port = std::stoi(endpoint.substr(pos + 1));
+  return endpoint.substr(0, pos + 1) + std::to_string(GroupPort(port, group_id));
+}
+
+auto RaftGroupManager::CreateGroup(int group_id) -> std::unique_ptr<RaftGroup> {
+  const Cfg &cfg = Cfg::Instance();
+  auto group = std::make_unique<RaftGroup>();
+  group->group_id_ = group_id;
+
+  // 组 0 沿用原来的目录和全局索引, 只有一个组的部署升级后数据不用搬
+  IndexFactory *index_factory = nullptr;
+  if (group_id != 0) {
+    group->index_factory_ = std::make_unique<IndexFactory>(compact_scheduler_.get());
+    group->index_factory_->InitAll(DEFAULT_INDEX_DIM, DEFAULT_INDEX_CAPACITY);
+    index_factory = group->index_factory_.get();
+  }
+  group->vector_database_ = std::make_unique<VectorDatabase>(
+      Cfg::GroupPath(cfg.RocksDbPath(), group_id), Cfg::GroupPath(cfg.WalPath(), group_id), cfg.RocksDb(), index_factory,
+      Cfg::GroupPath(cfg.SnapPath(), group_id), decode_scheduler_.get());
+  group->vector_database_->ReloadDatabase();
+
+  RaftGroupOptions options;
+  options.group_id_ = group_id;
+  options.log_path_ = Cfg::GroupPath(cfg.RaftLogPath(), group_id);
+  options.asio_service_ = asio_service_;
+  options.flush_scheduler_ = flush_scheduler_.get();
+  options.batch_scheduler_ = batch_scheduler_.get();
+  options.logger_ = logger_;
+  std::string endpoint = GroupEndpoint(cfg.RaftEndpoint(), group_id);
+  group->raft_stuff_ = std::make_unique<RaftStuff>(cfg.RaftNodeId(), endpoint, GroupPort(cfg.RaftPort(), group_id),
+                                                   group->vector_database_.get(), std::move(options));
+  return group;
+}
+
+}  // namespace vectordb
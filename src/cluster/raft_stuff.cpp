@@ -1,30 +1,50 @@
 #include "cluster/raft_stuff.h"
+#include <brpc/channel.h>
+#include <brpc/controller.h>
+#include <bthread/bthread.h>
+#include <rapidjson/document.h>
 #include "cluster/raft_logger_wrapper.h"
+#include "common/constants.h"
+#include "common/vector_cfg.h"
 #include "logger/logger.h"
 
 namespace vectordb {
 
-RaftStuff::RaftStuff(int node_id, std::string &endpoint, int port, VectorDatabase *vector_database)
+RaftStuff::RaftStuff(int node_id, std::string &endpoint, int port, VectorDatabase *vector_database,
+                     RaftGroupOptions options)
     : node_id_(node_id),
       endpoint_(endpoint),
       port_(port),
+      options_(std::move(options)),
       vector_database_(vector_database) {  // 初始化 vector_database_ 指针
+  if (options_.log_path_.empty()) {
+    options_.log_path_ = Cfg::Instance().RaftLogPath();
+  }
   Init();
 }
 
+RaftStuff::~RaftStuff() {
+  batcher_.reset();
+  if (raft_instance_) {
+    raft_instance_->shutdown();
+  }
+  if (listener_) {
+    listener_->stop();
+    listener_->shutdown();
+  }
+}
+
 void RaftStuff::Init() {
-  smgr_ = nuraft::cs_new<InmemStateMgr>(node_id_, endpoint_, vector_database_);
+  // raft 日志同时是数据库的恢复日志, 状态机从快照位置开始由 raft 重新提交
+  log_store_ = nuraft::cs_new<FileLogStore>(options_.log_path_, Cfg::Instance().RaftLog().segment_bytes_,
+                                            vector_database_->GetStartIndexId() + 1, options_.flush_scheduler_);
+  // term / vote 和集群配置与日志段放在同一目录, 重启后带着原来的成员关系加入集群
+  smgr_ = nuraft::cs_new<FileStateMgr>(node_id_, endpoint_, options_.log_path_, log_store_);
   sm_ = nuraft::cs_new<LogStateMachine>();
 
-  // 将 state_machine 对象强制转换为 log_state_machine 对象
-  nuraft::ptr<LogStateMachine> log_sm = std::dynamic_pointer_cast<LogStateMachine>(sm_);
-
-  log_sm->SetVectorDatabase(
+  sm_->SetVectorDatabase(
       vector_database_);  // 将 vector_database_ 参数传递给 log_state_machine 的 setVectorDatabase 函数
 
-  nuraft::asio_service::options asio_opt;
-  asio_opt.thread_pool_size_ = 1;
-
   // nuraft::raft_params params;
   // params.election_timeout_lower_bound_ = 100000000;  // 设置为一个非常大的值
   // params.election_timeout_upper_bound_ = 200000000;  // 设置为一个非常大的值
@@ -42,27 +62,47 @@ void RaftStuff::Init() {
   params.election_timeout_lower_bound_ = 200;
   params.election_timeout_upper_bound_ = 400;
 #endif
-  // Upto 5 logs will be preserved ahead the last snapshot.
-  params.reserved_log_items_ = 5;
-  // Snapshot will be created for every 5 log appends.
-  params.snapshot_distance_ = 5;
+  // 快照之后保留一段日志, 落后不多的 follower 直接追日志, 不用传整个快照
+  params.reserved_log_items_ = static_cast<int>(Cfg::Instance().RaftLog().reserved_log_items_);
+  // 每提交 snapshot_distance_ 条日志生成一次快照, 之后日志存储按快照位置截断
+  params.snapshot_distance_ = static_cast<int>(Cfg::Instance().RaftLog().snapshot_distance_);
   // Client timeout: 3000 ms.
   params.client_req_timeout_ = 10000;
   // According to this method, `append_log` function
   // should be handled differently.
   params.return_method_ = CALL_TYPE;
+  // 日志写入页缓存后立即返回, 由日志存储的后台线程刷盘后通知 raft_server
+  params.parallel_log_appending_ = true;
 
   // Logger.
-  std::string log_file_name = "./srv" + std::to_string(node_id_) + ".log";
-  nuraft::ptr<LoggerWrapper> log_wrap = nuraft::cs_new<LoggerWrapper>(log_file_name);
-
-  raft_instance_ = launcher_.init(sm_, smgr_, log_wrap, port_, asio_opt, params);
+  nuraft::ptr<nuraft::logger> log_wrap = options_.logger_;
+  if (!log_wrap) {
+    std::string log_file_name = "./srv" + std::to_string(node_id_) + ".log";
+    log_wrap = nuraft::cs_new<LoggerWrapper>(log_file_name);
+  }
 
-  if (!raft_instance_) {
-    global_logger->error("Failed to initialize launcher (see the message in the log file)");
-    log_wrap.reset();
+  // 与 raft_launcher::init 相同, 只是 asio_service 可以由多个组共用; 每个组监听自己的端口
+  if (!options_.asio_service_) {
+    nuraft::asio_service::options asio_opt;
+    asio_opt.thread_pool_size_ = 1;
+    options_.asio_service_ = nuraft::cs_new<nuraft::asio_service>(asio_opt, log_wrap);
+  }
+  listener_ = options_.asio_service_->create_rpc_listener(static_cast<nuraft::ushort>(port_), log_wrap);
+  if (!listener_) {
+    global_logger->error("Failed to listen on raft port {} for group {}", port_, options_.group_id_);
     exit(-1);
   }
+  nuraft::ptr<nuraft::delayed_task_scheduler> scheduler = options_.asio_service_;
+  nuraft::ptr<nuraft::rpc_client_factory> rpc_cli_factory = options_.asio_service_;
+  auto *ctx = new nuraft::context(smgr_, sm_, listener_, log_wrap, rpc_cli_factory, scheduler, params);
+  raft_instance_ = nuraft::cs_new<nuraft::raft_server>(ctx);
+  listener_->listen(raft_instance_);
+  log_store_->SetRaftServer(raft_instance_.get());
+  const RaftLogCfg &log_cfg = Cfg::Instance().RaftLog();
+  batcher_ = std::make_unique<WriteBatcher>(
+      [this](nuraft::ptr<nuraft::buffer> batch, const WriteBatcher::Callback &done) { AppendBatch(batch, done); },
+      std::chrono::microseconds(log_cfg.batch_delay_us_), log_cfg.batch_max_bytes_, log_cfg.batch_max_count_,
+      log_cfg.compression_ == "snappy", options_.batch_scheduler_);
 
   // Wait until Raft server is ready (upto 5 seconds).
   const size_t max_try = 100;
@@ -70,8 +110,8 @@ void RaftStuff::Init() {
   for (size_t ii = 0; ii < max_try; ++ii) {
     if (raft_instance_->is_initialized()) {
       global_logger->info("done");
-      global_logger->debug("RaftStuff initialized with node_id: {}, endpoint: {}, port: {}", node_id_, endpoint_,
-                           port_);  // 添加打印日志
+      global_logger->debug("RaftStuff initialized with node_id: {}, endpoint: {}, port: {}, group: {}", node_id_,
+                           endpoint_, port_, options_.group_id_);  // 添加打印日志
       return;
     }
     global_logger->info(".");
@@ -83,10 +123,29 @@ void RaftStuff::Init() {
   exit(-1);
 }
 
-auto RaftStuff::AddSrv(int srv_id, const std::string &srv_endpoint) -> bool {
+auto RaftStuff::AddSrv(int srv_id, const std::string &srv_endpoint, bool learner) -> bool {
   bool success = false;
-  nuraft::ptr<nuraft::srv_config> peer_srv_conf = nuraft::cs_new<nuraft::srv_config>(srv_id, srv_endpoint);
-  global_logger->debug("Adding server with srv_id: {}, srv_endpoint: {}", srv_id, srv_endpoint);  // 添加打印日志
+  // 持久化的集群配置里已经有这个节点(比如它重启后重新加入), 它会从自己的最后一条日志增量追赶
+  auto existing = GetSrvConfig(srv_id);
+  if (existing) {
+    if (existing->get_endpoint() != srv_endpoint) {
+      global_logger->error("Server {} is already a member at a different endpoint {}", srv_id,
+                           existing->get_endpoint());
+      return false;
+    }
+    if (existing->is_learner() != learner) {
+      global_logger->error("Server {} is already a member as a {}", srv_id,
+                           existing->is_learner() ? "learner" : "voter");
+      return false;
+    }
+    global_logger->info("Server {} is already a member at {}", srv_id, srv_endpoint);
+    return true;
+  }
+
+  // learner 只接收日志, 不参与选举和提交的多数派, 增加 learner 不会拖慢写入
+  nuraft::ptr<nuraft::srv_config> peer_srv_conf =
+      nuraft::cs_new<nuraft::srv_config>(srv_id, 0, srv_endpoint, std::string(), learner);
+  global_logger->debug("Adding server with srv_id: {}, srv_endpoint: {}, learner: {}", srv_id, srv_endpoint, learner);
   auto ret = raft_instance_->add_srv(*peer_srv_conf);
 
   if (!ret->get_accepted()) {
@@ -114,7 +173,7 @@ auto RaftStuff::GetSrvConfig(int srv_id) -> nuraft::ptr<nuraft::srv_config> {
   return raft_instance_->get_srv_config(srv_id);
 }
 
-void RaftStuff::AppendEntries(const std::string &entry) {
+void RaftStuff::AppendEntriesAsync(std::string entry, WriteBatcher::Callback done) {
   if (!raft_instance_ || !raft_instance_->is_leader()) {
     // 添加调试日志
     if (!raft_instance_) {
@@ -122,33 +181,30 @@ void RaftStuff::AppendEntries(const std::string &entry) {
     } else {
       global_logger->debug("Cannot append entries: Current node is not the leader");
     }
+    WriteResult result;
+    result.code_ = nuraft::cmd_result_code::NOT_LEADER;
+    result.error_ = "Current node is not the leader";
+    done(result);
     return;
   }
+  batcher_->Submit(std::move(entry), std::move(done));
+}
 
-  // 计算所需的内存大小
-  size_t total_size = sizeof(int) + entry.size();
-
-  // 添加调试日志
-  global_logger->debug("Total size of entry: {}", total_size);
-
-  // 创建一个 Raft 日志条目
-  nuraft::ptr<nuraft::buffer> log_entry_buffer = nuraft::buffer::alloc(total_size);
-  nuraft::buffer_serializer bs_log(log_entry_buffer);
-
-  bs_log.put_str(entry);
-
-  // 添加调试日志
-  global_logger->debug("Created log_entry_buffer at address: {}", static_cast<const void *>(log_entry_buffer.get()));
-
+void RaftStuff::AppendBatch(nuraft::ptr<nuraft::buffer> batch, const WriteBatcher::Callback &done) {
   // 添加调试日志
-  global_logger->debug("Appending entry to Raft instance");
+  global_logger->debug("Appending batch of {} bytes to Raft instance", batch->size());
 
   // 将日志条目追加到 Raft 实例中
-  auto ret = raft_instance_->append_entries({log_entry_buffer});
+  auto ret = raft_instance_->append_entries({batch});
 
   if (!ret->get_accepted()) {
     // Log append rejected, usually because this node is not a leader.
     global_logger->debug("Failed append log {}", static_cast<int>(ret->get_result_code()));
+    WriteResult result;
+    result.code_ = ret->get_result_code();
+    result.error_ = "Raft append rejected: " + ret->get_result_str();
+    done(result);
+    return;
   }
   // Log append accepted, but that doesn't mean the log is committed.
   // Commit result can be obtained below.
@@ -157,14 +213,15 @@ void RaftStuff::AppendEntries(const std::string &entry) {
     // Blocking mode:
     //   `append_entries` returns after getting a consensus,
     //   so that `ret` already has the result from state machine.
-    HandleResult(*ret);
+    done(ToWriteResult(*ret));
 
   } else if (CALL_TYPE == nuraft::raft_params::async_handler) {
     // Async mode:
     //   `append_entries` returns immediately.
-    //   `handle_result` will be invoked asynchronously,
+    //   `done` will be invoked asynchronously,
     //   after getting a consensus.
-    ret->when_ready(std::bind(&RaftStuff::HandleResult, this, std::placeholders::_1));
+    ret->when_ready([done](nuraft::cmd_result<nuraft::ptr<nuraft::buffer>> &result,
+                           nuraft::ptr<std::exception> & /*err*/) { done(ToWriteResult(result)); });
   } else {
     assert(0);
   }
@@ -179,6 +236,13 @@ void RaftStuff::EnableElectionTimeout(int lower_bound, int upper_bound) {
   }
 }
 
+auto RaftStuff::GetLeader() const -> int {
+  if (!raft_instance_) {
+    return -1;
+  }
+  return raft_instance_->get_leader();
+}
+
 auto RaftStuff::IsLeader() const -> bool {
   if (!raft_instance_) {
     return false;
@@ -213,12 +277,7 @@ auto RaftStuff::GetAllNodesInfo() const
   for (auto &entry : configs) {
     nuraft::ptr<nuraft::srv_config> &srv = entry;
     // 获取节点状态
-    std::string node_state;
-    if (srv->get_id() == leader_id) {
-      node_state = "leader";
-    } else {
-      node_state = "follower";
-    }
+    std::string node_state = NodeState(*srv, leader_id);
 
     // 使用正确的类型
     nuraft::raft_server::peer_info node_info = raft_instance_->get_peer_info(srv->get_id());
@@ -250,12 +309,7 @@ auto RaftStuff::GetCurrentNodesInfo() const -> std::tuple<int, std::string, std:
   for (const auto &srv : servers) {
     if (srv && srv->get_id() == node_id_) {
       // 获取节点状态
-      std::string node_state;
-      if (srv->get_id() == raft_instance_->get_leader()) {
-        node_state = "leader";
-      } else {
-        node_state = "follower";
-      }
+      std::string node_state = NodeState(*srv, raft_instance_->get_leader());
 
       // 使用正确的类型
       nuraft::raft_server::peer_info node_info = raft_instance_->get_peer_info(srv->get_id());
@@ -269,15 +323,195 @@ auto RaftStuff::GetCurrentNodesInfo() const -> std::tuple<int, std::string, std:
   return nodes_info;
 }
 
-void RaftStuff::HandleResult(nuraft::cmd_result<nuraft::ptr<nuraft::buffer>> &result) {
+auto RaftStuff::NodeState(const nuraft::srv_config &srv, int leader_id) -> std::string {
+  if (srv.get_id() == leader_id) {
+    return NODE_STATE_LEADER;
+  }
+  return srv.is_learner() ? NODE_STATE_LEARNER : NODE_STATE_FOLLOWER;
+}
+
+auto RaftStuff::ParseReadConsistency(const std::string &name, ReadConsistency *consistency) -> bool {
+  if (name == CONSISTENCY_EVENTUAL) {
+    *consistency = ReadConsistency::EVENTUAL;
+  } else if (name == CONSISTENCY_READ_INDEX) {
+    *consistency = ReadConsistency::READ_INDEX;
+  } else if (name == CONSISTENCY_LEASE) {
+    *consistency = ReadConsistency::LEASE;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+auto RaftStuff::QuorumRespondedWithin(uint64_t window_us) const -> bool {
+  std::vector<nuraft::ptr<nuraft::srv_config>> configs;
+  raft_instance_->get_srv_config_all(configs);
+  size_t voters = 0;
+  size_t responded = 0;
+  for (auto &srv : configs) {
+    if (srv->is_learner()) {
+      continue;
+    }
+    ++voters;
+    if (srv->get_id() == node_id_ || raft_instance_->get_peer_info(srv->get_id()).last_succ_resp_us_ < window_us) {
+      ++responded;
+    }
+  }
+  return responded * 2 > voters;
+}
+
+auto RaftStuff::ConfirmLeadership() -> bool {
+  auto start = std::chrono::steady_clock::now();
+  int heart_beat_interval = raft_instance_->get_current_params().heart_beat_interval_;
+  auto timeout = std::chrono::milliseconds(heart_beat_interval * READ_INDEX_TIMEOUT_HEARTBEATS);
+  while (raft_instance_->is_leader()) {
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    if (QuorumRespondedWithin(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count())) {
+      return raft_instance_->is_leader();
+    }
+    if (elapsed >= timeout) {
+      return false;
+    }
+    // 在 bthread 中等下一轮心跳的回复, 不占用 brpc 的工作线程
+    bthread_usleep(1000);
+  }
+  return false;
+}
+
+auto RaftStuff::ReadIndex(ReadConsistency consistency) -> ReadIndexResult {
+  ReadIndexResult result;
+  if (!IsLeader()) {
+    result.code_ = nuraft::cmd_result_code::NOT_LEADER;
+    result.error_ = "Current node is not the leader";
+    return result;
+  }
+  uint64_t commit_idx = raft_instance_->get_target_committed_log_idx();
+  // 新 leader 在自己的任期内提交第一条日志之前, commit index 可能落后于前任已经提交的位置
+  if (commit_idx != 0 && log_store_->term_at(commit_idx) != raft_instance_->get_term()) {
+    result.code_ = nuraft::cmd_result_code::FAILED;
+    result.error_ = "Leader has not committed an entry in its term yet";
+    return result;
+  }
+  result.read_index_ = commit_idx;
+
+  // 租约: 过半成员在半个选举超时内回复过, 它们的选举计时器都还没到期, 不可能已经选出新 leader
+  const nuraft::raft_params &params = raft_instance_->get_current_params();
+  auto lease_us = static_cast<uint64_t>(params.election_timeout_lower_bound_) * 1000 / 2;
+  if (consistency == ReadConsistency::LEASE && QuorumRespondedWithin(lease_us)) {
+    result.ok_ = true;
+    return result;
+  }
+  if (!ConfirmLeadership()) {
+    result.code_ = IsLeader() ? nuraft::cmd_result_code::TIMEOUT : nuraft::cmd_result_code::NOT_LEADER;
+    result.error_ = "Failed to confirm leadership for read index";
+    return result;
+  }
+  result.ok_ = true;
+  return result;
+}
+
+auto RaftStuff::RequestReadIndex(ReadConsistency consistency) -> ReadIndexResult {
+  ReadIndexResult result;
+  int leader = GetLeader();
+  std::string endpoint = leader >= 0 ? Cfg::Instance().HttpEndpoint(leader) : std::string();
+  if (endpoint.empty()) {
+    result.code_ = nuraft::cmd_result_code::NOT_LEADER;
+    result.error_ = "Leader is unknown";
+    return result;
+  }
+
+  std::shared_ptr<brpc::Channel> channel = LeaderChannel(leader, endpoint);
+  if (!channel) {
+    result.code_ = nuraft::cmd_result_code::FAILED;
+    result.error_ = "Failed to connect to leader " + endpoint;
+    return result;
+  }
+  brpc::Controller cntl;
+  cntl.set_timeout_ms(raft_instance_->get_current_params().client_req_timeout_);
+  cntl.http_request().uri() = READ_INDEX_PATH;
+  cntl.http_request().set_method(brpc::HTTP_METHOD_POST);
+  const char *mode = consistency == ReadConsistency::LEASE ? CONSISTENCY_LEASE : CONSISTENCY_READ_INDEX;
+  cntl.request_attachment().append(std::string("{\"") + REQUEST_CONSISTENCY + "\":\"" + mode + "\",\"" +
+                                   REQUEST_GROUP_ID + "\":" + std::to_string(options_.group_id_) + "}");
+  channel->CallMethod(nullptr, &cntl, nullptr, nullptr, nullptr);
+
+  rapidjson::Document response;
+  response.Parse(cntl.response_attachment().to_string().c_str());
+  bool has_index = response.IsObject() && response.HasMember(RESPONSE_READ_INDEX) &&
+                   response[RESPONSE_READ_INDEX].IsUint64();
+  if (cntl.Failed() || !has_index) {
+    result.code_ = cntl.http_response().status_code() == 503 ? nuraft::cmd_result_code::NOT_LEADER
+                                                             : nuraft::cmd_result_code::FAILED;
+    result.error_ = "Failed to get read index from leader " + endpoint + ": ";
+    if (response.IsObject() && response.HasMember(RESPONSE_ERROR_MSG) && response[RESPONSE_ERROR_MSG].IsString()) {
+      result.error_ += response[RESPONSE_ERROR_MSG].GetString();
+    } else {
+      result.error_ += cntl.ErrorText();
+    }
+    return result;
+  }
+  result.ok_ = true;
+  result.read_index_ = response[RESPONSE_READ_INDEX].GetUint64();
+  return result;
+}
+
+auto RaftStuff::LeaderChannel(int leader, const std::string &endpoint) -> std::shared_ptr<brpc::Channel> {
+  std::lock_guard<std::mutex> lock(leader_channel_mutex_);
+  if (leader_channel_ && leader_channel_id_ == leader && leader_channel_endpoint_ == endpoint) {
+    return leader_channel_;
+  }
+  brpc::ChannelOptions options;
+  options.protocol = brpc::PROTOCOL_HTTP;
+  auto channel = std::make_shared<brpc::Channel>();
+  if (channel->Init(endpoint.c_str(), &options) != 0) {
+    return nullptr;
+  }
+  global_logger->info("Group {} read index channel now points to leader {} at {}", options_.group_id_, leader, endpoint);
+  leader_channel_id_ = leader;
+  leader_channel_endpoint_ = endpoint;
+  leader_channel_ = channel;
+  return channel;
+}
+
+auto RaftStuff::PrepareRead(ReadConsistency consistency) -> ReadIndexResult {
+  if (consistency == ReadConsistency::EVENTUAL) {
+    ReadIndexResult result;
+    result.ok_ = true;
+    return result;
+  }
+  ReadIndexResult result = IsLeader() ? ReadIndex(consistency) : RequestReadIndex(consistency);
+  if (!result.ok_) {
+    return result;
+  }
+  // leader 的 commit index 可能还没有应用到本地状态机
+  auto timeout = std::chrono::milliseconds(raft_instance_->get_current_params().client_req_timeout_);
+  if (!sm_->WaitApplied(result.read_index_, timeout)) {
+    result.ok_ = false;
+    result.code_ = nuraft::cmd_result_code::TIMEOUT;
+    result.error_ = "Timed out waiting to apply log " + std::to_string(result.read_index_);
+  }
+  return result;
+}
+
+auto RaftStuff::ToWriteResult(nuraft::cmd_result<nuraft::ptr<nuraft::buffer>> &result) -> WriteResult {
+  WriteResult write_result;
   if (result.get_result_code() != nuraft::cmd_result_code::OK) {
     // Something went wrong.
     // This means committing this log failed,
     // but the log itself is still in the log store.
     global_logger->error("failed: {}", static_cast<int>(result.get_result_code()));
-    return;
+    write_result.code_ = result.get_result_code();
+    write_result.error_ = "Raft commit failed: " + result.get_result_str();
+    return write_result;
+  }
+  // 状态机返回的是这条日志的 id
+  write_result.ok_ = true;
+  nuraft::ptr<nuraft::buffer> ret = result.get();
+  if (ret && ret->size() >= sizeof(uint64_t)) {
+    nuraft::buffer_serializer bs(ret);
+    write_result.log_idx_ = bs.get_u64();
   }
-  global_logger->info("succeed");
+  return write_result;
 }
 
 }  // namespace vectordb
\ No newline at end of file
@@ -0,0 +1,330 @@
+#include "cluster/snapshot_transfer.h"
+#include <butil/crc32c.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include "common/file_util.h"
+#include "logger/logger.h"
+
+namespace vectordb {
+
+namespace {
+
+constexpr size_t CHUNK_HEADER_SIZE = sizeof(uint64_t) + sizeof(uint32_t);
+
+auto BufferData(const nuraft::buffer &buf) -> const char * {
+  return reinterpret_cast<const char *>(buf.data_begin());
+}
+
+auto ToBuffer(const std::string &content) -> nuraft::ptr<nuraft::buffer> {
+  nuraft::ptr<nuraft::buffer> buf = nuraft::buffer::alloc(content.size());
+  memcpy(buf->data_begin(), content.data(), content.size());
+  buf->pos(0);
+  return buf;
+}
+
+template <typename T>
+void Append(std::string *out, T value) {
+  out->append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <typename T>
+auto Consume(const char **pos, const char *end) -> T {
+  if (end - *pos < static_cast<ptrdiff_t>(sizeof(T))) {
+    throw std::runtime_error("Truncated snapshot manifest");
+  }
+  T value;
+  memcpy(&value, *pos, sizeof(T));
+  *pos += sizeof(T);
+  return value;
+}
+
+auto ReadFile(const std::string &path, std::string *content) -> bool {
+  std::ifstream file(path, std::ios::in | std::ios::binary);
+  if (!file.is_open()) {
+    return false;
+  }
+  content->assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  return true;
+}
+
+}  // namespace
+
+SnapshotManifest::SnapshotManifest(std::vector<SnapshotFileEntry> files, uint64_t chunk_bytes)
+    : files_(std::move(files)), chunk_bytes_(chunk_bytes) {
+  if (chunk_bytes_ == 0) {
+    throw std::runtime_error("Snapshot chunk size must be positive");
+  }
+  uint64_t next = 1;
+  for (const auto &file : files_) {
+    first_chunk_.push_back(next);
+    next += (file.size_ + chunk_bytes_ - 1) / chunk_bytes_;
+  }
+  chunk_count_ = next - 1;
+}
+
+auto SnapshotManifest::Serialize() const -> nuraft::ptr<nuraft::buffer> {
+  std::string body;
+  Append<uint64_t>(&body, chunk_bytes_);
+  Append<uint32_t>(&body, static_cast<uint32_t>(files_.size()));
+  for (const auto &file : files_) {
+    Append<uint32_t>(&body, static_cast<uint32_t>(file.path_.size()));
+    body += file.path_;
+    Append<uint64_t>(&body, file.size_);
+  }
+  std::string content;
+  Append<uint32_t>(&content, butil::crc32c::Value(body.data(), body.size()));
+  content += body;
+  return ToBuffer(content);
+}
+
+auto SnapshotManifest::Deserialize(const nuraft::buffer &buf) -> SnapshotManifest {
+  const char *pos = BufferData(buf);
+  const char *end = pos + buf.size();
+  auto crc = Consume<uint32_t>(&pos, end);
+  if (butil::crc32c::Value(pos, end - pos) != crc) {
+    throw std::runtime_error("Snapshot manifest checksum mismatch");
+  }
+  auto chunk_bytes = Consume<uint64_t>(&pos, end);
+  auto count = Consume<uint32_t>(&pos, end);
+  std::vector<SnapshotFileEntry> files(count);
+  for (auto &file : files) {
+    auto len = Consume<uint32_t>(&pos, end);
+    if (end - pos < static_cast<ptrdiff_t>(len)) {
+      throw std::runtime_error("Truncated snapshot manifest");
+    }
+    file.path_.assign(pos, len);
+    pos += len;
+    // 路径来自网络, 不允许跳出接收目录
+    if (file.path_.empty() || file.path_.front() == '/' || file.path_.find("..") != std::string::npos) {
+      throw std::runtime_error("Invalid path in snapshot manifest: " + file.path_);
+    }
+    file.size_ = Consume<uint64_t>(&pos, end);
+  }
+  return {std::move(files), chunk_bytes};
+}
+
+void SnapshotManifest::Locate(uint64_t obj_id, size_t *file_idx, uint64_t *offset) const {
+  if (obj_id == 0 || obj_id > chunk_count_) {
+    throw std::runtime_error("Snapshot object id out of range: " + std::to_string(obj_id));
+  }
+  // 最后一个第一块不超过 obj_id 的文件; 空文件没有块, upper_bound 会跳过它们
+  auto it = std::upper_bound(first_chunk_.begin(), first_chunk_.end(), obj_id);
+  *file_idx = static_cast<size_t>(it - first_chunk_.begin()) - 1;
+  *offset = (obj_id - first_chunk_[*file_idx]) * chunk_bytes_;
+}
+
+SnapshotReader::SnapshotReader(const std::string &dir, uint64_t chunk_bytes, const std::vector<std::string> &exclude)
+    : dir_(dir) {
+  if (!std::filesystem::is_directory(dir)) {
+    throw std::runtime_error("Snapshot directory not found: " + dir);
+  }
+  std::vector<SnapshotFileEntry> files;
+  for (const auto &entry : std::filesystem::recursive_directory_iterator(dir)) {
+    if (!entry.is_regular_file()) {
+      continue;
+    }
+    std::string path = std::filesystem::relative(entry.path(), dir).string();
+    if (std::find(exclude.begin(), exclude.end(), path) != exclude.end()) {
+      continue;
+    }
+    files.push_back({path, entry.file_size()});
+  }
+  std::sort(files.begin(), files.end(),
+            [](const SnapshotFileEntry &a, const SnapshotFileEntry &b) { return a.path_ < b.path_; });
+  manifest_ = SnapshotManifest(std::move(files), chunk_bytes);
+}
+
+SnapshotReader::~SnapshotReader() {
+  for (auto &[idx, fd] : fds_) {
+    close(fd);
+  }
+}
+
+auto SnapshotReader::Read(uint64_t obj_id) -> nuraft::ptr<nuraft::buffer> {
+  if (obj_id == 0) {
+    return manifest_.Serialize();
+  }
+  size_t file_idx = 0;
+  uint64_t offset = 0;
+  manifest_.Locate(obj_id, &file_idx, &offset);
+  const auto &file = manifest_.Files()[file_idx];
+  std::string path = dir_ + "/" + file.path_;
+  auto it = fds_.find(file_idx);
+  if (it == fds_.end()) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("Failed to open snapshot file " + path + ": " + std::strerror(errno));
+    }
+    it = fds_.emplace(file_idx, fd).first;
+  }
+
+  size_t size = std::min<uint64_t>(manifest_.ChunkBytes(), file.size_ - offset);
+  nuraft::ptr<nuraft::buffer> buf = nuraft::buffer::alloc(CHUNK_HEADER_SIZE + size);
+  char *data = reinterpret_cast<char *>(buf->data_begin()) + CHUNK_HEADER_SIZE;
+  size_t read_bytes = 0;
+  while (read_bytes < size) {
+    ssize_t n = pread(it->second, data + read_bytes, size - read_bytes, static_cast<off_t>(offset + read_bytes));
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      throw std::runtime_error("Failed to read snapshot file " + path);
+    }
+    read_bytes += static_cast<size_t>(n);
+  }
+  uint32_t crc = butil::crc32c::Value(data, size);
+  memcpy(buf->data_begin(), &obj_id, sizeof(obj_id));
+  memcpy(buf->data_begin() + sizeof(obj_id), &crc, sizeof(crc));
+  buf->pos(0);
+  return buf;
+}
+
+SnapshotReceiver::SnapshotReceiver(const std::string &dir, uint64_t sync_interval_bytes)
+    : dir_(dir), sync_interval_bytes_(sync_interval_bytes) {}
+
+SnapshotReceiver::~SnapshotReceiver() { CloseFiles(); }
+
+auto SnapshotReceiver::Begin(const nuraft::buffer &manifest) -> uint64_t {
+  manifest_ = SnapshotManifest::Deserialize(manifest);
+  has_manifest_ = true;
+  std::string saved;
+  std::string incoming(BufferData(manifest), manifest.size());
+  if (ReadFile(dir_ + "/" + MANIFEST_FILE_NAME, &saved) && saved == incoming) {
+    std::string progress;
+    if (ReadFile(dir_ + "/" + PROGRESS_FILE_NAME, &progress) && progress.size() == sizeof(uint64_t)) {
+      memcpy(&next_obj_id_, progress.data(), sizeof(uint64_t));
+      // 全部收齐时重发最后一块, 让 leader 带上 is_last_obj
+      next_obj_id_ = std::clamp<uint64_t>(next_obj_id_, 1, std::max<uint64_t>(manifest_.ChunkCount(), 1));
+      global_logger->info("Resume snapshot transfer into {} from chunk {}/{}", dir_, next_obj_id_,
+                          manifest_.ChunkCount());
+      return next_obj_id_;
+    }
+  }
+
+  Reset();
+  WriteFileSync(dir_ + "/" + MANIFEST_FILE_NAME, incoming);
+  global_logger->info("Start snapshot transfer into {}: {} files, {} chunks", dir_, manifest_.Files().size(),
+                      manifest_.ChunkCount());
+  return next_obj_id_;
+}
+
+auto SnapshotReceiver::Resume() -> bool {
+  std::string saved;
+  if (!ReadFile(dir_ + "/" + MANIFEST_FILE_NAME, &saved)) {
+    return false;
+  }
+  try {
+    nuraft::ptr<nuraft::buffer> buf = ToBuffer(saved);
+    Begin(*buf);
+  } catch (const std::exception &e) {
+    global_logger->warn("Discard snapshot transfer state in {}: {}", dir_, e.what());
+    return false;
+  }
+  return true;
+}
+
+void SnapshotReceiver::Reset() {
+  CloseFiles();
+  std::filesystem::remove_all(dir_);
+  std::filesystem::create_directories(dir_);
+  // 预先建好所有文件, 空文件不会有数据块
+  for (const auto &file : manifest_.Files()) {
+    std::string path = dir_ + "/" + file.path_;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path());
+    std::ofstream(path, std::ios::binary | std::ios::trunc).close();
+  }
+  next_obj_id_ = 1;
+  unsynced_bytes_ = 0;
+}
+
+auto SnapshotReceiver::Write(uint64_t obj_id, const nuraft::buffer &chunk) -> bool {
+  if (!has_manifest_) {
+    throw std::runtime_error("Snapshot chunk received before manifest");
+  }
+  const char *pos = BufferData(chunk);
+  if (chunk.size() < CHUNK_HEADER_SIZE) {
+    global_logger->warn("Truncated snapshot chunk {}", obj_id);
+    return false;
+  }
+  uint64_t chunk_id = 0;
+  uint32_t crc = 0;
+  memcpy(&chunk_id, pos, sizeof(chunk_id));
+  memcpy(&crc, pos + sizeof(chunk_id), sizeof(crc));
+  const char *data = pos + CHUNK_HEADER_SIZE;
+  size_t size = chunk.size() - CHUNK_HEADER_SIZE;
+  if (chunk_id != obj_id || butil::crc32c::Value(data, size) != crc) {
+    global_logger->warn("Snapshot chunk {} failed verification", obj_id);
+    return false;
+  }
+
+  size_t file_idx = 0;
+  uint64_t offset = 0;
+  manifest_.Locate(obj_id, &file_idx, &offset);
+  const auto &file = manifest_.Files()[file_idx];
+  if (offset + size > file.size_) {
+    global_logger->warn("Snapshot chunk {} overflows {}", obj_id, file.path_);
+    return false;
+  }
+  std::string path = dir_ + "/" + file.path_;
+  auto it = fds_.find(file_idx);
+  if (it == fds_.end()) {
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+    if (fd < 0) {
+      throw std::runtime_error("Failed to open snapshot file " + path + ": " + std::strerror(errno));
+    }
+    it = fds_.emplace(file_idx, fd).first;
+  }
+  WriteFully(it->second, data, size, offset, path);
+
+  next_obj_id_ = std::max(next_obj_id_, obj_id + 1);
+  unsynced_bytes_ += size;
+  if (unsynced_bytes_ >= sync_interval_bytes_) {
+    Sync();
+  }
+  return true;
+}
+
+void SnapshotReceiver::Sync() {
+  for (auto &[idx, fd] : fds_) {
+    if (fdatasync(fd) != 0) {
+      throw std::runtime_error("Failed to sync snapshot file: " + std::string(std::strerror(errno)));
+    }
+  }
+  // 记录的进度不超过已经落盘的块
+  std::string progress(reinterpret_cast<const char *>(&next_obj_id_), sizeof(next_obj_id_));
+  WriteFileSync(dir_ + "/" + PROGRESS_FILE_NAME, progress);
+  unsynced_bytes_ = 0;
+  // 已经写完的文件不会再被写入, 关掉避免 fd 越积越多
+  CloseFiles();
+}
+
+void SnapshotReceiver::CloseFiles() {
+  for (auto &[idx, fd] : fds_) {
+    close(fd);
+  }
+  fds_.clear();
+}
+
+void SnapshotReceiver::Finish(const std::string &final_dir) {
+  Sync();
+  for (const auto &file : manifest_.Files()) {
+    std::string path = dir_ + "/" + file.path_;
+    if (std::filesystem::file_size(path) != file.size_) {
+      throw std::runtime_error("Incomplete snapshot file " + path);
+    }
+  }
+  std::filesystem::remove(dir_ + "/" + MANIFEST_FILE_NAME);
+  std::filesystem::remove(dir_ + "/" + PROGRESS_FILE_NAME);
+  std::filesystem::remove_all(final_dir);
+  std::filesystem::rename(dir_, final_dir);
+  global_logger->info("Snapshot transfer finished: {} files moved to {}", manifest_.Files().size(), final_dir);
+}
+
+}  // namespace vectordb
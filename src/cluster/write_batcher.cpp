@@ -0,0 +1,143 @@
+#include "cluster/write_batcher.h"
+#include <exception>
+#include "cluster/raft_command.h"
+#include "logger/logger.h"
+
+namespace vectordb {
+
+WriteBatcher::WriteBatcher(AppendFn append, std::chrono::microseconds max_delay, size_t max_batch_bytes,
+                           size_t max_batch_count, bool compress, TaskScheduler *scheduler)
+    : append_(std::move(append)),
+      max_delay_(max_delay),
+      max_batch_bytes_(max_batch_bytes),
+      max_batch_count_(max_batch_count),
+      compress_(compress),
+      scheduler_(scheduler) {
+  if (scheduler_ == nullptr) {
+    flush_thread_ = std::thread(&WriteBatcher::FlushLoop, this);
+  }
+}
+
+WriteBatcher::~WriteBatcher() { Stop(); }
+
+void WriteBatcher::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  if (flush_thread_.joinable()) {
+    flush_thread_.join();
+  }
+  if (scheduler_ != nullptr) {
+    // 与提交线程退出前一样, 把剩下的请求提交掉
+    scheduler_->Remove(this);
+    std::vector<Pending> batch;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      batch = TakePending();
+    }
+    if (!batch.empty()) {
+      Flush(&batch);
+    }
+  }
+}
+
+void WriteBatcher::Submit(std::string request, Callback done) {
+  bool wake = false;
+  bool full = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stop_) {
+      WriteResult result;
+      result.error_ = "Write batcher stopped";
+      done(result);
+      return;
+    }
+    wake = pending_.empty();
+    pending_bytes_ += request.size();
+    pending_.push_back({std::move(request), std::move(done)});
+    full = pending_bytes_ >= max_batch_bytes_ || pending_.size() >= max_batch_count_;
+    // 持锁排队: Stop 设置 stop_ 之后不会再有排队, Remove 之后线程池不再引用这个对象
+    if (scheduler_ != nullptr) {
+      if (full) {
+        scheduler_->Schedule(this);
+      } else if (wake) {
+        scheduler_->Schedule(this, TaskScheduler::Clock::now() + max_delay_);
+      }
+      return;
+    }
+  }
+  // 第一个请求唤醒提交线程开始计时, 攒满时让它立即提交, 其余请求不打扰它
+  if (wake || full) {
+    cv_.notify_one();
+  }
+}
+
+void WriteBatcher::RunScheduled() {
+  std::vector<Pending> batch;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    batch = TakePending();
+  }
+  if (!batch.empty()) {
+    Flush(&batch);
+  }
+}
+
+auto WriteBatcher::TakePending() -> std::vector<Pending> {
+  std::vector<Pending> batch;
+  batch.swap(pending_);
+  pending_bytes_ = 0;
+  return batch;
+}
+
+void WriteBatcher::FlushLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cv_.wait(lock, [this] { return stop_ || !pending_.empty(); });
+    if (pending_.empty()) {
+      // stop_ 且没有待提交的请求
+      return;
+    }
+    // 从第一个请求到达算起最多等 max_delay_, 期间攒满就提前提交
+    auto deadline = std::chrono::steady_clock::now() + max_delay_;
+    cv_.wait_until(lock, deadline, [this] {
+      return stop_ || pending_bytes_ >= max_batch_bytes_ || pending_.size() >= max_batch_count_;
+    });
+
+    std::vector<Pending> batch = TakePending();
+    lock.unlock();
+    Flush(&batch);
+    lock.lock();
+  }
+}
+
+void WriteBatcher::Flush(std::vector<Pending> *batch) {
+  std::vector<std::string> requests;
+  requests.reserve(batch->size());
+  auto callbacks = std::make_shared<std::vector<Callback>>();
+  callbacks->reserve(batch->size());
+  for (auto &pending : *batch) {
+    requests.push_back(std::move(pending.request_));
+    callbacks->push_back(std::move(pending.done_));
+  }
+  global_logger->debug("Flushing write batch of {} requests", requests.size());
+
+  // 每个调用方单独拿到结果
+  Callback fan_out = [callbacks](const WriteResult &result) {
+    for (const auto &done : *callbacks) {
+      done(result);
+    }
+  };
+  try {
+    append_(RaftCommand::EncodeBatch(requests, compress_), fan_out);
+  } catch (const std::exception &e) {
+    global_logger->error("Failed to append write batch: {}", e.what());
+    WriteResult result;
+    result.error_ = e.what();
+    fan_out(result);
+  }
+}
+
+}  // namespace vectordb
@@ -0,0 +1,57 @@
+#include "common/file_util.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+namespace vectordb {
+
+void SyncDir(const std::string &dir) {
+  int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd >= 0) {
+    fsync(fd);
+    close(fd);
+  }
+}
+
+void WriteFully(int fd, const char *data, size_t size, uint64_t offset, const std::string &path) {
+  while (size > 0) {
+    ssize_t written = pwrite(fd, data, size, static_cast<off_t>(offset));
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::runtime_error("Failed to write " + path + ": " + std::strerror(errno));
+    }
+    data += written;
+    size -= static_cast<size_t>(written);
+    offset += static_cast<uint64_t>(written);
+  }
+}
+
+void WriteFileSync(const std::string &path, const std::string &content) {
+  std::string tmp_path = path + ".tmp";
+  int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    throw std::runtime_error("Failed to create " + tmp_path + ": " + std::strerror(errno));
+  }
+  try {
+    WriteFully(fd, content.data(), content.size(), 0, tmp_path);
+  } catch (...) {
+    close(fd);
+    throw;
+  }
+  if (fsync(fd) != 0) {
+    int err = errno;
+    close(fd);
+    throw std::runtime_error("Failed to fsync " + tmp_path + ": " + std::strerror(err));
+  }
+  close(fd);
+  std::filesystem::rename(tmp_path, path);
+  std::string dir = std::filesystem::path(path).parent_path().string();
+  SyncDir(dir.empty() ? "." : dir);
+}
+
+}  // namespace vectordb
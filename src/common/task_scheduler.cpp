@@ -0,0 +1,85 @@
+#include "common/task_scheduler.h"
+#include <algorithm>
+
+namespace vectordb {
+
+TaskScheduler::TaskScheduler(size_t threads) {
+  threads = std::max<size_t>(threads, 1);
+  for (size_t i = 0; i < threads; ++i) {
+    threads_.emplace_back(&TaskScheduler::Loop, this);
+  }
+}
+
+TaskScheduler::~TaskScheduler() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (auto &thread : threads_) {
+    thread.join();
+  }
+}
+
+void TaskScheduler::Schedule(ScheduledTask *task, Clock::time_point when) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stop_) {
+      return;
+    }
+    auto it = queued_.find(task);
+    if (it != queued_.end()) {
+      if (it->second <= when) {
+        return;
+      }
+      deadlines_.erase({it->second, task});
+      it->second = when;
+    } else {
+      queued_.emplace(task, when);
+    }
+    deadlines_.emplace(when, task);
+  }
+  cv_.notify_all();
+}
+
+void TaskScheduler::Remove(ScheduledTask *task) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_cv_.wait(lock, [this, task] { return running_.count(task) == 0; });
+  // 运行期间任务可能重新排了队
+  auto it = queued_.find(task);
+  if (it != queued_.end()) {
+    deadlines_.erase({it->second, task});
+    queued_.erase(it);
+  }
+}
+
+void TaskScheduler::Loop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_) {
+    // 正在别的线程上运行的任务等它结束后再取
+    auto it = std::find_if(deadlines_.begin(), deadlines_.end(),
+                           [this](const auto &entry) { return running_.count(entry.second) == 0; });
+    if (it == deadlines_.end()) {
+      cv_.wait(lock);
+      continue;
+    }
+    if (it->first > Clock::now()) {
+      cv_.wait_until(lock, it->first);
+      continue;
+    }
+    ScheduledTask *task = it->second;
+    deadlines_.erase(it);
+    queued_.erase(task);
+    running_.insert(task);
+
+    lock.unlock();
+    task->RunScheduled();
+    lock.lock();
+
+    running_.erase(task);
+    idle_cv_.notify_all();
+    cv_.notify_all();
+  }
+}
+
+}  // namespace vectordb
@@ -1,4 +1,5 @@
 #include "common/vector_cfg.h"
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 
@@ -15,6 +16,8 @@
 //             "ROCKS_DB_PATH" : "/home/zhouzj/vectordb1/storage",
 //             "WAL_PATH" : "/home/zhouzj/vectordb1/wal",
 //             "SNAP_PATH" : "/home/zhouzj/vectordb1/snap/",
+//             "RAFT_LOG_PATH" : "/home/zhouzj/vectordb1/raft_log",
+//             "RAFT_GROUPS" : [0, 1, 2],
 //             "ADDRESS" : "0.0.0.0",
 //             "PORT" : 7781
 //         },
@@ -38,7 +41,32 @@
 //     },
 //     "TEST_ROCKS_DB_PATH" : "/home/zhouzj/test_vectordb/storage",
 //     "TEST_WAL_PATH" : "/home/zhouzj/test_vectordb/wal",
-//     "TEST_SNAP_PATH" : "/home/zhouzj/test_vectordb/snap/"
+//     "TEST_SNAP_PATH" : "/home/zhouzj/test_vectordb/snap/",
+//     "ROCKSDB" : {
+//         "STATISTICS" : true,
+//         "VECTORS" : { "BLOCK_CACHE_MB" : 256, "BLOOM_BITS_PER_KEY" : 10, "COMPRESSION" : "none",
+//                       "COMPACTION_STYLE" : "level", "WRITE_BUFFER_MB" : 64 },
+//         "ATTRIBUTES" : { "COMPRESSION" : "zstd" },
+//         "META" : { "BLOCK_CACHE_MB" : 8 }
+//     },
+//     "RAFT_LOG" : {
+//         "SEGMENT_BYTES" : 67108864,
+//         "SNAPSHOT_DISTANCE" : 100000,
+//         "RESERVED_LOG_ITEMS" : 10000,
+//         "SNAPSHOT_CHUNK_BYTES" : 4194304,
+//         "BATCH_DELAY_US" : 300,
+//         "BATCH_MAX_BYTES" : 1048576,
+//         "BATCH_MAX_COUNT" : 1024,
+//         "COMPRESSION" : "none"
+//     },
+//     "MULTI_RAFT" : {
+//         "PORT_STRIDE" : 100,
+//         "ASIO_THREADS" : 4,
+//         "LOG_FLUSH_THREADS" : 2,
+//         "COMPACT_THREADS" : 1,
+//         "BATCH_THREADS" : 2,
+//         "DECODE_THREADS" : 4
+//     }
 
 // }
 
@@ -97,6 +125,13 @@ void Cfg::ParseCfgFile(const std::string &path,const  int &node_id) {
       if (node_cfg.HasMember("RAFT") && node_cfg["RAFT"].IsObject()) {
         if (node_cfg["RAFT"].HasMember("NODE_ID") && node_cfg["RAFT"]["NODE_ID"].IsInt()) {
           int raft_node_id = node_cfg["RAFT"]["NODE_ID"].GetInt();
+          // ADDRESS 是监听地址, 对外地址取 raft endpoint 的主机部分
+          if (node_cfg["RAFT"].HasMember("ENDPOINT") && node_cfg["RAFT"]["ENDPOINT"].IsString() &&
+              node_cfg.HasMember("PORT") && node_cfg["PORT"].IsInt()) {
+            std::string raft_endpoint = node_cfg["RAFT"]["ENDPOINT"].GetString();
+            http_endpoints_[raft_node_id] = raft_endpoint.substr(0, raft_endpoint.rfind(':')) + ":" +
+                                            std::to_string(node_cfg["PORT"].GetInt());
+          }
           if (raft_node_id == node_id) {
             if (node_cfg.HasMember("ROCKS_DB_PATH") && node_cfg["ROCKS_DB_PATH"].IsString()) {
               m_rocks_db_path_ = node_cfg["ROCKS_DB_PATH"].GetString();
@@ -114,6 +149,21 @@ void Cfg::ParseCfgFile(const std::string &path,const  int &node_id) {
             } else {
               std::cout << "SNAP_PATH fault" << std::endl;
             }
+            if (node_cfg.HasMember("RAFT_LOG_PATH") && node_cfg["RAFT_LOG_PATH"].IsString()) {
+              raft_cfg_.log_path_ = node_cfg["RAFT_LOG_PATH"].GetString();
+            } else {
+              raft_cfg_.log_path_ = std::filesystem::path(wal_path_).parent_path().string() + "/raft_log";
+            }
+            if (node_cfg.HasMember("RAFT_GROUPS") && node_cfg["RAFT_GROUPS"].IsArray()) {
+              raft_groups_.clear();
+              for (const auto &group : node_cfg["RAFT_GROUPS"].GetArray()) {
+                if (group.IsInt() && group.GetInt() >= 0) {
+                  raft_groups_.push_back(group.GetInt());
+                } else {
+                  std::cout << "RAFT_GROUPS fault" << std::endl;
+                }
+              }
+            }
 
       
               if (node_cfg["RAFT"].HasMember("NODE_ID") && node_cfg["RAFT"]["NODE_ID"].IsInt()) {
@@ -189,6 +239,102 @@ void Cfg::ParseCfgFile(const std::string &path,const  int &node_id) {
   } else {
     std::cout << "LOG fault" << std::endl;
   }
+
+  // ROCKSDB 段是可选的, 没有配置的项保持默认值
+  if (data.HasMember("ROCKSDB") && data["ROCKSDB"].IsObject()) {
+    const auto &rocksdb_cfg = data["ROCKSDB"];
+    if (rocksdb_cfg.HasMember("STATISTICS") && rocksdb_cfg["STATISTICS"].IsBool()) {
+      rocksdb_cfg_.statistics_ = rocksdb_cfg["STATISTICS"].GetBool();
+    }
+    if (rocksdb_cfg.HasMember("VECTORS") && rocksdb_cfg["VECTORS"].IsObject()) {
+      ParseRocksDbCfCfg(rocksdb_cfg["VECTORS"], &rocksdb_cfg_.vectors_);
+    }
+    if (rocksdb_cfg.HasMember("ATTRIBUTES") && rocksdb_cfg["ATTRIBUTES"].IsObject()) {
+      ParseRocksDbCfCfg(rocksdb_cfg["ATTRIBUTES"], &rocksdb_cfg_.attributes_);
+    }
+    if (rocksdb_cfg.HasMember("META") && rocksdb_cfg["META"].IsObject()) {
+      ParseRocksDbCfCfg(rocksdb_cfg["META"], &rocksdb_cfg_.meta_);
+    }
+  }
+
+  if (data.HasMember("RAFT_LOG") && data["RAFT_LOG"].IsObject()) {
+    const auto &raft_log_cfg = data["RAFT_LOG"];
+    if (raft_log_cfg.HasMember("SEGMENT_BYTES") && raft_log_cfg["SEGMENT_BYTES"].IsUint()) {
+      raft_log_cfg_.segment_bytes_ = raft_log_cfg["SEGMENT_BYTES"].GetUint();
+    }
+    if (raft_log_cfg.HasMember("SNAPSHOT_DISTANCE") && raft_log_cfg["SNAPSHOT_DISTANCE"].IsUint64()) {
+      raft_log_cfg_.snapshot_distance_ = raft_log_cfg["SNAPSHOT_DISTANCE"].GetUint64();
+    }
+    if (raft_log_cfg.HasMember("RESERVED_LOG_ITEMS") && raft_log_cfg["RESERVED_LOG_ITEMS"].IsUint64()) {
+      raft_log_cfg_.reserved_log_items_ = raft_log_cfg["RESERVED_LOG_ITEMS"].GetUint64();
+    }
+    if (raft_log_cfg.HasMember("SNAPSHOT_CHUNK_BYTES") && raft_log_cfg["SNAPSHOT_CHUNK_BYTES"].IsUint64()) {
+      raft_log_cfg_.snapshot_chunk_bytes_ = raft_log_cfg["SNAPSHOT_CHUNK_BYTES"].GetUint64();
+    }
+    if (raft_log_cfg.HasMember("BATCH_DELAY_US") && raft_log_cfg["BATCH_DELAY_US"].IsUint64()) {
+      raft_log_cfg_.batch_delay_us_ = raft_log_cfg["BATCH_DELAY_US"].GetUint64();
+    }
+    if (raft_log_cfg.HasMember("BATCH_MAX_BYTES") && raft_log_cfg["BATCH_MAX_BYTES"].IsUint64()) {
+      raft_log_cfg_.batch_max_bytes_ = raft_log_cfg["BATCH_MAX_BYTES"].GetUint64();
+    }
+    if (raft_log_cfg.HasMember("BATCH_MAX_COUNT") && raft_log_cfg["BATCH_MAX_COUNT"].IsUint64()) {
+      raft_log_cfg_.batch_max_count_ = raft_log_cfg["BATCH_MAX_COUNT"].GetUint64();
+    }
+    if (raft_log_cfg.HasMember("COMPRESSION") && raft_log_cfg["COMPRESSION"].IsString()) {
+      raft_log_cfg_.compression_ = raft_log_cfg["COMPRESSION"].GetString();
+    }
+  }
+
+  if (data.HasMember("MULTI_RAFT") && data["MULTI_RAFT"].IsObject()) {
+    const auto &multi_raft_cfg = data["MULTI_RAFT"];
+    if (multi_raft_cfg.HasMember("PORT_STRIDE") && multi_raft_cfg["PORT_STRIDE"].IsInt()) {
+      multi_raft_cfg_.port_stride_ = multi_raft_cfg["PORT_STRIDE"].GetInt();
+    }
+    if (multi_raft_cfg.HasMember("ASIO_THREADS") && multi_raft_cfg["ASIO_THREADS"].IsUint()) {
+      multi_raft_cfg_.asio_threads_ = multi_raft_cfg["ASIO_THREADS"].GetUint();
+    }
+    if (multi_raft_cfg.HasMember("LOG_FLUSH_THREADS") && multi_raft_cfg["LOG_FLUSH_THREADS"].IsUint()) {
+      multi_raft_cfg_.log_flush_threads_ = multi_raft_cfg["LOG_FLUSH_THREADS"].GetUint();
+    }
+    if (multi_raft_cfg.HasMember("COMPACT_THREADS") && multi_raft_cfg["COMPACT_THREADS"].IsUint()) {
+      multi_raft_cfg_.compact_threads_ = multi_raft_cfg["COMPACT_THREADS"].GetUint();
+    }
+    if (multi_raft_cfg.HasMember("BATCH_THREADS") && multi_raft_cfg["BATCH_THREADS"].IsUint()) {
+      multi_raft_cfg_.batch_threads_ = multi_raft_cfg["BATCH_THREADS"].GetUint();
+    }
+    if (multi_raft_cfg.HasMember("DECODE_THREADS") && multi_raft_cfg["DECODE_THREADS"].IsUint()) {
+      multi_raft_cfg_.decode_threads_ = multi_raft_cfg["DECODE_THREADS"].GetUint();
+    }
+  }
+}
+
+auto Cfg::GroupPath(const std::string &path, int group_id) -> std::string {
+  if (group_id == 0 || path.empty()) {
+    return path;
+  }
+  std::string suffix = "_group_" + std::to_string(group_id);
+  if (path.back() == '/') {
+    return path.substr(0, path.size() - 1) + suffix + "/";
+  }
+  return path + suffix;
+}
+
+void Cfg::ParseRocksDbCfCfg(const rapidjson::Value &cf_cfg, RocksDbCfCfg *cfg) {
+  if (cf_cfg.HasMember("BLOCK_CACHE_MB") && cf_cfg["BLOCK_CACHE_MB"].IsUint()) {
+    cfg->block_cache_mb_ = cf_cfg["BLOCK_CACHE_MB"].GetUint();
+  }
+  if (cf_cfg.HasMember("BLOOM_BITS_PER_KEY") && cf_cfg["BLOOM_BITS_PER_KEY"].IsInt()) {
+    cfg->bloom_bits_per_key_ = cf_cfg["BLOOM_BITS_PER_KEY"].GetInt();
+  }
+  if (cf_cfg.HasMember("COMPRESSION") && cf_cfg["COMPRESSION"].IsString()) {
+    cfg->compression_ = cf_cfg["COMPRESSION"].GetString();
+  }
+  if (cf_cfg.HasMember("COMPACTION_STYLE") && cf_cfg["COMPACTION_STYLE"].IsString()) {
+    cfg->compaction_style_ = cf_cfg["COMPACTION_STYLE"].GetString();
+  }
+  if (cf_cfg.HasMember("WRITE_BUFFER_MB") && cf_cfg["WRITE_BUFFER_MB"].IsUint()) {
+    cfg->write_buffer_mb_ = cf_cfg["WRITE_BUFFER_MB"].GetUint();
+  }
 }
 
 }  // namespace vectordb
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "common/vector_init.h"
+#include "common/constants.h"
 #include "common/master_cfg.h"
 #include "common/proxy_cfg.h"
 #include "common/vector_cfg.h"
@@ -12,10 +13,7 @@ void VdbServerInit(int node_id) {
   InitGlobalLogger(Cfg::Instance().GlogName());
   SetLogLevel(Cfg::Instance().GlogLevel());
   auto &indexfactory = IndexFactory::Instance();
-  int dim = 1;  // 向量维度
-  indexfactory.Init(IndexFactory::IndexType::FLAT, dim, 100);
-  indexfactory.Init(IndexFactory::IndexType::HNSW, dim, 100);
-  indexfactory.Init(IndexFactory::IndexType::FILTER, dim, 100);
+  indexfactory.InitAll(DEFAULT_INDEX_DIM, DEFAULT_INDEX_CAPACITY);
 }
 
 
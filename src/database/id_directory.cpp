@@ -0,0 +1,205 @@
+#include "database/id_directory.h"
+#include <algorithm>
+#include <stdexcept>
+#include "common/constants.h"
+#include "database/record_codec.h"
+
+namespace vectordb {
+
+namespace {
+
+// murmur3 的 64 位收尾混合, 连续的 id 也能均匀分布到各个槽位
+auto HashId(uint64_t id) -> uint64_t {
+  id ^= id >> 33;
+  id *= 0xff51afd7ed558ccdULL;
+  id ^= id >> 33;
+  id *= 0xc4ceb9fe1a85ec53ULL;
+  id ^= id >> 33;
+  return id;
+}
+
+}  // namespace
+
+IdDirectory::IdDirectory() : slots_(INITIAL_CAPACITY, Slot{}) {}
+
+auto IdDirectory::FindSlot(uint64_t id) const -> size_t {
+  size_t mask = slots_.size() - 1;
+  size_t pos = HashId(id) & mask;
+  // 只插入不删除, 没有墓碑, 遇到空槽位即可停止
+  while (slots_[pos].used_ != 0 && slots_[pos].id_ != id) {
+    pos = (pos + 1) & mask;
+  }
+  return pos;
+}
+
+void IdDirectory::Grow() {
+  std::vector<Slot> old_slots(slots_.size() * 2, Slot{});
+  old_slots.swap(slots_);
+  for (const auto &slot : old_slots) {
+    if (slot.used_ != 0) {
+      slots_[FindSlot(slot.id_)] = slot;
+    }
+  }
+}
+
+void IdDirectory::CompactFields() {
+  std::vector<uint32_t> field_ids;
+  std::vector<int64_t> field_values;
+  field_ids.reserve(field_ids_.size() - dead_fields_);
+  field_values.reserve(field_ids_.size() - dead_fields_);
+  for (auto &slot : slots_) {
+    if (slot.used_ == 0) {
+      continue;
+    }
+    auto offset = static_cast<uint32_t>(field_ids.size());
+    field_ids.insert(field_ids.end(), field_ids_.begin() + slot.field_offset_,
+                     field_ids_.begin() + slot.field_offset_ + slot.field_count_);
+    field_values.insert(field_values.end(), field_values_.begin() + slot.field_offset_,
+                        field_values_.begin() + slot.field_offset_ + slot.field_count_);
+    slot.field_offset_ = offset;
+  }
+  field_ids_.swap(field_ids);
+  field_values_.swap(field_values);
+  dead_fields_ = 0;
+}
+
+auto IdDirectory::Lookup(uint64_t id, Entry *entry) const -> bool {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const Slot &slot = slots_[FindSlot(id)];
+  if (slot.used_ == 0) {
+    return false;
+  }
+  entry->index_type_ = static_cast<IndexFactory::IndexType>(slot.index_type_);
+  entry->int_fields_.clear();
+  entry->int_fields_.reserve(slot.field_count_);
+  for (uint32_t i = slot.field_offset_; i < slot.field_offset_ + slot.field_count_; ++i) {
+    entry->int_fields_.emplace_back(field_ids_[i], field_values_[i]);
+  }
+  return true;
+}
+
+auto IdDirectory::Contains(uint64_t id) const -> bool {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return slots_[FindSlot(id)].used_ != 0;
+}
+
+void IdDirectory::Put(uint64_t id, IndexFactory::IndexType index_type, FieldValues int_fields) {
+  if (int_fields.size() > MAX_FIELDS_PER_ID) {
+    throw std::runtime_error("Too many int fields for id " + std::to_string(id) + ": " +
+                             std::to_string(int_fields.size()));
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  if ((size_ + 1) * 100 > slots_.size() * MAX_LOAD_PERCENT) {
+    Grow();
+  }
+  size_t pos = FindSlot(id);
+  size_t old_count = slots_[pos].used_ != 0 ? slots_[pos].field_count_ : 0;
+  // 字段数不超过原来的就原地覆盖, 否则追加到字段区末尾, 原来的区间记为失效
+  bool append = int_fields.size() > old_count;
+  if (append && field_ids_.size() + int_fields.size() > UINT32_MAX) {
+    CompactFields();
+    if (field_ids_.size() + int_fields.size() > UINT32_MAX) {
+      throw std::runtime_error("IdDirectory field arena is full");
+    }
+  }
+
+  Slot &slot = slots_[pos];
+  if (slot.used_ == 0) {
+    slot = Slot{id, 0, 0, 0, 1};
+    ++size_;
+  }
+  if (append) {
+    dead_fields_ += old_count;
+    slot.field_offset_ = static_cast<uint32_t>(field_ids_.size());
+    for (const auto &[field_id, value] : int_fields) {
+      field_ids_.push_back(field_id);
+      field_values_.push_back(value);
+    }
+  } else {
+    dead_fields_ += old_count - int_fields.size();
+    for (size_t i = 0; i < int_fields.size(); ++i) {
+      field_ids_[slot.field_offset_ + i] = int_fields[i].first;
+      field_values_[slot.field_offset_ + i] = int_fields[i].second;
+    }
+  }
+  slot.field_count_ = static_cast<uint16_t>(int_fields.size());
+  slot.index_type_ = static_cast<int8_t>(index_type);
+
+  if (dead_fields_ > INITIAL_CAPACITY && dead_fields_ * 2 > field_ids_.size()) {
+    CompactFields();
+  }
+}
+
+auto IdDirectory::Size() const -> size_t {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return size_;
+}
+
+void IdDirectory::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  slots_.assign(INITIAL_CAPACITY, Slot{});
+  size_ = 0;
+  field_ids_.clear();
+  field_values_.clear();
+  dead_fields_ = 0;
+}
+
+auto IdDirectory::InternField(const std::string &field_name) -> uint32_t {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = field_name_ids_.find(field_name);
+  if (it != field_name_ids_.end()) {
+    return it->second;
+  }
+  auto field_id = static_cast<uint32_t>(field_names_.size());
+  field_names_.push_back(field_name);
+  field_name_ids_.emplace(field_name, field_id);
+  return field_id;
+}
+
+auto IdDirectory::FieldName(uint32_t field_id) const -> std::string {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return field_names_.at(field_id);
+}
+
+auto IdDirectory::ExtractIntFields(const rapidjson::Value &data) -> FieldValues {
+  FieldValues fields;
+  if (!data.IsObject()) {
+    return fields;
+  }
+  for (auto it = data.MemberBegin(); it != data.MemberEnd(); ++it) {
+    std::string field_name = it->name.GetString();
+    if (it->value.IsInt() && field_name != REQUEST_ID) {
+      fields.emplace_back(InternField(field_name), it->value.GetInt64());
+    }
+  }
+  // 按字段编号排序, 查找时可以二分
+  std::sort(fields.begin(), fields.end());
+  return fields;
+}
+
+auto IdDirectory::ExtractEncodedIntFields(std::string_view attributes) -> FieldValues {
+  std::vector<std::pair<std::string_view, int64_t>> decoded;
+  FieldValues fields;
+  if (!RecordCodec::DecodeIntFields(attributes, &decoded)) {
+    return fields;
+  }
+  for (const auto &[name, value] : decoded) {
+    if (name != REQUEST_ID) {
+      fields.emplace_back(InternField(std::string(name)), value);
+    }
+  }
+  std::sort(fields.begin(), fields.end());
+  return fields;
+}
+
+auto IdDirectory::FindField(const FieldValues &fields, uint32_t field_id, int64_t *value) -> bool {
+  auto it = std::lower_bound(fields.begin(), fields.end(), field_id,
+                             [](const std::pair<uint32_t, int64_t> &field, uint32_t key) { return field.first < key; });
+  if (it == fields.end() || it->first != field_id) {
+    return false;
+  }
+  *value = it->second;
+  return true;
+}
+
+}  // namespace vectordb
@@ -2,184 +2,350 @@
 #include <rapidjson/document.h>      // 包含 <rapidjson/document.h> 以使用 rapidjson::Document 类型
 #include <rapidjson/stringbuffer.h>  // 包含 rapidjson/stringbuffer.h 以使用 StringBuffer 类
 #include <rapidjson/writer.h>        // 包含 rapidjson/writer.h 以使用 Writer 类
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <future>
 #include <iostream>
+#include <iterator>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include "common/constants.h"
+#include "common/file_util.h"
 #include "common/vector_utils.h"
+#include "database/record_codec.h"
 #include "logger/logger.h"
 namespace vectordb {
 
-Persistence::Persistence() : increase_id_(10), last_snapshot_id_(0) {}
+namespace {
 
-Persistence::~Persistence() {
-  if (wal_log_file_.is_open()) {
-    wal_log_file_.close();
+void LinkOrCopyFile(const std::filesystem::path &from, const std::filesystem::path &to) {
+  std::error_code ec;
+  std::filesystem::create_hard_link(from, to, ec);
+  if (ec) {
+    std::filesystem::copy_file(from, to, std::filesystem::copy_options::overwrite_existing);
   }
 }
 
-void Persistence::Init(const std::string &local_path) {
-  if (!std::filesystem::exists(local_path)) {
-    // 文件不存在，先创建文件
-    std::ofstream temp_file(local_path);
-    temp_file.close();
-  }
+struct DecodedWalSegment {
+  std::vector<WalReplayRecord> records_;
+  uint64_t max_log_id_ = 0;
+  uint64_t skipped_ = 0;  // 已被快照覆盖的记录数
+};
 
-  wal_log_file_.open(local_path, std::ios::in | std::ios::out |
-                                     std::ios::app);  // 以 std::ios::in | std::ios::out | std::ios::app 模式打开文件
-  if (!wal_log_file_.is_open()) {
-    global_logger->error("An error occurred while writing the WAL log entry. Reason: {}",
-                         std::strerror(errno));  // 使用日志打印错误消息和原因
-    throw std::runtime_error("Failed to open WAL log file at path: " + local_path);
+auto DecodeWalSegment(const std::string &path, uint64_t last_snapshot_id) -> DecodedWalSegment {
+  DecodedWalSegment result;
+  WalReader reader(path);
+  WalRecord::Entry entry;
+  while (reader.Next(&entry)) {
+    result.max_log_id_ = std::max(result.max_log_id_, entry.log_id_);
+    if (entry.log_id_ <= last_snapshot_id) {
+      ++result.skipped_;
+      continue;
+    }
+    WalReplayRecord record;
+    record.log_id_ = entry.log_id_;
+    record.operation_type_ = WalRecord::OpName(entry.op_);
+    if (!RecordCodec::Decode(entry.payload_, &record.data_)) {
+      global_logger->error("Failed to decode WAL log entry: log_id={}", entry.log_id_);
+      continue;
+    }
+    result.records_.push_back(std::move(record));
   }
-
-  LoadLastSnapshotId(Cfg::Instance().SnapPath());
+  return result;
 }
 
-auto Persistence::IncreaseId() -> uint64_t {
-  increase_id_++;
-  return increase_id_;
+// 排序器: 记录已按 WAL 顺序排列, 同一个 id 只保留最后一次写入, 其余记录的相对顺序不变.
+// 留下的记录 id 互不相同, 上层可以放心地批量、并行插入索引
+void SequenceWalRecords(std::vector<WalReplayRecord> *records) {
+  std::unordered_map<uint64_t, size_t> last_position;
+  for (size_t i = 0; i < records->size(); ++i) {
+    const auto &data = (*records)[i].data_;
+    if (data.IsObject() && data.HasMember(REQUEST_ID) && data[REQUEST_ID].IsUint64()) {
+      last_position[data[REQUEST_ID].GetUint64()] = i;
+    }
+  }
+  size_t kept = 0;
+  for (size_t i = 0; i < records->size(); ++i) {
+    const auto &data = (*records)[i].data_;
+    bool has_id = data.IsObject() && data.HasMember(REQUEST_ID) && data[REQUEST_ID].IsUint64();
+    if (has_id && last_position[data[REQUEST_ID].GetUint64()] != i) {
+      continue;
+    }
+    if (kept != i) {
+      (*records)[kept] = std::move((*records)[i]);
+    }
+    ++kept;
+  }
+  records->resize(kept);
 }
 
-auto Persistence::GetId() const -> uint64_t { return increase_id_; }
-
-void Persistence::WriteWalLog(const std::string &operation_type, const rapidjson::Document &json_data,
-                              const std::string &version) {  // 添加 version 参数
-  uint64_t log_id = IncreaseId();
+}  // namespace
 
-  rapidjson::StringBuffer buffer;
-  rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-  json_data.Accept(writer);
+Persistence::Persistence() : increase_id_(10), last_snapshot_id_(0) {}
 
-  std::string json_data_str = buffer.GetString();
-  // 拼接日志条目
-  std::ostringstream oss;
-  oss << log_id << "|" << version << "|" << operation_type << "|" << json_data_str;
+Persistence::~Persistence() = default;
 
-  // 压缩日志条目
-  std::string compressed_data;
-  snappy::Compress(oss.str().c_str(), oss.str().size(), &compressed_data);
+void Persistence::Init(const std::string &local_path, IndexFactory *index_factory, const std::string &snap_path) {
+  wal_dir_ = local_path;
+  index_factory_ = index_factory != nullptr ? index_factory : &IndexFactory::Instance();
+  snap_path_ = snap_path.empty() ? Cfg::Instance().SnapPath() : snap_path;
+  std::filesystem::create_directories(snap_path_);
+  MigrateSingleFileWal(local_path);
+  auto segments = WalSegment::List(local_path);
+  if (!segments.empty() && !segments.back().sealed_) {
+    PrepareWalFile(segments.back().path_);
+  }
 
-  // 写入压缩后的日志条目到文件
-  wal_log_file_ << compressed_data << std::endl;
+  LoadLastSnapshotId(snap_path_);
 
-  if (wal_log_file_.fail()) {  // 检查是否发生错误
-    global_logger->error("An error occurred while writing the WAL log entry. Reason: {}",
-                         std::strerror(errno));  // 使用日志打印错误消息和原因
-  } else {
-    global_logger->debug("Wrote WAL log entry: log_id={}, version={}, operation_type={}, json_data_str={}", log_id,
-                         version, operation_type, buffer.GetString());  // 打印日志
-    wal_log_file_.flush();                                              // 强制持久化
+  // 回放直接从第一个还需要的段开始, 被快照完全覆盖的段不再打开
+  replay_segments_.clear();
+  for (auto &segment : WalSegment::List(local_path)) {
+    if (!segment.sealed_ || segment.max_log_id_ > last_snapshot_id_) {
+      replay_segments_.push_back(std::move(segment.path_));
+    }
   }
+  global_logger->info("WAL replay will read {} segments after snapshot log id {}", replay_segments_.size(),
+                      last_snapshot_id_);
 }
 
-void Persistence::WriteWalRawLog(uint64_t log_id, const std::string &operation_type, const std::string &raw_data,
-                                 const std::string &version) {
-  // 拼接日志条目
-  std::ostringstream oss;
-  oss << log_id << "|" << version << "|" << operation_type << "|" << raw_data;
+void Persistence::MigrateSingleFileWal(const std::string &path) {
+  // 旧版本的 WAL 是单个文件, 改成目录后把它作为第一个段
+  std::string migrating_path = path + ".migrating";
+  if (std::filesystem::is_regular_file(path)) {
+    std::filesystem::rename(path, migrating_path);
+  }
+  if (std::filesystem::exists(migrating_path)) {
+    std::filesystem::create_directories(path);
+    std::filesystem::rename(migrating_path, path + "/" + WalSegment::ActiveName(1));
+    global_logger->info("Moved single-file WAL {} into segment directory", path);
+  }
+}
 
-  // 压缩日志条目
-  std::string compressed_data;
-  snappy::Compress(oss.str().c_str(), oss.str().size(), &compressed_data);
+void Persistence::PrepareWalFile(const std::string &path) {
+  // 不再向 WAL 追加, 崩溃留下的残尾回放时读到坏帧即停, 不用截掉
+  WalReader reader(path);
+  if (reader.IsLegacy()) {
+    ConvertLegacyWal(path);
+  }
+}
 
-  // 写入压缩后的日志条目到文件
-  wal_log_file_ << compressed_data << std::endl;
+void Persistence::ConvertLegacyWal(const std::string &path) {
+  // 旧格式: 每行一个 snappy 压缩的 "log_id|version|op|json"
+  std::ifstream legacy(path, std::ios::in | std::ios::binary);
+  std::string converted(WalRecord::MAGIC, sizeof(WalRecord::MAGIC));
+  std::string compressed_line;
+  uint64_t line_no = 0;
+  uint64_t count = 0;
+  uint64_t skipped = 0;
+  while (std::getline(legacy, compressed_line)) {
+    ++line_no;
+    // 压缩数据里可能含有换行, 被切开的行解压或解析失败, 跳过后继续转换其余的行
+    std::string line;
+    if (!snappy::Uncompress(compressed_line.c_str(), compressed_line.size(), &line)) {
+      global_logger->warn("Skipping legacy WAL line {}: failed to decompress", line_no);
+      ++skipped;
+      continue;
+    }
+    size_t first = line.find('|');
+    size_t second = first == std::string::npos ? first : line.find('|', first + 1);
+    size_t third = second == std::string::npos ? second : line.find('|', second + 1);
+    WalRecord::Op op = WalRecord::Op::UPSERT;
+    rapidjson::Document doc;
+    uint64_t log_id = 0;
+    bool valid = third != std::string::npos && WalRecord::ParseOp(line.substr(second + 1, third - second - 1), &op) &&
+                 !doc.Parse(line.c_str() + third + 1).HasParseError();
+    if (valid) {
+      try {
+        log_id = std::stoull(line.substr(0, first));
+      } catch (const std::exception &) {
+        valid = false;
+      }
+    }
+    if (!valid) {
+      global_logger->warn("Skipping legacy WAL line {}: malformed entry", line_no);
+      ++skipped;
+      continue;
+    }
+    std::string payload;
+    try {
+      payload = RecordCodec::Encode(doc);
+    } catch (const std::exception &e) {
+      global_logger->warn("Skipping legacy WAL line {}: {}", line_no, e.what());
+      ++skipped;
+      continue;
+    }
+    converted.append(WalRecord::Encode(log_id, op, payload));
+    ++count;
+  }
+  legacy.close();
 
-  if (wal_log_file_.fail()) {  // 检查是否发生错误
-    global_logger->error("An error occurred while writing the WAL raw log entry. Reason: {}",
-                         std::strerror(errno));  // 使用日志打印错误消息和原因
-  } else {
-    global_logger->debug("Wrote WAL raw log entry: log_id={}, version={}, operation_type={}, raw_data={}", log_id,
-                         version, operation_type, raw_data);  // 打印日志
-    wal_log_file_.flush();                                    // 强制持久化
+  // 原文件保留为 .legacy, 转换有误时还能找回; 再原子替换, 中途崩溃重启后会重新转换
+  std::string legacy_path = path + ".legacy";
+  std::filesystem::remove(legacy_path);
+  LinkOrCopyFile(path, legacy_path);
+  WriteFileSync(path, converted);
+  if (skipped > 0) {
+    global_logger->error("Skipped {} unreadable legacy WAL lines in {}, original kept at {}", skipped, path,
+                         legacy_path);
   }
+  global_logger->info("Converted {} legacy WAL entries in {} to the binary format", count, path);
 }
 
-void Persistence::ReadNextWalLog(std::string *operation_type, rapidjson::Document *json_data) {
-  global_logger->debug("Reading next WAL log entry");
+auto Persistence::GetId() const -> uint64_t { return increase_id_; }
 
-  std::string compressed_line;
-  while (std::getline(wal_log_file_, compressed_line)) {
-    std::string decompressed_data;
-    if (!snappy::Uncompress(compressed_line.c_str(), compressed_line.size(), &decompressed_data)) {
-      global_logger->error("Failed to decompress WAL log entry");
-      return;
-    }
+void Persistence::AdvanceId(uint64_t log_id) { increase_id_ = std::max(increase_id_.load(), log_id); }
 
-    // 解析解压后的日志条目
-    std::istringstream iss(decompressed_data);
+void Persistence::ReplayWal(const std::function<void(std::vector<WalReplayRecord> *)> &apply) {
+  size_t threads = std::max(1U, std::thread::hardware_concurrency());
+  size_t total_segments = replay_segments_.size();
+  uint64_t last_snapshot_id = last_snapshot_id_;
+  global_logger->info("Replaying {} WAL segments with {} decode threads", total_segments, threads);
 
-    std::string log_id_str;
-    std::string version;
-    std::string json_data_str;
+  // 一组段并行解码, 每个段一个线程
+  auto decode_window = [this, threads, last_snapshot_id](size_t begin) {
+    size_t end = std::min(begin + threads, replay_segments_.size());
+    std::vector<std::future<DecodedWalSegment>> futures;
+    for (size_t i = begin; i < end; ++i) {
+      futures.push_back(std::async(std::launch::async, DecodeWalSegment, replay_segments_[i], last_snapshot_id));
+    }
+    std::vector<DecodedWalSegment> window;
+    for (auto &future : futures) {
+      window.push_back(future.get());
+    }
+    return window;
+  };
 
-    std::getline(iss, log_id_str, '|');
-    std::getline(iss, version, '|');
-    std::getline(iss, *operation_type, '|');  // 使用指针参数返回 operation_type
-    std::getline(iss, json_data_str, '|');
+  auto start = std::chrono::steady_clock::now();
+  auto last_report = start;
+  uint64_t applied = 0;
+  uint64_t superseded = 0;
+  uint64_t skipped = 0;
+  std::future<std::vector<DecodedWalSegment>> next;
+  if (total_segments > 0) {
+    next = std::async(std::launch::async, decode_window, 0);
+  }
+  for (size_t begin = 0; begin < total_segments; begin += threads) {
+    std::vector<DecodedWalSegment> window = next.get();
+    if (begin + threads < total_segments) {
+      next = std::async(std::launch::async, decode_window, begin + threads);
+    }
 
-    uint64_t log_id = std::stoull(log_id_str);  // 将 log_id_str 转换为 uint64_t 类型
-    if (log_id > increase_id_) {                // 如果 log_id 大于当前 increase_id_
-      increase_id_ = log_id;                    // 更新 increase_id_
+    std::vector<WalReplayRecord> records;
+    for (auto &segment : window) {
+      increase_id_ = std::max(increase_id_.load(), segment.max_log_id_);
+      skipped += segment.skipped_;
+      std::move(segment.records_.begin(), segment.records_.end(), std::back_inserter(records));
     }
+    size_t decoded = records.size();
+    SequenceWalRecords(&records);
+    superseded += decoded - records.size();
 
-    if (log_id > last_snapshot_id_) {
-      json_data->Parse(json_data_str.c_str());  // 使用指针参数返回 json_data
-      global_logger->debug("Read WAL log entry: log_id={}, operation_type={}, json_data_str={}", log_id_str,
-                           *operation_type, json_data_str);
-      return;
+    for (size_t pos = 0; pos < records.size(); pos += REPLAY_APPLY_BATCH) {
+      size_t end = std::min(pos + REPLAY_APPLY_BATCH, records.size());
+      std::vector<WalReplayRecord> batch(std::make_move_iterator(records.begin() + static_cast<int64_t>(pos)),
+                                         std::make_move_iterator(records.begin() + static_cast<int64_t>(end)));
+      apply(&batch);
+      applied += batch.size();
+
+      auto now = std::chrono::steady_clock::now();
+      if (now - last_report >= std::chrono::seconds(REPLAY_PROGRESS_INTERVAL_SEC)) {
+        double seconds = std::chrono::duration<double>(now - start).count();
+        global_logger->info("WAL replay progress: {}/{} segments, {} records applied, {:.0f} records/s",
+                            std::min(begin + threads, total_segments), total_segments, applied, applied / seconds);
+        last_report = now;
+      }
     }
-    // TODO(zhouzj): 增加last_snapshot_id_ 前WAL LOG的清除
-    global_logger->debug("Skip Read WAL log entry: log_id={}, operation_type={}, json_data_str={}", log_id_str,
-                         *operation_type, json_data_str);
   }
-  operation_type->clear();
-  wal_log_file_.clear();
-  global_logger->debug("No more WAL log entries to read");
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  global_logger->info(
+      "WAL replay finished in {:.2f}s: {} records applied, {} superseded, {} covered by snapshot, {:.0f} records/s",
+      seconds, applied, superseded, skipped, seconds > 0 ? applied / seconds : 0.0);
+  replay_segments_.clear();
 }
 
 void Persistence::TakeSnapshot() {          // 移除 takeSnapshot 方法的参数
   global_logger->debug("Taking snapshot");  // 添加调试信息
 
+  std::lock_guard<std::mutex> lock(snapshot_mutex_);
   last_snapshot_id_ = increase_id_;
-  std::string snapshot_folder_path = Cfg::Instance().SnapPath();
-  auto &index_factory = IndexFactory::Instance();  // 通过全局指针获取 IndexFactory 实例
-  index_factory.SaveIndex(snapshot_folder_path);
+  std::string snapshot_folder_path = snap_path_;
+  index_factory_->SaveIndex(snapshot_folder_path);
   SaveLastSnapshotId(snapshot_folder_path);
+
+  // 快照完成后, 完全被覆盖的段不再需要
+  WalSegment::Purge(wal_dir_, last_snapshot_id_);
 }
 
 void Persistence::LoadSnapshot() {           // 添加 loadSnapshot 方法实现
   global_logger->debug("Loading snapshot");  // 添加调试信息
-  auto &index_factory = IndexFactory::Instance();
-  std::string snapshot_folder_path = Cfg::Instance().SnapPath();
-  index_factory.LoadIndex(snapshot_folder_path);  // 将 scalar_storage 传递给 loadIndex 方法
+  std::string snapshot_folder_path = snap_path_;
+  index_factory_->LoadIndex(snapshot_folder_path);  // 将 scalar_storage 传递给 loadIndex 方法
+}
+
+void Persistence::ExportSnapshot(const std::string &dir) {
+  // 索引文件每次保存都是写新文件再改名, 硬链接出去的旧文件不会被改写
+  std::filesystem::create_directories(dir);
+  for (const auto &entry : std::filesystem::directory_iterator(snap_path_)) {
+    if (entry.is_regular_file() && entry.path().extension() == ".index") {
+      LinkOrCopyFile(entry.path(), std::filesystem::path(dir) / entry.path().filename());
+    }
+  }
+}
+
+void Persistence::InstallSnapshot(const std::string &dir, uint64_t log_id) {
+  std::lock_guard<std::mutex> lock(snapshot_mutex_);
+  std::string snapshot_folder_path = snap_path_;
+  std::filesystem::create_directories(snapshot_folder_path);
+  for (const auto &entry : std::filesystem::directory_iterator(dir)) {
+    if (!entry.is_regular_file()) {
+      continue;
+    }
+    std::filesystem::path target = std::filesystem::path(snapshot_folder_path) / entry.path().filename();
+    std::filesystem::path tmp_target = target.string() + ".tmp";
+    std::filesystem::remove(tmp_target);
+    LinkOrCopyFile(entry.path(), tmp_target);
+    std::filesystem::rename(tmp_target, target);
+  }
+  last_snapshot_id_ = log_id;
+  increase_id_ = log_id;
+  SaveLastSnapshotId(snapshot_folder_path);
+  WalSegment::Purge(wal_dir_, last_snapshot_id_);
+  LoadSnapshot();
+  global_logger->info("Installed snapshot indexes from {} at log id {}", dir, log_id);
 }
 
 void Persistence::SaveLastSnapshotId(const std::string &folder_path) {  // 添加 saveLastSnapshotID 方法实现
-  std::string file_path = folder_path + "MaxLogID";
-  std::ofstream file("file_path");
-  if (file.is_open()) {
-    file << last_snapshot_id_;
-    file.close();
-  } else {
-    global_logger->error("Failed to open file snapshots_MaxID for writing");
+  // 先写临时文件再改名, 半截的文件会让重启时跳过错误的 WAL 范围
+  std::string file_path = folder_path + SNAPSHOT_MAX_LOG_ID_FILE;
+  try {
+    WriteFileSync(file_path, std::to_string(last_snapshot_id_));
+  } catch (const std::exception &e) {
+    global_logger->error("Failed to save snapshot max log id to {}: {}", file_path, e.what());
+    throw;
   }
   global_logger->debug("save snapshot Max log ID {}", last_snapshot_id_);  // 添加调试信息
 }
 
 void Persistence::LoadLastSnapshotId(const std::string &folder_path) {  // 添加 loadLastSnapshotID 方法实现
-  std::string file_path = folder_path + ".MaxLogID";
-  std::ifstream file("file_path");
+  std::string file_path = folder_path + SNAPSHOT_MAX_LOG_ID_FILE;
+  std::ifstream file(file_path);
   if (file.is_open()) {
     file >> last_snapshot_id_;
     file.close();
+    // WAL 不再记录复制的写入, 重启后的起始日志 id 至少是快照覆盖的位置
+    increase_id_ = std::max(increase_id_.load(), last_snapshot_id_);
   } else {
-    global_logger->warn("Failed to open file snapshots_MaxID for reading");
+    global_logger->warn("Failed to open file {} for reading", file_path);
   }
 
   global_logger->debug("Loading snapshot Max log ID {}", last_snapshot_id_);  // 添加调试信息
 }
 
-}  // namespace vectordb
\ No newline at end of file
+}  // namespace vectordb
@@ -0,0 +1,287 @@
+#include "database/record_codec.h"
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include "common/constants.h"
+
+namespace vectordb {
+
+namespace {
+
+template <typename T>
+void AppendRaw(std::string *out, T value) {
+  out->append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T>
+auto ReadRaw(std::string_view data, size_t *pos, T *value) -> bool {
+  if (*pos + sizeof(T) > data.size()) {
+    return false;
+  }
+  memcpy(value, data.data() + *pos, sizeof(T));
+  *pos += sizeof(T);
+  return true;
+}
+
+auto IsFloatVector(const rapidjson::Value &value) -> bool {
+  return value.IsArray() &&
+         std::all_of(value.Begin(), value.End(), [](const rapidjson::Value &v) { return v.IsNumber(); });
+}
+
+// 依次访问每个字段, visitor(name, type, payload) 返回 false 时停止
+template <typename Visitor>
+auto VisitFields(std::string_view data, Visitor &&visitor) -> bool {
+  size_t pos = 0;
+  uint8_t version = 0;
+  uint32_t count = 0;
+  if (!ReadRaw(data, &pos, &version) || version != RecordCodec::RECORD_FORMAT_V1 || !ReadRaw(data, &pos, &count)) {
+    return false;
+  }
+  for (uint32_t i = 0; i < count; ++i) {
+    uint16_t name_len = 0;
+    if (!ReadRaw(data, &pos, &name_len) || pos + name_len > data.size()) {
+      return false;
+    }
+    std::string_view name = data.substr(pos, name_len);
+    pos += name_len;
+
+    uint8_t type_byte = 0;
+    if (!ReadRaw(data, &pos, &type_byte)) {
+      return false;
+    }
+    auto type = static_cast<RecordCodec::FieldType>(type_byte);
+    size_t payload_len = 0;
+    switch (type) {
+      case RecordCodec::FieldType::NULL_VALUE:
+      case RecordCodec::FieldType::FALSE_VALUE:
+      case RecordCodec::FieldType::TRUE_VALUE:
+        payload_len = 0;
+        break;
+      case RecordCodec::FieldType::INT64:
+      case RecordCodec::FieldType::UINT64:
+      case RecordCodec::FieldType::DOUBLE:
+        payload_len = 8;
+        break;
+      case RecordCodec::FieldType::STRING:
+      case RecordCodec::FieldType::JSON: {
+        uint32_t len = 0;
+        if (!ReadRaw(data, &pos, &len)) {
+          return false;
+        }
+        payload_len = len;
+        break;
+      }
+      case RecordCodec::FieldType::FLOAT_VECTOR: {
+        uint32_t len = 0;
+        if (!ReadRaw(data, &pos, &len)) {
+          return false;
+        }
+        payload_len = static_cast<size_t>(len) * sizeof(float);
+        break;
+      }
+      default:
+        return false;
+    }
+    if (pos + payload_len > data.size()) {
+      return false;
+    }
+    if (!visitor(name, type, data.substr(pos, payload_len))) {
+      return true;
+    }
+    pos += payload_len;
+  }
+  return true;
+}
+
+}  // namespace
+
+auto RecordCodec::Encode(const rapidjson::Value &doc, bool include_vectors) -> std::string {
+  std::string out;
+  AppendRaw<uint8_t>(&out, RECORD_FORMAT_V1);
+  if (!doc.IsObject()) {
+    AppendRaw<uint32_t>(&out, 0);
+    return out;
+  }
+  bool skip_vectors = !include_vectors && doc.HasMember(REQUEST_VECTORS);
+  AppendRaw<uint32_t>(&out, doc.MemberCount() - (skip_vectors ? 1 : 0));
+  for (auto it = doc.MemberBegin(); it != doc.MemberEnd(); ++it) {
+    if (skip_vectors && it->name == REQUEST_VECTORS) {
+      continue;
+    }
+    if (it->name.GetStringLength() > MAX_FIELD_NAME_LENGTH) {
+      throw std::runtime_error("Field name is longer than " + std::to_string(MAX_FIELD_NAME_LENGTH) + " bytes");
+    }
+    AppendRaw<uint16_t>(&out, static_cast<uint16_t>(it->name.GetStringLength()));
+    out.append(it->name.GetString(), it->name.GetStringLength());
+
+    const auto &value = it->value;
+    if (value.IsNull()) {
+      AppendRaw(&out, static_cast<uint8_t>(FieldType::NULL_VALUE));
+    } else if (value.IsBool()) {
+      AppendRaw(&out, static_cast<uint8_t>(value.GetBool() ? FieldType::TRUE_VALUE : FieldType::FALSE_VALUE));
+    } else if (value.IsInt64()) {
+      AppendRaw(&out, static_cast<uint8_t>(FieldType::INT64));
+      AppendRaw<int64_t>(&out, value.GetInt64());
+    } else if (value.IsUint64()) {
+      AppendRaw(&out, static_cast<uint8_t>(FieldType::UINT64));
+      AppendRaw<uint64_t>(&out, value.GetUint64());
+    } else if (value.IsNumber()) {
+      AppendRaw(&out, static_cast<uint8_t>(FieldType::DOUBLE));
+      AppendRaw<double>(&out, value.GetDouble());
+    } else if (value.IsString()) {
+      AppendRaw(&out, static_cast<uint8_t>(FieldType::STRING));
+      AppendRaw<uint32_t>(&out, value.GetStringLength());
+      out.append(value.GetString(), value.GetStringLength());
+    } else if (it->name == REQUEST_VECTORS && IsFloatVector(value)) {
+      // 向量直接存 float32, 省掉文本化和解析
+      AppendRaw(&out, static_cast<uint8_t>(FieldType::FLOAT_VECTOR));
+      AppendRaw<uint32_t>(&out, value.Size());
+      for (const auto &v : value.GetArray()) {
+        AppendRaw<float>(&out, v.GetFloat());
+      }
+    } else {
+      rapidjson::StringBuffer buffer;
+      rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+      value.Accept(writer);
+      AppendRaw(&out, static_cast<uint8_t>(FieldType::JSON));
+      AppendRaw<uint32_t>(&out, static_cast<uint32_t>(buffer.GetSize()));
+      out.append(buffer.GetString(), buffer.GetSize());
+    }
+  }
+  return out;
+}
+
+auto RecordCodec::Decode(std::string_view data, rapidjson::Document *doc, const std::vector<std::string> &fields)
+    -> bool {
+  doc->SetObject();
+  auto &allocator = doc->GetAllocator();
+  return VisitFields(data, [&](std::string_view name, FieldType type, std::string_view payload) {
+    if (!fields.empty() && std::find(fields.begin(), fields.end(), name) == fields.end()) {
+      return true;
+    }
+    rapidjson::Value value;
+    switch (type) {
+      case FieldType::NULL_VALUE:
+        break;
+      case FieldType::FALSE_VALUE:
+        value.SetBool(false);
+        break;
+      case FieldType::TRUE_VALUE:
+        value.SetBool(true);
+        break;
+      case FieldType::INT64: {
+        int64_t v = 0;
+        memcpy(&v, payload.data(), sizeof(v));
+        value.SetInt64(v);
+        break;
+      }
+      case FieldType::UINT64: {
+        uint64_t v = 0;
+        memcpy(&v, payload.data(), sizeof(v));
+        value.SetUint64(v);
+        break;
+      }
+      case FieldType::DOUBLE: {
+        double v = 0;
+        memcpy(&v, payload.data(), sizeof(v));
+        value.SetDouble(v);
+        break;
+      }
+      case FieldType::STRING:
+        value.SetString(payload.data(), static_cast<rapidjson::SizeType>(payload.size()), allocator);
+        break;
+      case FieldType::FLOAT_VECTOR: {
+        value.SetArray();
+        size_t count = payload.size() / sizeof(float);
+        value.Reserve(static_cast<rapidjson::SizeType>(count), allocator);
+        for (size_t i = 0; i < count; ++i) {
+          float v = 0;
+          memcpy(&v, payload.data() + i * sizeof(float), sizeof(v));
+          value.PushBack(v, allocator);
+        }
+        break;
+      }
+      case FieldType::JSON: {
+        rapidjson::Document nested(&allocator);
+        nested.Parse(payload.data(), payload.size());
+        value.CopyFrom(nested, allocator);
+        break;
+      }
+    }
+    doc->AddMember(rapidjson::Value(name.data(), static_cast<rapidjson::SizeType>(name.size()), allocator), value,
+                   allocator);
+    return true;
+  });
+}
+
+auto RecordCodec::DecodeVector(std::string_view data, std::vector<float> *vector) -> bool {
+  bool found = false;
+  bool ok = VisitFields(data, [&](std::string_view name, FieldType type, std::string_view payload) {
+    if (type != FieldType::FLOAT_VECTOR || name != REQUEST_VECTORS) {
+      return true;
+    }
+    vector->resize(payload.size() / sizeof(float));
+    memcpy(vector->data(), payload.data(), payload.size());
+    found = true;
+    return false;
+  });
+  return ok && found;
+}
+
+auto RecordCodec::DecodeIntFields(std::string_view data, std::vector<std::pair<std::string_view, int64_t>> *fields)
+    -> bool {
+  return VisitFields(data, [&](std::string_view name, FieldType type, std::string_view payload) {
+    if (type != FieldType::INT64) {
+      return true;
+    }
+    int64_t v = 0;
+    memcpy(&v, payload.data(), sizeof(v));
+    if (v >= std::numeric_limits<int32_t>::min() && v <= std::numeric_limits<int32_t>::max()) {
+      fields->emplace_back(name, v);
+    }
+    return true;
+  });
+}
+
+auto RecordCodec::EncodeRawVector(const rapidjson::Value &array) -> std::string {
+  std::string out;
+  if (!IsFloatVector(array)) {
+    return out;
+  }
+  out.reserve(array.Size() * sizeof(float));
+  for (const auto &v : array.GetArray()) {
+    AppendRaw<float>(&out, v.GetFloat());
+  }
+  return out;
+}
+
+void RecordCodec::DecodeRawVector(std::string_view data, std::vector<float> *vector) {
+  vector->resize(data.size() / sizeof(float));
+  memcpy(vector->data(), data.data(), vector->size() * sizeof(float));
+}
+
+auto RecordCodec::EncodeKey(uint64_t id) -> std::string {
+  std::string key(sizeof(uint64_t), '\0');
+  for (int i = 7; i >= 0; --i) {
+    key[i] = static_cast<char>(id & 0xff);
+    id >>= 8;
+  }
+  return key;
+}
+
+auto RecordCodec::DecodeKey(std::string_view key, uint64_t *id) -> bool {
+  if (key.size() != sizeof(uint64_t)) {
+    return false;
+  }
+  uint64_t value = 0;
+  for (char c : key) {
+    value = (value << 8) | static_cast<uint8_t>(c);
+  }
+  *id = value;
+  return true;
+}
+
+}  // namespace vectordb
@@ -1,53 +1,596 @@
 #include "database/scalar_storage.h"
+#include "database/record_codec.h"
 #include "logger/logger.h"
+#include <rocksdb/cache.h>
+#include <rocksdb/convenience.h>
 #include <rocksdb/db.h>
+#include <rocksdb/filter_policy.h>
+#include <rocksdb/table.h>
+#include <rocksdb/utilities/checkpoint.h>
+#include <rocksdb/write_batch.h>
 #include <rapidjson/document.h>
 #include <rapidjson/stringbuffer.h> // 包含rapidjson/stringbuffer.h头文件
 #include <rapidjson/writer.h>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <vector>
+#include "common/constants.h"
 namespace vectordb {
 
-ScalarStorage::ScalarStorage(const std::string& db_path) {
-    rocksdb::Options options;
+namespace {
+
+auto CompressionSupported(rocksdb::CompressionType type) -> bool {
+    static const std::vector<rocksdb::CompressionType> supported = rocksdb::GetSupportedCompressions();
+    return type == rocksdb::kNoCompression || std::find(supported.begin(), supported.end(), type) != supported.end();
+}
+
+auto ParseCompression(const std::string& name) -> rocksdb::CompressionType {
+    rocksdb::CompressionType type = rocksdb::kNoCompression;
+    if (name == "snappy") {
+        type = rocksdb::kSnappyCompression;
+    } else if (name == "lz4") {
+        type = rocksdb::kLZ4Compression;
+    } else if (name == "zstd") {
+        type = rocksdb::kZSTD;
+    } else if (name != "none") {
+        global_logger->warn("Unknown rocksdb compression {}, use none", name);
+    }
+    if (CompressionSupported(type)) {
+        return type;
+    }
+    // 链接的 RocksDB 没有编译这种压缩库时, 按 lz4、snappy 的顺序换一个可用的
+    for (auto fallback : {rocksdb::kLZ4Compression, rocksdb::kSnappyCompression}) {
+        if (CompressionSupported(fallback)) {
+            global_logger->warn("RocksDB is built without {} compression, use {}", name,
+                                fallback == rocksdb::kLZ4Compression ? "lz4" : "snappy");
+            return fallback;
+        }
+    }
+    global_logger->warn("RocksDB is built without {} compression, use none", name);
+    return rocksdb::kNoCompression;
+}
+
+auto ParseCompactionStyle(const std::string& name) -> rocksdb::CompactionStyle {
+    if (name == "universal") {
+        return rocksdb::kCompactionStyleUniversal;
+    }
+    if (name == "fifo") {
+        return rocksdb::kCompactionStyleFIFO;
+    }
+    if (name != "level") {
+        global_logger->warn("Unknown rocksdb compaction style {}, use level", name);
+    }
+    return rocksdb::kCompactionStyleLevel;
+}
+
+auto WantsField(const std::vector<std::string>& fields, const char* field) -> bool {
+    return fields.empty() || std::find(fields.begin(), fields.end(), field) != fields.end();
+}
+
+// 在共用线程池上帮忙解码的任务, 与调用线程一起按块认领
+class DecodeHelper : public ScheduledTask {
+public:
+    explicit DecodeHelper(const std::function<void()>* work) : work_(work) {}
+    void RunScheduled() override { (*work_)(); }
+
+private:
+    const std::function<void()>* work_;
+};
+
+auto VectorDirtyKey(uint64_t seq) -> std::string {
+    // 大端序号, meta CF 中按序号排列, 可以按范围删除
+    return ScalarStorage::VECTOR_DIRTY_PREFIX + RecordCodec::EncodeKey(seq);
+}
+
+}  // namespace
+
+ScalarStorage::ScalarStorage(const std::string& db_path, const RocksDbCfg& cfg, TaskScheduler* decode_scheduler)
+    : db_path_(db_path), cfg_(cfg), decode_scheduler_(decode_scheduler) {
+    Open(db_path, cfg);
+    MigrateIfNeeded();
+}
+
+auto ScalarStorage::BuildCfOptions(const RocksDbCfCfg& cfg) -> rocksdb::ColumnFamilyOptions {
+    rocksdb::ColumnFamilyOptions options;
+    rocksdb::BlockBasedTableOptions table_options;
+    // 每个 column family 独立的 block cache, 避免向量把标量字段挤出缓存
+    table_options.block_cache = rocksdb::NewLRUCache(cfg.block_cache_mb_ << 20);
+    if (cfg.bloom_bits_per_key_ > 0) {
+        table_options.filter_policy.reset(rocksdb::NewBloomFilterPolicy(cfg.bloom_bits_per_key_));
+    }
+    options.table_factory.reset(rocksdb::NewBlockBasedTableFactory(table_options));
+    options.compression = ParseCompression(cfg.compression_);
+    options.compaction_style = ParseCompactionStyle(cfg.compaction_style_);
+    options.write_buffer_size = cfg.write_buffer_mb_ << 20;
+    return options;
+}
+
+void ScalarStorage::Open(const std::string& db_path, const RocksDbCfg& cfg) {
+    rocksdb::DBOptions options;
     options.create_if_missing = true;
-    rocksdb::Status status = rocksdb::DB::Open(options, db_path, &db_);
+    options.create_missing_column_families = true;
+    if (cfg.statistics_) {
+        statistics_ = rocksdb::CreateDBStatistics();
+        options.statistics = statistics_;
+    }
+
+    std::vector<rocksdb::ColumnFamilyDescriptor> descriptors = {
+        {rocksdb::kDefaultColumnFamilyName, rocksdb::ColumnFamilyOptions()},
+        {CF_VECTORS, BuildCfOptions(cfg.vectors_)},
+        {CF_ATTRIBUTES, BuildCfOptions(cfg.attributes_)},
+        {CF_META, BuildCfOptions(cfg.meta_)},
+    };
+    handles_.clear();
+    rocksdb::Status status = rocksdb::DB::Open(options, db_path, descriptors, &handles_, &db_);
     if (!status.ok()) {
         throw std::runtime_error("Failed to open RocksDB: " + status.ToString());
     }
+    vectors_cf_ = handles_[1];
+    attributes_cf_ = handles_[2];
+    meta_cf_ = handles_[3];
+    LoadVectorWriteSeq();
+}
+
+void ScalarStorage::MigrateIfNeeded() {
+    std::string version;
+    if (GetMeta(SCALAR_FORMAT_VERSION_KEY, &version) && version == std::to_string(SCALAR_FORMAT_VERSION)) {
+        return;
+    }
+
+    // 旧数据都在 default CF: v1 为大端 key + 二进制记录, 更早的为十进制 key + JSON
+    std::string legacy_version;
+    rocksdb::Status status = db_->Get(rocksdb::ReadOptions(), SCALAR_FORMAT_VERSION_KEY, &legacy_version);
+    bool binary = status.ok() && legacy_version == std::to_string(RecordCodec::RECORD_FORMAT_V1);
+
+    // 旧 key 只在转换后的记录进入同一个 batch 之后删除, 无法转换的记录留在 default CF 中;
+    // 旧的版本标记最后删除, 中途崩溃重启后仍能按原来的格式识别剩下的 key
+    size_t migrated = 0;
+    size_t skipped = 0;
+    rocksdb::WriteBatch batch;
+    std::unique_ptr<rocksdb::Iterator> it(db_->NewIterator(rocksdb::ReadOptions()));
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        std::string key = it->key().ToString();
+        if (key == SCALAR_FORMAT_VERSION_KEY) {
+            continue;
+        }
+        uint64_t id = 0;
+        rapidjson::Document data;
+        if (binary) {
+            if (!RecordCodec::DecodeKey(key, &id) || !RecordCodec::Decode(it->value().ToStringView(), &data)) {
+                global_logger->warn("Keep corrupted record in default column family during migration");
+                ++skipped;
+                continue;
+            }
+        } else {
+            try {
+                id = std::stoull(key);
+            } catch (const std::exception& e) {
+                global_logger->warn("Keep unexpected key in default column family during migration: {}", key);
+                ++skipped;
+                continue;
+            }
+            data.Parse(it->value().data(), it->value().size());
+            if (data.HasParseError() || !data.IsObject()) {
+                global_logger->warn("Keep unparsable value for id {} in default column family during migration", id);
+                ++skipped;
+                continue;
+            }
+        }
+        PutRecord(&batch, id, data);
+        batch.Delete(key);
+        if (++migrated % SCALAR_MIGRATION_BATCH == 0) {
+            WriteOrThrow(&batch);
+        }
+    }
+    if (!it->status().ok()) {
+        throw std::runtime_error("Failed to scan RocksDB for migration: " + it->status().ToString());
+    }
+    batch.Delete(SCALAR_FORMAT_VERSION_KEY);
+    batch.Put(meta_cf_, SCALAR_FORMAT_VERSION_KEY, std::to_string(SCALAR_FORMAT_VERSION));
+    if (skipped > 0) {
+        batch.Put(meta_cf_, MIGRATION_SKIPPED_KEY, std::to_string(skipped));
+    }
+    WriteOrThrow(&batch);
+    global_logger->info("ScalarStorage migrated {} records to format v{}", migrated, SCALAR_FORMAT_VERSION);
+    if (skipped > 0) {
+        global_logger->error("ScalarStorage kept {} unconvertible legacy records in the default column family",
+                             skipped);
+    }
+}
+
+void ScalarStorage::WriteOrThrow(rocksdb::WriteBatch* batch) {
+    rocksdb::Status status = db_->Write(rocksdb::WriteOptions(), batch);
+    if (!status.ok()) {
+        throw std::runtime_error("Failed to migrate RocksDB: " + status.ToString());
+    }
+    batch->Clear();
 }
 
-ScalarStorage::~ScalarStorage() {
+ScalarStorage::~ScalarStorage() { Close(); }
+
+void ScalarStorage::Close() {
+    for (auto* handle : handles_) {
+        db_->DestroyColumnFamilyHandle(handle);
+    }
+    handles_.clear();
     delete db_;
+    db_ = nullptr;
 }
 
-void ScalarStorage::InsertScalar(uint64_t id, const rapidjson::Document& data) { // 将参数类型更改为rapidjson::Document
-    rapidjson::StringBuffer buffer;
-    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-    data.Accept(writer);
-    std::string value = buffer.GetString();
+void ScalarStorage::CreateCheckpoint(const std::string& dir) {
+    std::shared_lock<std::shared_mutex> lock(db_mutex_);
+    rocksdb::Checkpoint* checkpoint = nullptr;
+    rocksdb::Status status = rocksdb::Checkpoint::Create(db_, &checkpoint);
+    if (status.ok()) {
+        // 同一文件系统上 sst 以硬链接方式导出, 不复制数据
+        status = checkpoint->CreateCheckpoint(dir);
+        delete checkpoint;
+    }
+    if (!status.ok()) {
+        throw std::runtime_error("Failed to create RocksDB checkpoint at " + dir + ": " + status.ToString());
+    }
+}
 
-    rocksdb::Status status = db_->Put(rocksdb::WriteOptions(), std::to_string(id), value);
+void ScalarStorage::RestoreCheckpoint(const std::string& checkpoint_dir) {
+    // 先在旁边准备好新目录再关库替换, 关库期间的读写都在等 db_mutex_.
+    // sst 文件不可变, 可以直接硬链接; MANIFEST、CURRENT 等打开时会被改写的文件复制一份
+    std::string staging = db_path_ + ".restoring";
+    std::filesystem::remove_all(staging);
+    std::filesystem::create_directories(staging);
+    for (const auto& entry : std::filesystem::directory_iterator(checkpoint_dir)) {
+        if (!entry.is_regular_file()) {
+            continue;
+        }
+        std::filesystem::path target = std::filesystem::path(staging) / entry.path().filename();
+        std::error_code ec;
+        if (entry.path().extension() == ".sst") {
+            std::filesystem::create_hard_link(entry.path(), target, ec);
+            if (!ec) {
+                continue;
+            }
+        }
+        std::filesystem::copy_file(entry.path(), target);
+    }
+
+    std::unique_lock<std::shared_mutex> lock(db_mutex_);
+    Close();
+    // 换库之前在 staging 中去掉 leader 的向量刷盘水位, 中途崩溃也不会拿它去判断本地的向量文件
+    Open(staging, cfg_);
+    ResetVectorWatermark();
+    Close();
+    std::filesystem::remove_all(db_path_);
+    std::filesystem::rename(staging, db_path_);
+    Open(db_path_, cfg_);
+    global_logger->info("RocksDB restored from checkpoint {}", checkpoint_dir);
+}
+
+void ScalarStorage::PutRecord(rocksdb::WriteBatch* batch, uint64_t id, const rapidjson::Value& data) {
+    std::string key = RecordCodec::EncodeKey(id);
+    batch->Put(attributes_cf_, key, RecordCodec::Encode(data, false));
+    if (data.HasMember(REQUEST_VECTORS)) {
+        batch->Put(vectors_cf_, key, RecordCodec::EncodeRawVector(data[REQUEST_VECTORS]));
+    } else {
+        batch->Delete(vectors_cf_, key);
+    }
+}
+
+void ScalarStorage::InsertScalar(uint64_t id, const rapidjson::Document& data, uint64_t log_id) {
+    std::shared_lock<std::shared_mutex> lock(db_mutex_);
+    // 向量、标量字段和已应用的日志 id 在同一个 WriteBatch 中原子写入
+    rocksdb::WriteBatch batch;
+    PutRecord(&batch, id, data);
+    MarkVectorsDirty(&batch, {id});
+    if (log_id != 0) {
+        batch.Put(meta_cf_, APPLIED_LOG_ID_KEY, std::to_string(log_id));
+    }
+    rocksdb::Status status = db_->Write(rocksdb::WriteOptions(), &batch);
     if (!status.ok()) {
         global_logger->error("Failed to insert scalar: {}", status.ToString()); // 使用GlobalLogger打印错误日志
     }
 }
 
-auto ScalarStorage::GetScalar(uint64_t id) -> rapidjson::Document { // 将返回类型更改为rapidjson::Document
-    std::string value;
-    rocksdb::Status status = db_->Get(rocksdb::ReadOptions(), std::to_string(id), &value);
+void ScalarStorage::InsertScalarBatch(const std::vector<std::pair<uint64_t, const rapidjson::Document*>>& records,
+                                      uint64_t log_id) {
+    std::shared_lock<std::shared_mutex> lock(db_mutex_);
+    rocksdb::WriteBatch batch;
+    std::vector<uint64_t> ids;
+    ids.reserve(records.size());
+    for (const auto& [id, data] : records) {
+        PutRecord(&batch, id, *data);
+        ids.push_back(id);
+    }
+    MarkVectorsDirty(&batch, ids);
+    if (log_id != 0) {
+        batch.Put(meta_cf_, APPLIED_LOG_ID_KEY, std::to_string(log_id));
+    }
+    rocksdb::Status status = db_->Write(rocksdb::WriteOptions(), &batch);
     if (!status.ok()) {
-        return rapidjson::Document(); // 返回一个空的rapidjson::Document对象
+        global_logger->error("Failed to insert scalar batch of {}: {}", records.size(), status.ToString());
     }
+}
 
+void ScalarStorage::InsertEncodedBatch(const std::vector<EncodedScalar>& records, uint64_t log_id) {
+    std::shared_lock<std::shared_mutex> lock(db_mutex_);
+    rocksdb::WriteBatch batch;
+    std::vector<uint64_t> ids;
+    ids.reserve(records.size());
+    for (const auto& record : records) {
+        ids.push_back(record.id_);
+        std::string key = RecordCodec::EncodeKey(record.id_);
+        batch.Put(attributes_cf_, key, rocksdb::Slice(record.attributes_.data(), record.attributes_.size()));
+        if (!record.vector_.empty()) {
+            batch.Put(vectors_cf_, key, rocksdb::Slice(record.vector_.data(), record.vector_.size()));
+        } else {
+            batch.Delete(vectors_cf_, key);
+        }
+    }
+    MarkVectorsDirty(&batch, ids);
+    if (log_id != 0) {
+        batch.Put(meta_cf_, APPLIED_LOG_ID_KEY, std::to_string(log_id));
+    }
+    rocksdb::Status status = db_->Write(rocksdb::WriteOptions(), &batch);
+    if (!status.ok()) {
+        global_logger->error("Failed to insert encoded batch of {}: {}", records.size(), status.ToString());
+    }
+}
+
+auto ScalarStorage::GetScalar(uint64_t id) -> rapidjson::Document { // 将返回类型更改为rapidjson::Document
+    std::vector<rapidjson::Document> results = MultiGetScalar({id});
     rapidjson::Document data;
-    data.Parse(value.c_str());
+    data.Swap(results[0]);
 
-    // 打印从ScalarStorage获取的数据和rocksdb::Status status
-    rapidjson::StringBuffer buffer;
-    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-    data.Accept(writer);
-    global_logger->debug("Data retrieved from ScalarStorage: {}, RocksDB status: {}", buffer.GetString(), status.ToString()); // 添加rocksdb::Status status
+    // 打印从ScalarStorage获取的数据
+    if (data.IsObject() && global_logger->should_log(spdlog::level::debug)) {
+        rapidjson::StringBuffer buffer;
+        rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+        data.Accept(writer);
+        global_logger->debug("Data retrieved from ScalarStorage: {}", buffer.GetString());
+    }
 
     return data;
 }
-}  // namespace vectordb
\ No newline at end of file
+
+auto ScalarStorage::MultiGetScalar(const std::vector<uint64_t>& ids, const std::vector<std::string>& fields)
+    -> std::vector<rapidjson::Document> {
+    std::shared_lock<std::shared_mutex> lock(db_mutex_);
+    // 只有需要 vectors 字段时才去读 vectors column family
+    bool with_vectors = WantsField(fields, REQUEST_VECTORS);
+    size_t n = ids.size();
+    size_t num_keys = with_vectors ? n * 2 : n;
+
+    std::vector<std::string> key_strs;
+    key_strs.reserve(n);
+    for (auto id : ids) {
+        key_strs.push_back(RecordCodec::EncodeKey(id));
+    }
+    std::vector<rocksdb::Slice> keys(num_keys);
+    std::vector<rocksdb::ColumnFamilyHandle*> cfs(num_keys);
+    for (size_t i = 0; i < n; ++i) {
+        keys[i] = key_strs[i];
+        cfs[i] = attributes_cf_;
+        if (with_vectors) {
+            keys[n + i] = key_strs[i];
+            cfs[n + i] = vectors_cf_;
+        }
+    }
+    std::vector<rocksdb::PinnableSlice> values(num_keys);
+    std::vector<rocksdb::Status> statuses(num_keys);
+
+    // 批量接口一次下发所有 key, 同一 SST block 内的 key 只读一次; 支持时走异步 IO 并发读盘
+    rocksdb::ReadOptions read_options;
+    read_options.async_io = true;
+    db_->MultiGet(read_options, num_keys, cfs.data(), keys.data(), values.data(), statuses.data());
+
+    std::vector<rapidjson::Document> results(n);
+    auto decode = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            if (!statuses[i].ok()) {
+                if (!statuses[i].IsNotFound()) {
+                    global_logger->error("Failed to get scalar {}: {}", ids[i], statuses[i].ToString());
+                }
+                continue;
+            }
+            const rocksdb::Slice* vector = (with_vectors && statuses[n + i].ok()) ? &values[n + i] : nullptr;
+            DecodeScalar(values[i], vector, fields, &results[i]);
+        }
+    };
+
+    // 解码是主要开销, 结果较多时在共用线程池上按块并行解码, 不为每个请求开线程.
+    // 块由调用线程和池中的任务共同认领, 线程池忙时调用线程自己解码完所有块
+    size_t chunks = (n + MULTI_GET_DECODE_CHUNK - 1) / MULTI_GET_DECODE_CHUNK;
+    if (decode_scheduler_ == nullptr || chunks <= 1) {
+        decode(0, n);
+        return results;
+    }
+    std::atomic<size_t> next_chunk{0};
+    std::function<void()> work = [&]() {
+        for (size_t c = next_chunk++; c < chunks; c = next_chunk++) {
+            decode(c * MULTI_GET_DECODE_CHUNK, std::min(n, (c + 1) * MULTI_GET_DECODE_CHUNK));
+        }
+    };
+    std::vector<std::unique_ptr<DecodeHelper>> helpers;
+    for (size_t i = 0; i < std::min(chunks - 1, MULTI_GET_MAX_HELPERS); ++i) {
+        helpers.push_back(std::make_unique<DecodeHelper>(&work));
+        decode_scheduler_->Schedule(helpers.back().get());
+    }
+    work();
+    // 还没轮到的任务直接移出队列, 正在运行的等它解码完手上的块
+    for (auto& helper : helpers) {
+        decode_scheduler_->Remove(helper.get());
+    }
+    return results;
+}
+
+void ScalarStorage::DecodeScalar(const rocksdb::Slice& attributes, const rocksdb::Slice* vector,
+                                 const std::vector<std::string>& fields, rapidjson::Document* result) {
+    // 二进制记录可以按字段跳过, 投影时不需要解码整条记录
+    if (!RecordCodec::Decode(attributes.ToStringView(), result, fields)) {
+        global_logger->error("Corrupted scalar record");
+        rapidjson::Document().Swap(*result);
+        return;
+    }
+    if (vector != nullptr) {
+        std::vector<float> values;
+        RecordCodec::DecodeRawVector(vector->ToStringView(), &values);
+        auto& allocator = result->GetAllocator();
+        rapidjson::Value array(rapidjson::kArrayType);
+        array.Reserve(static_cast<rapidjson::SizeType>(values.size()), allocator);
+        for (float v : values) {
+            array.PushBack(v, allocator);
+        }
+        result->AddMember(REQUEST_VECTORS, array, allocator);
+    }
+}
+
+void ScalarStorage::ForEach(const std::function<void(uint64_t, const rapidjson::Document&)>& callback,
+                            bool with_vectors) {
+    std::shared_lock<std::shared_mutex> lock(db_mutex_);
+    rocksdb::ReadOptions read_options;
+    read_options.fill_cache = false; // 全量扫描不污染 block cache
+    std::unique_ptr<rocksdb::Iterator> it(db_->NewIterator(read_options, attributes_cf_));
+    std::unique_ptr<rocksdb::Iterator> vec_it;
+    if (with_vectors) {
+        vec_it.reset(db_->NewIterator(read_options, vectors_cf_));
+        vec_it->SeekToFirst();
+    }
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        uint64_t id = 0;
+        if (!RecordCodec::DecodeKey(it->key().ToStringView(), &id)) {
+            continue;
+        }
+        // 两个 column family 的 key 顺序一致, 向量迭代器跟随推进
+        while (vec_it != nullptr && vec_it->Valid() && vec_it->key().compare(it->key()) < 0) {
+            vec_it->Next();
+        }
+        rocksdb::Slice vector_value;
+        bool has_vector = vec_it != nullptr && vec_it->Valid() && vec_it->key() == it->key();
+        if (has_vector) {
+            vector_value = vec_it->value();
+        }
+        rapidjson::Document data;
+        DecodeScalar(it->value(), has_vector ? &vector_value : nullptr, {}, &data);
+        if (!data.IsObject()) {
+            global_logger->warn("Skip corrupted value for id {}", id);
+            continue;
+        }
+        callback(id, data);
+    }
+    if (!it->status().ok()) {
+        global_logger->error("Failed to scan ScalarStorage: {}", it->status().ToString());
+    }
+}
+
+void ScalarStorage::PutMeta(const std::string& key, const std::string& value) {
+    std::shared_lock<std::shared_mutex> lock(db_mutex_);
+    rocksdb::Status status = db_->Put(rocksdb::WriteOptions(), meta_cf_, key, value);
+    if (!status.ok()) {
+        global_logger->error("Failed to put meta {}: {}", key, status.ToString());
+    }
+}
+
+auto ScalarStorage::GetMeta(const std::string& key, std::string* value) -> bool {
+    std::shared_lock<std::shared_mutex> lock(db_mutex_);
+    return db_->Get(rocksdb::ReadOptions(), meta_cf_, key, value).ok();
+}
+
+void ScalarStorage::MarkVectorsDirty(rocksdb::WriteBatch* batch, const std::vector<uint64_t>& ids) {
+    if (ids.empty()) {
+        return;
+    }
+    // 序号在向量存储写完之后才分配, 取到序号 seq 的 msync 一定覆盖序号更小的批次
+    uint64_t seq = vector_write_seq_.fetch_add(1);
+    batch->Put(meta_cf_, VectorDirtyKey(seq),
+               rocksdb::Slice(reinterpret_cast<const char*>(ids.data()), ids.size() * sizeof(uint64_t)));
+}
+
+void ScalarStorage::LoadVectorWriteSeq() {
+    uint64_t seq = 0;
+    std::string value;
+    if (db_->Get(rocksdb::ReadOptions(), meta_cf_, VECTOR_FLUSHED_SEQ_KEY, &value).ok()) {
+        seq = std::stoull(value);
+    }
+    std::unique_ptr<rocksdb::Iterator> it(db_->NewIterator(rocksdb::ReadOptions(), meta_cf_));
+    it->SeekForPrev(VectorDirtyKey(std::numeric_limits<uint64_t>::max()));
+    uint64_t last = 0;
+    if (it->Valid() && it->key().starts_with(VECTOR_DIRTY_PREFIX) &&
+        RecordCodec::DecodeKey(it->key().ToStringView().substr(std::strlen(VECTOR_DIRTY_PREFIX)), &last)) {
+        seq = std::max(seq, last + 1);
+    }
+    vector_write_seq_ = seq;
+}
+
+void ScalarStorage::ResetVectorWatermark() {
+    rocksdb::WriteBatch batch;
+    batch.Delete(meta_cf_, VECTOR_FLUSHED_SEQ_KEY);
+    batch.DeleteRange(meta_cf_, VectorDirtyKey(0), VectorDirtyKey(std::numeric_limits<uint64_t>::max()));
+    rocksdb::Status status = db_->Write(rocksdb::WriteOptions(), &batch);
+    if (!status.ok()) {
+        throw std::runtime_error("Failed to reset vector watermark: " + status.ToString());
+    }
+    vector_write_seq_ = 0;
+}
+
+void ScalarStorage::MarkVectorsFlushed(uint64_t seq) {
+    std::shared_lock<std::shared_mutex> lock(db_mutex_);
+    rocksdb::WriteBatch batch;
+    batch.Put(meta_cf_, VECTOR_FLUSHED_SEQ_KEY, std::to_string(seq));
+    batch.DeleteRange(meta_cf_, VectorDirtyKey(0), VectorDirtyKey(seq));
+    rocksdb::Status status = db_->Write(rocksdb::WriteOptions(), &batch);
+    if (!status.ok()) {
+        global_logger->error("Failed to mark vectors flushed at {}: {}", seq, status.ToString());
+    }
+}
+
+auto ScalarStorage::UnflushedVectorIds(std::vector<uint64_t>* ids) -> bool {
+    std::string value;
+    if (!GetMeta(VECTOR_FLUSHED_SEQ_KEY, &value)) {
+        return false;
+    }
+    std::shared_lock<std::shared_mutex> lock(db_mutex_);
+    ids->clear();
+    std::unique_ptr<rocksdb::Iterator> it(db_->NewIterator(rocksdb::ReadOptions(), meta_cf_));
+    for (it->Seek(VECTOR_DIRTY_PREFIX); it->Valid() && it->key().starts_with(VECTOR_DIRTY_PREFIX); it->Next()) {
+        size_t count = it->value().size() / sizeof(uint64_t);
+        size_t offset = ids->size();
+        ids->resize(offset + count);
+        memcpy(ids->data() + offset, it->value().data(), count * sizeof(uint64_t));
+    }
+    if (!it->status().ok()) {
+        global_logger->warn("Failed to scan unflushed vector ids: {}", it->status().ToString());
+        return false;
+    }
+    std::sort(ids->begin(), ids->end());
+    ids->erase(std::unique(ids->begin(), ids->end()), ids->end());
+    return true;
+}
+
+auto ScalarStorage::AppliedLogId() -> uint64_t {
+    std::string value;
+    if (!GetMeta(APPLIED_LOG_ID_KEY, &value)) {
+        return 0;
+    }
+    return std::stoull(value);
+}
+
+auto ScalarStorage::Stats() -> std::vector<std::pair<std::string, std::string>> {
+    std::shared_lock<std::shared_mutex> lock(db_mutex_);
+    std::vector<std::pair<std::string, std::string>> stats;
+    if (statistics_ != nullptr) {
+        stats.emplace_back("statistics", statistics_->ToString());
+    }
+    for (auto* handle : {vectors_cf_, attributes_cf_, meta_cf_}) {
+        for (const char* property : {"rocksdb.stats", "rocksdb.estimate-num-keys", "rocksdb.block-cache-usage",
+                                     "rocksdb.estimate-live-data-size"}) {
+            std::string value;
+            if (db_->GetProperty(handle, property, &value)) {
+                stats.emplace_back(handle->GetName() + "." + property, value);
+            }
+        }
+    }
+    return stats;
+}
+}  // namespace vectordb
@@ -1,8 +1,14 @@
 #include "database/vector_database.h"
 #include <rapidjson/document.h>
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
+#include <filesystem>
+#include <stdexcept>
+#include <string_view>
 #include <vector>
 #include "common/constants.h"
+#include "database/record_codec.h"
 #include "database/scalar_storage.h"
 #include "index/faiss_index.h"
 #include "index/filter_index.h"
@@ -14,8 +20,123 @@
 
 namespace vectordb {
 
-VectorDatabase::VectorDatabase(const std::string &db_path, const std::string& wal_path) : scalar_storage_(db_path) {
-    persistence_.Init(wal_path); // 初始化 persistence_ 对象
+namespace {
+
+// 向量文件放在与 RocksDB 目录同级的目录中, 安装快照替换 RocksDB 目录时不受影响.
+// 旧版本放在 RocksDB 目录下的文件搬过去, 搬不动就删掉, 由启动时的全量比对从 RocksDB 重建
+auto PrepareVectorStorePath(const std::string &db_path) -> std::string {
+    std::string base = db_path;
+    while (base.size() > 1 && base.back() == '/') {
+        base.pop_back();
+    }
+    std::filesystem::path dir = base + VECTOR_STORE_DIR_SUFFIX;
+    std::filesystem::create_directories(dir);
+    std::filesystem::path path = dir / VECTOR_STORE_FILE_NAME;
+    std::filesystem::path legacy = std::filesystem::path(base) / VECTOR_STORE_FILE_NAME;
+    for (const char *suffix : {".data", ".meta"}) {
+        std::filesystem::path from = legacy.string() + suffix;
+        if (!std::filesystem::exists(from)) {
+            continue;
+        }
+        std::error_code ec;
+        std::filesystem::rename(from, path.string() + suffix, ec);
+        if (ec) {
+            global_logger->warn("Failed to move legacy vector store file {}: {}, rebuild from RocksDB", from.string(),
+                                ec.message());
+            std::filesystem::remove(from, ec);
+            std::filesystem::remove(path.string() + ".data", ec);
+            std::filesystem::remove(path.string() + ".meta", ec);
+        }
+    }
+    return path.string();
+}
+
+}  // namespace
+
+VectorDatabase::VectorDatabase(const std::string &db_path, const std::string& wal_path, const RocksDbCfg& rocksdb_cfg,
+                               IndexFactory* index_factory, const std::string& snap_path,
+                               TaskScheduler* decode_scheduler)
+    : scalar_storage_(db_path, rocksdb_cfg, decode_scheduler),
+      vector_store_(PrepareVectorStorePath(db_path)),
+      index_factory_(index_factory != nullptr ? index_factory : &IndexFactory::Instance()),
+      snap_path_(snap_path.empty() ? Cfg::Instance().SnapPath() : snap_path) {
+    persistence_.Init(wal_path, index_factory_, snap_path_); // 初始化 persistence_ 对象
+    WarmUpIdDirectory();
+}
+
+VectorDatabase::~VectorDatabase() { FlushVectorStore(); }
+
+void VectorDatabase::WarmUpIdDirectory() {
+    id_directory_.Clear();
+    // 向量文件不逐条 msync, 崩溃后水位之后写入的向量可能缺失或停留在旧值, 以 RocksDB 为准修复.
+    // 没有水位或向量文件为空时逐条比对所有记录
+    std::vector<uint64_t> unflushed;
+    bool incremental = vector_store_.Size() > 0 && scalar_storage_.UnflushedVectorIds(&unflushed);
+    size_t repaired = 0;
+    std::vector<float> buffer;
+    scalar_storage_.ForEach(
+        [this, incremental, &repaired, &buffer](uint64_t id, const rapidjson::Document &data) {
+            id_directory_.Put(id, GetIndexTypeFromRequest(data), id_directory_.ExtractIntFields(data));
+            if (!incremental && RepairStoredVector(id, data, &buffer)) {
+                ++repaired;
+            }
+        },
+        !incremental);
+    for (size_t begin = 0; begin < unflushed.size(); begin += VECTOR_REPAIR_BATCH) {
+        std::vector<uint64_t> ids(unflushed.begin() + begin,
+                                  unflushed.begin() + std::min(unflushed.size(), begin + VECTOR_REPAIR_BATCH));
+        std::vector<rapidjson::Document> docs = scalar_storage_.MultiGetScalar(ids, {REQUEST_VECTORS});
+        for (size_t i = 0; i < ids.size(); ++i) {
+            if (RepairStoredVector(ids[i], docs[i], &buffer)) {
+                ++repaired;
+            }
+        }
+    }
+
+    // RocksDB 中已经没有的 id 不能留在向量文件里, 否则精排会用到它
+    size_t removed = 0;
+    for (uint64_t id : vector_store_.Ids()) {
+        if (!id_directory_.Contains(id)) {
+            vector_store_.Remove(id);
+            ++removed;
+        }
+    }
+    if (repaired > 0 || removed > 0) {
+        global_logger->warn("Vector store repaired {} missing or stale vectors and removed {} orphans from RocksDB",
+                            repaired, removed);
+    }
+    FlushVectorStore();
+    global_logger->info("Id directory warmed up with {} ids, vector store checked {}", id_directory_.Size(),
+                        incremental ? std::to_string(unflushed.size()) + " unflushed ids" : "all records");
+}
+
+auto VectorDatabase::RepairStoredVector(uint64_t id, const rapidjson::Document &data, std::vector<float> *buffer)
+    -> bool {
+    if (!data.IsObject() || !data.HasMember(REQUEST_VECTORS) || !data[REQUEST_VECTORS].IsArray()) {
+        if (!vector_store_.Contains(id)) {
+            return false;
+        }
+        vector_store_.Remove(id);
+        return true;
+    }
+    std::vector<float> vector;
+    vector.reserve(data[REQUEST_VECTORS].Size());
+    for (const auto &v : data[REQUEST_VECTORS].GetArray()) {
+        vector.push_back(v.GetFloat());
+    }
+    if (vector_store_.Get(id, buffer) && *buffer == vector) {
+        return false;
+    }
+    vector_store_.Put(id, vector);
+    return true;
+}
+
+void VectorDatabase::FlushVectorStore() {
+    // 先取序号再 msync, 取到序号之前分配的批次, 向量都已经写进了映射的页
+    uint64_t seq = scalar_storage_.VectorWriteSeq();
+    if (vector_store_.Flush()) {
+        scalar_storage_.MarkVectorsFlushed(seq);
+    }
 }
 
 void VectorDatabase::ReloadDatabase() {
@@ -23,44 +144,96 @@ void VectorDatabase::ReloadDatabase() {
 
     persistence_.LoadSnapshot();
 
-    std::string operation_type;
-    rapidjson::Document json_data;
-    persistence_.ReadNextWalLog(&operation_type, &json_data); // 通过指针的方式调用 readNextWALLog
-
-    while (!operation_type.empty()) {
-        global_logger->info("Operation Type: {}", operation_type);
-
-        // 打印读取的一行内容fmt::detail::buffer
-        rapidjson::StringBuffer buffer;
-        rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-        json_data.Accept(writer);
-        global_logger->info("Read Line: {}", buffer.GetString());
+    // applied_log_id 之前的记录标量已经在 RocksDB 中, 只需要重建内存中的 ANN 和过滤索引.
+    // 旧版本写下的 WAL 段在这里回放; 之后 raft 会从快照位置重新提交 raft 日志中的记录
+    uint64_t applied_log_id = scalar_storage_.AppliedLogId();
+    recovered_log_id_ = applied_log_id;
+    size_t replayed = 0;
+    size_t rewritten = 0;
+    persistence_.ReplayWal([this, applied_log_id, &replayed, &rewritten](std::vector<WalReplayRecord>* records) {
+        replayed += records->size();
+        rewritten += ApplyReplayBatch(records, applied_log_id);
+    });
+    global_logger->info("Replayed {} WAL records, {} already in RocksDB (applied log id {}), {} rewritten", replayed,
+                        replayed - rewritten, applied_log_id, rewritten);
+}
 
-       if (operation_type == "upsert") {
-            uint64_t id = json_data[REQUEST_ID].GetUint64();
-            IndexFactory::IndexType index_type = GetIndexTypeFromRequest(json_data);
+auto VectorDatabase::ApplyReplayBatch(std::vector<WalReplayRecord>* records, uint64_t applied_log_id) -> size_t {
+    // 排序器保证同一批内 id 不重复, 索引可以整批插入
+    std::vector<WalReplayRecord*> upserts;
+    std::vector<int64_t> ids;
+    roaring_bitmap_t* id_bitmap = roaring_bitmap_create();
+    for (auto& record : *records) {
+        const rapidjson::Document& data = record.data_;
+        if (record.operation_type_ != "upsert" || !data.IsObject() || !data.HasMember(REQUEST_ID) ||
+            !data.HasMember(REQUEST_VECTORS) || !data[REQUEST_VECTORS].IsArray()) {
+            global_logger->warn("Skip unsupported WAL record: log_id={}, operation_type={}", record.log_id_,
+                                record.operation_type_);
+            continue;
+        }
+        upserts.push_back(&record);
+        ids.push_back(static_cast<int64_t>(data[REQUEST_ID].GetUint64()));
+        roaring_bitmap_add(id_bitmap, static_cast<uint32_t>(data[REQUEST_ID].GetUint64()));
+    }
 
-            Upsert(id, json_data, index_type); // 调用 VectorDatabase::upsert 接口重建数据
+    // 启动时 id 目录反映的是 RocksDB 的最新状态, 并不是快照里索引的状态,
+    // 所以不能按目录里的旧值做增量更新: 先把本批 id 从所有索引和过滤位图中摘掉, 再按回放记录重新加入
+    auto* faiss_index = static_cast<FaissIndex*>(index_factory_->GetIndex(IndexFactory::IndexType::FLAT));
+    auto* hnsw_index = static_cast<HNSWLibIndex*>(index_factory_->GetIndex(IndexFactory::IndexType::HNSW));
+    auto* filter_index = static_cast<FilterIndex*>(index_factory_->GetIndex(IndexFactory::IndexType::FILTER));
+    faiss_index->RemoveVectors(ids);
+    hnsw_index->RemoveVectors(ids);
+    filter_index->RemoveIds(id_bitmap);
+    roaring_bitmap_free(id_bitmap);
+
+    std::vector<float> flat_data;
+    std::vector<int64_t> flat_ids;
+    std::vector<float> hnsw_data;
+    std::vector<int64_t> hnsw_ids;
+    std::vector<std::pair<uint64_t, const rapidjson::Document*>> scalars;
+    uint64_t max_log_id = 0;
+    for (auto* record : upserts) {
+        const rapidjson::Document& data = record->data_;
+        uint64_t id = data[REQUEST_ID].GetUint64();
+        IndexFactory::IndexType index_type = GetIndexTypeFromRequest(data);
+
+        std::vector<float> vector;
+        vector.reserve(data[REQUEST_VECTORS].Size());
+        for (const auto& v : data[REQUEST_VECTORS].GetArray()) {
+            vector.push_back(v.GetFloat());
+        }
+        if (index_type == IndexFactory::IndexType::FLAT) {
+            flat_data.insert(flat_data.end(), vector.begin(), vector.end());
+            flat_ids.push_back(static_cast<int64_t>(id));
+        } else if (index_type == IndexFactory::IndexType::HNSW) {
+            hnsw_data.insert(hnsw_data.end(), vector.begin(), vector.end());
+            hnsw_ids.push_back(static_cast<int64_t>(id));
         }
 
-        // 清空 json_data
-        rapidjson::Document().Swap(json_data);
+        IdDirectory::FieldValues int_fields = id_directory_.ExtractIntFields(data);
+        for (const auto& [field_id, field_value] : int_fields) {
+            filter_index->UpdateIntFieldFilter(id_directory_.FieldName(field_id), nullptr, field_value, id);
+        }
+        id_directory_.Put(id, index_type, std::move(int_fields));
+        vector_store_.Put(id, vector);
 
-        // 读取下一条 WAL 日志
-        operation_type.clear();
-        persistence_.ReadNextWalLog(&operation_type, &json_data);
+        // 已经持久化的记录不再重写 RocksDB
+        if (record->log_id_ > applied_log_id) {
+            scalars.emplace_back(id, &data);
+            max_log_id = std::max(max_log_id, record->log_id_);
+        }
     }
-}
-
-void VectorDatabase::WriteWalLog(const std::string& operation_type, const rapidjson::Document& json_data) {
-    std::string version = "1.0"; // 您可以根据需要设置版本
-    persistence_.WriteWalLog(operation_type, json_data, version); // 将 version 传递给 writeWALLog 方法
-}
 
-void VectorDatabase::WriteWalLogWithId(uint64_t log_id, const std::string& data) {
-    std::string operation_type = "upsert"; // 默认 operation_type 为 upsert
-    std::string version = "1.0"; // 您可以根据需要设置版本
-    persistence_.WriteWalRawLog(log_id, operation_type, data, version); // 调用 persistence_ 的 writeWALRawLog 方法
+    if (!flat_ids.empty()) {
+        faiss_index->InsertVectorsBatch(flat_data, flat_ids);
+    }
+    if (!hnsw_ids.empty()) {
+        hnsw_index->InsertVectorsBatch(hnsw_data, hnsw_ids);
+    }
+    if (!scalars.empty()) {
+        scalar_storage_.InsertScalarBatch(scalars, max_log_id);
+    }
+    return scalars.size();
 }
 
 auto VectorDatabase::GetIndexTypeFromRequest(const rapidjson::Document& json_request) -> IndexFactory::IndexType {
@@ -76,56 +249,132 @@ auto VectorDatabase::GetIndexTypeFromRequest(const rapidjson::Document& json_req
     return IndexFactory::IndexType::UNKNOWN; // 返回UNKNOWN值
 }
 
+void VectorDatabase::RemoveFromIndex(uint64_t id, IndexFactory::IndexType index_type) {
+  void *index = index_factory_->GetIndex(index_type);
+  switch (index_type) {
+    case IndexFactory::IndexType::FLAT: {
+      auto *faiss_index = static_cast<FaissIndex *>(index);
+      faiss_index->RemoveVectors({static_cast<int64_t>(id)});  // 将id转换为long类型
+      break;
+    }
+    case IndexFactory::IndexType::HNSW: {
+      auto *hnsw_index = static_cast<HNSWLibIndex *>(index);
+      hnsw_index->RemoveVectors({static_cast<int64_t>(id)});
+      break;
+    }
+    default:
+      break;
+  }
+}
+
 void VectorDatabase::Upsert(uint64_t id, const rapidjson::Document &data,
-                            vectordb::IndexFactory::IndexType index_type) {
-  // 检查标量存储中是否存在给定ID的向量
-  rapidjson::Document existing_data;  // 修改为驼峰命名
-  try {
-    existing_data = scalar_storage_.GetScalar(id);
-  } catch (const std::runtime_error &e) {
-    // 向量不存在，继续执行插入操作
+                            vectordb::IndexFactory::IndexType index_type, uint64_t log_id) {
+  UpsertBatch({MakeUpsertRecord(id, data, index_type)}, log_id);
+}
+
+auto VectorDatabase::MakeUpsertRecord(uint64_t id, const rapidjson::Document &data,
+                                      IndexFactory::IndexType index_type) -> UpsertRecord {
+  if (!data.HasMember(REQUEST_VECTORS)) {
+    throw std::runtime_error("Missing vectors for id " + std::to_string(id));
+  }
+  std::string raw_vector = RecordCodec::EncodeRawVector(data[REQUEST_VECTORS]);
+  if (raw_vector.empty()) {
+    throw std::runtime_error("Invalid vectors for id " + std::to_string(id));
+  }
+  UpsertRecord record;
+  record.id_ = id;
+  record.index_type_ = index_type;
+  RecordCodec::DecodeRawVector(raw_vector, &record.vector_);
+  record.attributes_ = RecordCodec::Encode(data, false);
+  return record;
+}
+
+auto VectorDatabase::CheckDimension(const UpsertRecord &record, std::string *error) -> bool {
+  size_t dim = record.vector_.size();
+  size_t index_dim = 0;
+  void *index = index_factory_->GetIndex(record.index_type_);
+  if (index != nullptr && record.index_type_ == IndexFactory::IndexType::FLAT) {
+    index_dim = static_cast<FaissIndex *>(index)->Dim();
+  } else if (index != nullptr && record.index_type_ == IndexFactory::IndexType::HNSW) {
+    index_dim = static_cast<HNSWLibIndex *>(index)->Dim();
+  }
+  if (index_dim != 0 && dim != index_dim) {
+    *error = "Vector dimension mismatch for id " + std::to_string(record.id_) + ": index expects " +
+             std::to_string(index_dim) + ", got " + std::to_string(dim);
+    return false;
+  }
+  // 向量存储的维数以第一次写入为准
+  size_t store_dim = vector_store_.Dim();
+  if (store_dim != 0 && dim != store_dim) {
+    *error = "Vector dimension mismatch for id " + std::to_string(record.id_) + ": store expects " +
+             std::to_string(store_dim) + ", got " + std::to_string(dim);
+    return false;
   }
+  return true;
+}
 
-  // 如果存在现有向量，则从索引中删除它
-  if (existing_data.IsObject()) {  // 使用IsObject()检查existingData是否为空
-    std::vector<float> existing_vector(existing_data["vectors"].Size());  // 从JSON数据中提取vectors字段
-    for (rapidjson::SizeType i = 0; i < existing_data["vectors"].Size(); ++i) {
-      existing_vector[i] = existing_data["vectors"][i].GetFloat();
+void VectorDatabase::UpsertBatch(const std::vector<UpsertRecord> &records, uint64_t log_id) {
+  // 一批记录共用一个日志 id, 标量必须在同一个 WriteBatch 中写入:
+  // 否则崩溃时只写了一部分, 重启后按已应用的日志 id 会跳过其余记录.
+  // 重启后 raft 从快照位置重新提交的日志: 标量已经在 RocksDB 中, 跳过 RocksDB 写入
+  bool recommitted = log_id != 0 && log_id <= recovered_log_id_;
+  std::vector<EncodedScalar> scalars;
+  scalars.reserve(records.size());
+  for (const auto &record : records) {
+    // 在 raft 的提交线程上抛出会让所有副本卡在这条日志上, 坏记录只记日志并跳过
+    std::string error;
+    if (!CheckDimension(record, &error)) {
+      global_logger->error("Skip record in log {}: {}", log_id, error);
+      continue;
     }
-
-    void *index = IndexFactory::Instance().GetIndex(index_type);
-    switch (index_type) {
-      case IndexFactory::IndexType::FLAT: {
-        auto *faiss_index = static_cast<FaissIndex *>(index);
-        faiss_index->RemoveVectors({static_cast<int64_t>(id)});  // 将id转换为long类型
-        break;
-      }
-      case IndexFactory::IndexType::HNSW: {
-        auto *hnsw_index = static_cast<HNSWLibIndex *>(index);
-        hnsw_index->RemoveVectors({static_cast<int64_t>(id)});
-        break;
-      }
-      default:
-        break;
+    try {
+      ApplyToIndexes(record, recommitted);
+    } catch (const std::exception &e) {
+      global_logger->error("Skip record {} in log {}: {}", record.id_, log_id, e.what());
+      continue;
     }
+    scalars.push_back({record.id_,
+                       std::string_view(reinterpret_cast<const char *>(record.vector_.data()),
+                                        record.vector_.size() * sizeof(float)),
+                       record.attributes_});
+  }
+  if (!recommitted && !scalars.empty()) {
+    scalar_storage_.InsertEncodedBatch(scalars, log_id);
   }
+  // raft 日志就是恢复日志, 快照记录的位置以已应用的日志 id 为准
+  if (log_id != 0) {
+    persistence_.AdvanceId(log_id);
+  }
+}
 
-  // 将新向量插入索引
-  std::vector<float> new_vector(data["vectors"].Size());  // 从JSON数据中提取vectors字段
-  for (rapidjson::SizeType i = 0; i < data["vectors"].Size(); ++i) {
-    new_vector[i] = data["vectors"][i].GetFloat();
+void VectorDatabase::ApplyToIndexes(const UpsertRecord &record, bool recommitted) {
+  uint64_t id = record.id_;
+  // 通过内存 id 目录判断向量是否存在, 不再同步读取并解析 RocksDB 中的旧文档
+  IdDirectory::Entry existing;
+  bool exists = id_directory_.Lookup(id, &existing);
+
+  // 重新提交的日志: 目录里的旧值不是快照索引的状态, 先把 id 从所有索引中摘掉再按这条日志重新加入
+  if (recommitted) {
+    DetachFromIndexes(id);
+    exists = false;
   }
 
-  void *index = IndexFactory::Instance().GetIndex(index_type);
-  switch (index_type) {
+  // 如果存在现有向量，则从它原来所在的索引中删除
+  if (exists) {
+    RemoveFromIndex(id, existing.index_type_);
+  }
+
+  // 将新向量插入索引
+  void *index = index_factory_->GetIndex(record.index_type_);
+  switch (record.index_type_) {
     case IndexFactory::IndexType::FLAT: {
       auto *faiss_index = static_cast<FaissIndex *>(index);
-      faiss_index->InsertVectors(new_vector, static_cast<int64_t>(id));
+      faiss_index->InsertVectors(record.vector_, static_cast<int64_t>(id));
       break;
     }
     case IndexFactory::IndexType::HNSW: {
       auto *hnsw_index = static_cast<HNSWLibIndex *>(index);
-      hnsw_index->InsertVectors(new_vector, static_cast<int64_t>(id));
+      hnsw_index->InsertVectors(record.vector_, static_cast<int64_t>(id));
       break;
     }
     default:
@@ -133,32 +382,63 @@ void VectorDatabase::Upsert(uint64_t id, const rapidjson::Document &data,
   }
 
   global_logger->debug("try add new filter");  // 添加打印信息
-  // 检查客户写入的数据中是否有 int 类型的 JSON 字段
-  auto *filter_index = static_cast<FilterIndex *>(IndexFactory::Instance().GetIndex(IndexFactory::IndexType::FILTER));
-  for (auto it = data.MemberBegin(); it != data.MemberEnd(); ++it) {
-    std::string field_name = it->name.GetString();
-    global_logger->debug("try filter member {} {}", it->value.IsInt(), field_name);  // 添加打印信息
-    if (it->value.IsInt() && field_name != "id") {                                   // 过滤名称为 "id" 的字段
-      int64_t field_value = it->value.GetInt64();
-      int64_t *old_field_value_p = nullptr;
-      // 如果存在现有向量，则从 FilterIndex 中更新 int 类型字段
-      if (existing_data.IsObject()) {
-        old_field_value_p = static_cast<int64_t *>(malloc(sizeof(int64_t)));
-        *old_field_value_p = existing_data[field_name.c_str()].GetInt64();
-      }
-      filter_index->UpdateIntFieldFilter(field_name, old_field_value_p, field_value, id);
-      delete old_field_value_p;
+  // 检查客户写入的数据中是否有 int 类型的字段, 直接从编码后的标量字段中读取
+  auto *filter_index = static_cast<FilterIndex *>(index_factory_->GetIndex(IndexFactory::IndexType::FILTER));
+  IdDirectory::FieldValues int_fields = id_directory_.ExtractEncodedIntFields(record.attributes_);
+  for (const auto &[field_id, field_value] : int_fields) {
+    std::string field_name = id_directory_.FieldName(field_id);
+    // 旧值直接取自目录, 旧文档里没有该字段时传 nullptr
+    int64_t old_field_value = 0;
+    int64_t *old_field_value_p = nullptr;
+    if (exists && IdDirectory::FindField(existing.int_fields_, field_id, &old_field_value)) {
+      old_field_value_p = &old_field_value;
     }
+    filter_index->UpdateIntFieldFilter(field_name, old_field_value_p, field_value, id);
   }
 
-  // 更新标量存储中的向量
-  scalar_storage_.InsertScalar(id, data);
+  id_directory_.Put(id, record.index_type_, std::move(int_fields));
+  vector_store_.Put(id, record.vector_);
+}
+
+void VectorDatabase::DetachFromIndexes(uint64_t id) {
+  RemoveFromIndex(id, IndexFactory::IndexType::FLAT);
+  RemoveFromIndex(id, IndexFactory::IndexType::HNSW);
+  auto *filter_index = static_cast<FilterIndex *>(index_factory_->GetIndex(IndexFactory::IndexType::FILTER));
+  roaring_bitmap_t *ids = roaring_bitmap_create();
+  roaring_bitmap_add(ids, static_cast<uint32_t>(id));
+  filter_index->RemoveIds(ids);
+  roaring_bitmap_free(ids);
 }
 
 auto VectorDatabase::Query(uint64_t id) -> rapidjson::Document {  // 添加query函数实现
   return scalar_storage_.GetScalar(id);
 }
 
+auto VectorDatabase::MultiQuery(const std::vector<uint64_t> &ids, const std::vector<std::string> &fields)
+    -> std::vector<rapidjson::Document> {
+  return scalar_storage_.MultiGetScalar(ids, fields);
+}
+
+
+auto VectorDatabase::BuildFilterBitmap(const rapidjson::Document& json_request) -> roaring_bitmap_t* {
+    if (!json_request.HasMember("filter") || !json_request["filter"].IsObject()) {
+        return nullptr;
+    }
+    const auto& filter = json_request["filter"];
+    std::string field_name = filter["fieldName"].GetString();
+    std::string op_str = filter["op"].GetString();
+    int64_t value = filter["value"].GetInt64();
+
+    FilterIndex::Operation op = (op_str == "=") ? FilterIndex::Operation::EQUAL : FilterIndex::Operation::NOT_EQUAL;
+
+    // 通过 IndexFactory 的 getIndex 方法获取 FilterIndex
+    auto* filter_index = static_cast<FilterIndex*>(index_factory_->GetIndex(IndexFactory::IndexType::FILTER));
+
+    // 调用 FilterIndex 的 getIntFieldFilterBitmap 方法
+    roaring_bitmap_t* filter_bitmap = roaring_bitmap_create();
+    filter_index->GetIntFieldFilterBitmap(field_name, op, value, filter_bitmap);
+    return filter_bitmap;
+}
 
 auto VectorDatabase::Search(const rapidjson::Document& json_request) -> std::pair<std::vector<int64_t>, std::vector<float>> {
     // 从 JSON 请求中获取查询参数
@@ -168,6 +448,18 @@ auto VectorDatabase::Search(const rapidjson::Document& json_request) -> std::pai
     }
     int k = json_request[REQUEST_K].GetInt();
 
+    // 开启精排时先从近似索引多取 k * refine_factor 个候选
+    int refine_factor = 1;
+    if (json_request.HasMember(REQUEST_REFINE_FACTOR) && json_request[REQUEST_REFINE_FACTOR].IsInt()) {
+        refine_factor = std::max(json_request[REQUEST_REFINE_FACTOR].GetInt(), 1);
+    }
+    // 用 64 位相乘, 候选数截断到 REFINE_MAX_CANDIDATES, 不会溢出成负数
+    int search_k = k;
+    if (refine_factor > 1) {
+        search_k = static_cast<int>(std::max<int64_t>(
+            k, std::min<int64_t>(static_cast<int64_t>(k) * refine_factor, REFINE_MAX_CANDIDATES)));
+    }
+
     // 获取请求参数中的索引类型
     IndexFactory::IndexType index_type = IndexFactory::IndexType::UNKNOWN;
     if (json_request.HasMember(REQUEST_INDEX_TYPE) && json_request[REQUEST_INDEX_TYPE].IsString()) {
@@ -180,52 +472,149 @@ auto VectorDatabase::Search(const rapidjson::Document& json_request) -> std::pai
     }
 
     // 检查请求中是否包含 filter 参数
-    roaring_bitmap_t* filter_bitmap = nullptr;
-    if (json_request.HasMember("filter") && json_request["filter"].IsObject()) {
-        const auto& filter = json_request["filter"];
-        std::string field_name = filter["fieldName"].GetString();
-        std::string op_str = filter["op"].GetString();
-        int64_t value = filter["value"].GetInt64();
+    roaring_bitmap_t* filter_bitmap = BuildFilterBitmap(json_request);
 
-        FilterIndex::Operation op = (op_str == "=") ? FilterIndex::Operation::EQUAL : FilterIndex::Operation::NOT_EQUAL;
+    // 使用本数据库的 IndexFactory 获取索引对象
+    void* index = index_factory_->GetIndex(index_type);
 
-        // 通过 getGlobalIndexFactory 的 getIndex 方法获取 FilterIndex
-        auto* filter_index = static_cast<FilterIndex*>(IndexFactory::Instance().GetIndex(IndexFactory::IndexType::FILTER));
+    // 根据索引类型初始化索引对象并调用 search_vectors 函数
+    std::pair<std::vector<int64_t>, std::vector<float>> results;
+    bool inner_product = false;
+    switch (index_type) {
+        case IndexFactory::IndexType::FLAT: {
+            auto* faiss_index = static_cast<FaissIndex*>(index);
+            results = faiss_index->SearchVectors(query, search_k, filter_bitmap); // 将 filter_bitmap 传递给 search_vectors 方法
+            inner_product = faiss_index->Metric() == faiss::METRIC_INNER_PRODUCT;
+            break;
+        }
+        case IndexFactory::IndexType::HNSW: {
+            auto* hnsw_index = static_cast<HNSWLibIndex*>(index);
+            results = hnsw_index->SearchVectors(query, search_k, filter_bitmap); // 将 filter_bitmap 传递给 search_vectors 方法
+            break;
+        }
+        // 在此处添加其他索引类型的处理逻辑
+        default:
+            break;
+    }
+    if (filter_bitmap != nullptr) {
+        roaring_bitmap_free(filter_bitmap);
+    }
+    if (search_k > k) {
+        return Refine(query, k, inner_product, results);
+    }
+    return results;
+}
 
-        // 调用 FilterIndex 的 getIntFieldFilterBitmap 方法
-        filter_bitmap = roaring_bitmap_create();
-        filter_index->GetIntFieldFilterBitmap(field_name, op, value, filter_bitmap);
+auto VectorDatabase::RangeSearch(const rapidjson::Document& json_request) -> std::pair<std::vector<int64_t>, std::vector<float>> {
+    std::vector<float> query;
+    for (const auto& q : json_request[REQUEST_VECTORS].GetArray()) {
+        query.push_back(q.GetFloat());
+    }
+    float radius = json_request[REQUEST_RADIUS].GetFloat();
+    size_t max_results = DEFAULT_RANGE_SEARCH_MAX_RESULTS;
+    if (json_request.HasMember(REQUEST_MAX_RESULTS) && json_request[REQUEST_MAX_RESULTS].IsUint()) {
+        max_results = json_request[REQUEST_MAX_RESULTS].GetUint();
     }
 
-    // 使用全局 IndexFactory 获取索引对象
-    void* index = IndexFactory::Instance().GetIndex(index_type);
+    IndexFactory::IndexType index_type = GetIndexTypeFromRequest(json_request);
+    roaring_bitmap_t* filter_bitmap = BuildFilterBitmap(json_request);
 
-    // 根据索引类型初始化索引对象并调用 search_vectors 函数
+    void* index = index_factory_->GetIndex(index_type);
     std::pair<std::vector<int64_t>, std::vector<float>> results;
     switch (index_type) {
         case IndexFactory::IndexType::FLAT: {
             auto* faiss_index = static_cast<FaissIndex*>(index);
-            results = faiss_index->SearchVectors(query, k, filter_bitmap); // 将 filter_bitmap 传递给 search_vectors 方法
+            results = faiss_index->RangeSearchVectors(query, radius, max_results, filter_bitmap);
             break;
         }
         case IndexFactory::IndexType::HNSW: {
             auto* hnsw_index = static_cast<HNSWLibIndex*>(index);
-            results = hnsw_index->SearchVectors(query, k, filter_bitmap); // 将 filter_bitmap 传递给 search_vectors 方法
+            results = hnsw_index->RangeSearchVectors(query, radius, max_results, filter_bitmap);
             break;
         }
-        // 在此处添加其他索引类型的处理逻辑
         default:
             break;
     }
-    delete filter_bitmap;
+    if (filter_bitmap != nullptr) {
+        roaring_bitmap_free(filter_bitmap);
+    }
     return results;
 }
+
+auto VectorDatabase::Refine(const std::vector<float>& query, int k, bool inner_product,
+                            const std::pair<std::vector<int64_t>, std::vector<float>>& candidates)
+    -> std::pair<std::vector<int64_t>, std::vector<float>> {
+    size_t dim = vector_store_.Dim();
+    if (dim == 0 || query.size() % dim != 0) {
+        return candidates;
+    }
+    size_t num_queries = query.size() / dim;
+    size_t search_k = candidates.first.size() / num_queries;
+
+    std::vector<int64_t> indices(num_queries * k, -1);
+    std::vector<float> distances(num_queries * k, -1);
+    std::vector<int64_t> candidate_ids;
+    std::vector<float> exact;
+    std::vector<size_t> order(search_k);
+    for (size_t q = 0; q < num_queries; ++q) {
+        const int64_t* ids = candidates.first.data() + q * search_k;
+        candidate_ids.assign(ids, ids + search_k);
+        // 一次批量计算所有候选的精确距离, 内积索引按内积降序, 与近似索引的结果顺序一致
+        if (inner_product) {
+            vector_store_.ComputeInnerProduct(query.data() + q * dim, candidate_ids, &exact);
+        } else {
+            vector_store_.ComputeL2(query.data() + q * dim, candidate_ids, &exact);
+        }
+
+        for (size_t i = 0; i < search_k; ++i) {
+            order[i] = i;
+        }
+        size_t top = std::min<size_t>(k, search_k);
+        std::partial_sort(order.begin(), order.begin() + static_cast<int64_t>(top), order.end(),
+                          [&exact, inner_product](size_t a, size_t b) {
+                              return inner_product ? exact[a] > exact[b] : exact[a] < exact[b];
+                          });
+        for (size_t i = 0; i < top && std::isfinite(exact[order[i]]); ++i) {
+            indices[q * k + i] = ids[order[i]];
+            distances[q * k + i] = exact[order[i]];
+        }
+    }
+    global_logger->debug("Refined {} candidates to top {}", candidates.first.size(), k);
+    return {indices, distances};
+}
 void VectorDatabase::TakeSnapshot() { // 添加 takeSnapshot 方法实现
+    FlushVectorStore();
     persistence_.TakeSnapshot();
 }
 
+void VectorDatabase::PrepareSnapshot(const std::string& dir, uint64_t log_id) {
+    // 在提交线程中调用, RocksDB 正好反映到 log_id; checkpoint 的 sst 都是硬链接, 不会长时间卡住提交
+    persistence_.AdvanceId(log_id);
+    scalar_storage_.CreateCheckpoint(dir + SNAPSHOT_ROCKSDB_DIR);
+}
+
+void VectorDatabase::CreateSnapshot(const std::string& dir) {
+    // 保存期间提交还在继续, 索引文件可能包含 log_id 之后的写入. 安装后 raft 从 log_id 之后重新提交,
+    // ApplyToIndexes 先按 RocksDB 中的旧值摘掉再插入, 重复应用这些写入得到的结果不变
+    TakeSnapshot();
+    persistence_.ExportSnapshot(dir + SNAPSHOT_INDEX_DIR);
+}
+
+void VectorDatabase::InstallSnapshot(const std::string& dir, uint64_t log_id) {
+    // 换库会去掉向量刷盘水位, WarmUpIdDirectory 按新库全量比对向量文件
+    scalar_storage_.RestoreCheckpoint(dir + SNAPSHOT_ROCKSDB_DIR);
+    persistence_.InstallSnapshot(dir + SNAPSHOT_INDEX_DIR, log_id);
+    WarmUpIdDirectory();
+    recovered_log_id_ = scalar_storage_.AppliedLogId();
+    global_logger->info("Installed raft snapshot {} at log id {}", dir, log_id);
+}
+
 auto VectorDatabase::GetStartIndexId() const -> int64_t {
     return persistence_.GetId(); // 通过调用 persistence_ 的 GetID 方法获取起始索引 ID
 }
 
+auto VectorDatabase::StorageStats() -> std::vector<std::pair<std::string, std::string>> {
+    return scalar_storage_.Stats();
+}
+
 }  // namespace vectordb
\ No newline at end of file
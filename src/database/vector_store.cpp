@@ -0,0 +1,311 @@
+#include "database/vector_store.h"
+#include <faiss/utils/distances.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include "logger/logger.h"
+
+namespace vectordb {
+
+namespace {
+
+constexpr char VECTOR_STORE_MAGIC[8] = {'V', 'D', 'B', 'V', 'E', 'C', '0', '1'};
+constexpr uint32_t VECTOR_STORE_VERSION = 1;
+
+auto MapFile(int fd, size_t size) -> void * {
+  void *addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (addr == MAP_FAILED) {
+    throw std::runtime_error(std::string("Failed to mmap vector store: ") + std::strerror(errno));
+  }
+  return addr;
+}
+
+void ResizeFile(int fd, size_t size) {
+  if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+    throw std::runtime_error(std::string("Failed to resize vector store: ") + std::strerror(errno));
+  }
+}
+
+}  // namespace
+
+VectorStore::VectorStore(const std::string &path) : data_path_(path + ".data"), meta_path_(path + ".meta") {
+  OpenFiles();
+}
+
+VectorStore::~VectorStore() {
+  Flush();
+  Unmap();
+  if (data_fd_ >= 0) {
+    close(data_fd_);
+  }
+  if (meta_fd_ >= 0) {
+    close(meta_fd_);
+  }
+}
+
+auto VectorStore::MetaAt(size_t slot) const -> SlotMeta * {
+  return reinterpret_cast<SlotMeta *>(static_cast<char *>(meta_addr_) + sizeof(FileHeader)) + slot;
+}
+
+auto VectorStore::DataAt(size_t slot) const -> float * { return static_cast<float *>(data_addr_) + slot * dim_; }
+
+void VectorStore::OpenFiles() {
+  struct stat st {};
+  if (stat(meta_path_.c_str(), &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(FileHeader)) {
+    // 第一次写入时才知道维度, 届时再创建文件
+    return;
+  }
+
+  meta_fd_ = open(meta_path_.c_str(), O_RDWR);
+  data_fd_ = open(data_path_.c_str(), O_RDWR);
+  if (meta_fd_ < 0 || data_fd_ < 0) {
+    throw std::runtime_error("Failed to open vector store files: " + meta_path_);
+  }
+  FileHeader header{};
+  if (pread(meta_fd_, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+      memcmp(header.magic_, VECTOR_STORE_MAGIC, sizeof(VECTOR_STORE_MAGIC)) != 0 ||
+      header.version_ != VECTOR_STORE_VERSION) {
+    throw std::runtime_error("Invalid vector store file: " + meta_path_);
+  }
+  dim_ = header.dim_;
+  capacity_ = header.capacity_;
+  meta_size_ = sizeof(FileHeader) + capacity_ * sizeof(SlotMeta);
+  data_size_ = capacity_ * dim_ * sizeof(float);
+  ResizeFile(meta_fd_, meta_size_);
+  ResizeFile(data_fd_, data_size_);
+  meta_addr_ = MapFile(meta_fd_, meta_size_);
+  data_addr_ = MapFile(data_fd_, data_size_);
+
+  // 扫描槽位, 重建 id 映射和空闲链表
+  std::vector<uint32_t> stale;
+  for (size_t slot = 0; slot < capacity_; ++slot) {
+    SlotMeta *meta = MetaAt(slot);
+    if (meta->state_ == SLOT_NEVER_USED) {
+      continue;
+    }
+    used_ = slot + 1;
+    next_seq_ = std::max(next_seq_, meta->seq_ + 1);
+    if (meta->state_ != SLOT_LIVE) {
+      free_slots_.push_back(slot);
+      continue;
+    }
+    auto it = id_to_slot_.find(meta->id_);
+    if (it == id_to_slot_.end()) {
+      id_to_slot_.emplace(meta->id_, slot);
+    } else if (MetaAt(it->second)->seq_ < meta->seq_) {
+      // 更新过程中崩溃留下的旧槽位
+      stale.push_back(it->second);
+      it->second = slot;
+    } else {
+      stale.push_back(slot);
+    }
+  }
+  for (auto slot : stale) {
+    MetaAt(slot)->state_ = SLOT_FREE;
+    free_slots_.push_back(slot);
+  }
+  global_logger->info("Vector store opened: dim {}, {} live vectors, {} free slots", dim_, id_to_slot_.size(),
+                      free_slots_.size());
+}
+
+void VectorStore::CreateFiles(size_t dim) {
+  meta_fd_ = open(meta_path_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  data_fd_ = open(data_path_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (meta_fd_ < 0 || data_fd_ < 0) {
+    throw std::runtime_error(std::string("Failed to create vector store files: ") + std::strerror(errno));
+  }
+  dim_ = dim;
+  capacity_ = INITIAL_CAPACITY;
+  meta_size_ = sizeof(FileHeader) + capacity_ * sizeof(SlotMeta);
+  data_size_ = capacity_ * dim_ * sizeof(float);
+  ResizeFile(meta_fd_, meta_size_);
+  ResizeFile(data_fd_, data_size_);
+  meta_addr_ = MapFile(meta_fd_, meta_size_);
+  data_addr_ = MapFile(data_fd_, data_size_);
+
+  auto *header = static_cast<FileHeader *>(meta_addr_);
+  memcpy(header->magic_, VECTOR_STORE_MAGIC, sizeof(VECTOR_STORE_MAGIC));
+  header->dim_ = static_cast<uint32_t>(dim_);
+  header->version_ = VECTOR_STORE_VERSION;
+  header->capacity_ = capacity_;
+}
+
+void VectorStore::Grow(size_t capacity) {
+  // 先扩数据文件再扩 meta, 崩溃时 capacity 不会超过数据文件的实际大小
+  Unmap();
+  data_size_ = capacity * dim_ * sizeof(float);
+  meta_size_ = sizeof(FileHeader) + capacity * sizeof(SlotMeta);
+  ResizeFile(data_fd_, data_size_);
+  ResizeFile(meta_fd_, meta_size_);
+  data_addr_ = MapFile(data_fd_, data_size_);
+  meta_addr_ = MapFile(meta_fd_, meta_size_);
+  capacity_ = capacity;
+  static_cast<FileHeader *>(meta_addr_)->capacity_ = capacity_;
+  global_logger->info("Vector store grown to {} slots", capacity_);
+}
+
+void VectorStore::Unmap() {
+  if (data_addr_ != nullptr) {
+    munmap(data_addr_, data_size_);
+    data_addr_ = nullptr;
+  }
+  if (meta_addr_ != nullptr) {
+    munmap(meta_addr_, meta_size_);
+    meta_addr_ = nullptr;
+  }
+}
+
+void VectorStore::Put(uint64_t id, const std::vector<float> &vector) {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  if (meta_addr_ == nullptr) {
+    CreateFiles(vector.size());
+  }
+  if (vector.size() != dim_) {
+    throw std::runtime_error("Vector dimension mismatch: expect " + std::to_string(dim_) + ", got " +
+                             std::to_string(vector.size()));
+  }
+
+  uint32_t slot = 0;
+  if (!free_slots_.empty()) {
+    slot = free_slots_.back();
+    free_slots_.pop_back();
+  } else {
+    if (used_ == capacity_) {
+      Grow(capacity_ * 2);
+    }
+    slot = static_cast<uint32_t>(used_++);
+  }
+
+  // 先写向量再置为存活, 最后释放旧槽位
+  std::copy(vector.begin(), vector.end(), DataAt(slot));
+  SlotMeta *meta = MetaAt(slot);
+  meta->id_ = id;
+  meta->seq_ = next_seq_++;
+  meta->state_ = SLOT_LIVE;
+
+  auto it = id_to_slot_.find(id);
+  if (it != id_to_slot_.end()) {
+    MetaAt(it->second)->state_ = SLOT_FREE;
+    free_slots_.push_back(it->second);
+    it->second = slot;
+  } else {
+    id_to_slot_.emplace(id, slot);
+  }
+}
+
+void VectorStore::Remove(uint64_t id) {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  auto it = id_to_slot_.find(id);
+  if (it == id_to_slot_.end()) {
+    return;
+  }
+  MetaAt(it->second)->state_ = SLOT_FREE;
+  free_slots_.push_back(it->second);
+  id_to_slot_.erase(it);
+}
+
+auto VectorStore::Get(uint64_t id, std::vector<float> *vector) const -> bool {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  auto it = id_to_slot_.find(id);
+  if (it == id_to_slot_.end()) {
+    return false;
+  }
+  const float *begin = DataAt(it->second);
+  vector->assign(begin, begin + dim_);
+  return true;
+}
+
+auto VectorStore::Contains(uint64_t id) const -> bool {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  return id_to_slot_.find(id) != id_to_slot_.end();
+}
+
+auto VectorStore::Dim() const -> size_t {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  return dim_;
+}
+
+auto VectorStore::Size() const -> size_t {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  return id_to_slot_.size();
+}
+
+auto VectorStore::Ids() const -> std::vector<uint64_t> {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  std::vector<uint64_t> ids;
+  ids.reserve(id_to_slot_.size());
+  for (const auto &[id, slot] : id_to_slot_) {
+    ids.push_back(id);
+  }
+  return ids;
+}
+
+void VectorStore::ComputeL2(const float *query, const std::vector<int64_t> &ids,
+                            std::vector<float> *distances) const {
+  ComputeByIdx(query, ids, false, distances);
+}
+
+void VectorStore::ComputeInnerProduct(const float *query, const std::vector<int64_t> &ids,
+                                      std::vector<float> *products) const {
+  ComputeByIdx(query, ids, true, products);
+}
+
+void VectorStore::ComputeByIdx(const float *query, const std::vector<int64_t> &ids, bool inner_product,
+                               std::vector<float> *results) const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  results->assign(ids.size(), inner_product ? -std::numeric_limits<float>::infinity()
+                                            : std::numeric_limits<float>::infinity());
+
+  // 先把 id 翻译成槽位并剔除不存在的, 剩下的交给 faiss 的 SIMD 批量距离计算
+  std::vector<int64_t> slots;
+  std::vector<size_t> positions;
+  slots.reserve(ids.size());
+  positions.reserve(ids.size());
+  for (size_t i = 0; i < ids.size(); ++i) {
+    if (ids[i] < 0) {
+      continue;
+    }
+    auto it = id_to_slot_.find(static_cast<uint64_t>(ids[i]));
+    if (it != id_to_slot_.end()) {
+      slots.push_back(it->second);
+      positions.push_back(i);
+    }
+  }
+  if (slots.empty()) {
+    return;
+  }
+
+  std::vector<float> valid_results(slots.size());
+  if (inner_product) {
+    faiss::fvec_inner_products_by_idx(valid_results.data(), query, DataAt(0), slots.data(), dim_, 1, slots.size());
+  } else {
+    faiss::fvec_L2sqr_by_idx(valid_results.data(), query, DataAt(0), slots.data(), dim_, 1, slots.size());
+  }
+  for (size_t i = 0; i < positions.size(); ++i) {
+    (*results)[positions[i]] = valid_results[i];
+  }
+}
+
+auto VectorStore::Flush() -> bool {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  bool ok = true;
+  if (data_addr_ != nullptr && msync(data_addr_, data_size_, MS_SYNC) != 0) {
+    global_logger->error("Failed to msync vector data: {}", std::strerror(errno));
+    ok = false;
+  }
+  if (meta_addr_ != nullptr && msync(meta_addr_, meta_size_, MS_SYNC) != 0) {
+    global_logger->error("Failed to msync vector meta: {}", std::strerror(errno));
+    ok = false;
+  }
+  return ok;
+}
+
+}  // namespace vectordb
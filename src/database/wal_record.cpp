@@ -0,0 +1,250 @@
+#include "database/wal_record.h"
+#include <butil/crc32c.h>
+#include <snappy/snappy.h>
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include "logger/logger.h"
+
+namespace vectordb {
+
+namespace {
+
+template <typename T>
+void AppendRaw(std::string *out, T value) {
+  out->append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+auto FrameCrc(uint64_t log_id, uint8_t op, std::string_view payload) -> uint32_t {
+  uint32_t crc = butil::crc32c::Value(reinterpret_cast<const char *>(&log_id), sizeof(log_id));
+  crc = butil::crc32c::Extend(crc, reinterpret_cast<const char *>(&op), sizeof(op));
+  return butil::crc32c::Extend(crc, payload.data(), payload.size());
+}
+
+// 从内存中解析一帧, 数据不完整或校验失败返回 false
+auto ParseFrame(std::string_view data, size_t *pos, WalRecord::Entry *entry) -> bool {
+  if (*pos + WalRecord::HEADER_SIZE > data.size()) {
+    return false;
+  }
+  uint32_t len = 0;
+  uint32_t crc = 0;
+  uint8_t op = 0;
+  const char *header = data.data() + *pos;
+  memcpy(&len, header, sizeof(len));
+  memcpy(&crc, header + 4, sizeof(crc));
+  memcpy(&entry->log_id_, header + 8, sizeof(entry->log_id_));
+  memcpy(&op, header + 16, sizeof(op));
+  if (len > WalRecord::MAX_PAYLOAD_SIZE || *pos + WalRecord::HEADER_SIZE + len > data.size()) {
+    return false;
+  }
+  std::string_view payload = data.substr(*pos + WalRecord::HEADER_SIZE, len);
+  if (FrameCrc(entry->log_id_, op, payload) != crc) {
+    return false;
+  }
+  entry->op_ = static_cast<WalRecord::Op>(op);
+  entry->payload_.assign(payload.data(), payload.size());
+  *pos += WalRecord::HEADER_SIZE + len;
+  return true;
+}
+
+}  // namespace
+
+auto WalRecord::Encode(uint64_t log_id, Op op, std::string_view payload) -> std::string {
+  std::string frame;
+  frame.reserve(HEADER_SIZE + payload.size());
+  auto op_byte = static_cast<uint8_t>(op);
+  AppendRaw(&frame, static_cast<uint32_t>(payload.size()));
+  AppendRaw(&frame, FrameCrc(log_id, op_byte, payload));
+  AppendRaw(&frame, log_id);
+  AppendRaw(&frame, op_byte);
+  frame.append(payload.data(), payload.size());
+  return frame;
+}
+
+auto WalRecord::EncodeBlock(const std::vector<std::string> &frames) -> std::string {
+  std::string raw;
+  uint64_t last_log_id = 0;
+  for (const auto &frame : frames) {
+    raw.append(frame);
+    if (frame.size() >= HEADER_SIZE) {
+      memcpy(&last_log_id, frame.data() + 8, sizeof(last_log_id));
+    }
+  }
+  std::string compressed;
+  snappy::Compress(raw.data(), raw.size(), &compressed);
+  return Encode(last_log_id, Op::BLOCK, compressed);
+}
+
+auto WalRecord::OpName(Op op) -> std::string {
+  switch (op) {
+    case Op::UPSERT:
+      return "upsert";
+    case Op::BLOCK:
+      return "block";
+  }
+  return "unknown";
+}
+
+auto WalRecord::ParseOp(const std::string &name, Op *op) -> bool {
+  if (name == "upsert") {
+    *op = Op::UPSERT;
+    return true;
+  }
+  return false;
+}
+
+auto WalSegment::ActiveName(uint64_t seq) -> std::string {
+  char name[64];
+  snprintf(name, sizeof(name), "wal_%020" PRIu64 ".log", seq);
+  return name;
+}
+
+auto WalSegment::SealedName(uint64_t seq, uint64_t min_log_id, uint64_t max_log_id) -> std::string {
+  char name[96];
+  snprintf(name, sizeof(name), "wal_%020" PRIu64 "_%020" PRIu64 "_%020" PRIu64 ".log", seq, min_log_id, max_log_id);
+  return name;
+}
+
+auto WalSegment::Parse(const std::string &dir, const std::string &file_name, WalSegment *segment) -> bool {
+  uint64_t seq = 0;
+  uint64_t min_log_id = 0;
+  uint64_t max_log_id = 0;
+  int consumed = 0;
+  if (sscanf(file_name.c_str(), "wal_%" SCNu64 "_%" SCNu64 "_%" SCNu64 ".log%n", &seq, &min_log_id, &max_log_id,
+             &consumed) == 3 &&
+      static_cast<size_t>(consumed) == file_name.size()) {
+    *segment = WalSegment{seq, min_log_id, max_log_id, true, dir + "/" + file_name};
+    return true;
+  }
+  consumed = 0;
+  if (sscanf(file_name.c_str(), "wal_%" SCNu64 ".log%n", &seq, &consumed) == 1 &&
+      static_cast<size_t>(consumed) == file_name.size()) {
+    *segment = WalSegment{seq, 0, 0, false, dir + "/" + file_name};
+    return true;
+  }
+  return false;
+}
+
+auto WalSegment::List(const std::string &dir) -> std::vector<WalSegment> {
+  std::vector<WalSegment> segments;
+  std::error_code ec;
+  for (const auto &file : std::filesystem::directory_iterator(dir, ec)) {
+    WalSegment segment;
+    if (file.is_regular_file() && Parse(dir, file.path().filename().string(), &segment)) {
+      segments.push_back(std::move(segment));
+    }
+  }
+  std::sort(segments.begin(), segments.end(),
+            [](const WalSegment &a, const WalSegment &b) { return a.seq_ < b.seq_; });
+  return segments;
+}
+
+auto WalSegment::Purge(const std::string &dir, uint64_t log_id) -> size_t {
+  size_t removed = 0;
+  for (const auto &segment : List(dir)) {
+    if (segment.sealed_ && segment.max_log_id_ <= log_id) {
+      std::error_code ec;
+      if (std::filesystem::remove(segment.path_, ec)) {
+        ++removed;
+      } else {
+        global_logger->warn("Failed to remove WAL segment {}: {}", segment.path_, ec.message());
+      }
+    }
+  }
+  if (removed > 0) {
+    global_logger->info("Purged {} WAL segments covered by log id {}", removed, log_id);
+  }
+  return removed;
+}
+
+WalReader::WalReader(const std::string &path) : file_(path, std::ios::in | std::ios::binary) {
+  if (!file_.is_open()) {
+    return;
+  }
+  char magic[sizeof(WalRecord::MAGIC)];
+  file_.read(magic, sizeof(magic));
+  auto read = static_cast<size_t>(file_.gcount());
+  if (read == sizeof(magic) && memcmp(magic, WalRecord::MAGIC, sizeof(magic)) == 0) {
+    valid_offset_ = sizeof(magic);
+    return;
+  }
+  // 空文件或只写了一半魔数, 都当作没有记录
+  legacy_ = read > 0 && memcmp(magic, WalRecord::MAGIC, read) != 0;
+  file_.close();
+}
+
+auto WalReader::Next(WalRecord::Entry *entry) -> bool {
+  while (true) {
+    if (block_pos_ < block_entries_.size()) {
+      *entry = std::move(block_entries_[block_pos_++]);
+      return true;
+    }
+    uint64_t frame_start = valid_offset_;
+    if (!file_.is_open() || !ReadFrame(entry)) {
+      return false;
+    }
+    if (entry->op_ != WalRecord::Op::BLOCK) {
+      return true;
+    }
+    if (!ExpandBlock(entry->payload_)) {
+      // 整个块都不可用, 截断位置退回到块的开头
+      valid_offset_ = frame_start;
+      return false;
+    }
+  }
+}
+
+auto WalReader::ReadFrame(WalRecord::Entry *entry) -> bool {
+  std::string frame(WalRecord::HEADER_SIZE, '\0');
+  file_.read(frame.data(), static_cast<std::streamsize>(frame.size()));
+  auto read = static_cast<size_t>(file_.gcount());
+  if (read == 0) {
+    return false;  // 正常结束
+  }
+  uint32_t len = 0;
+  memcpy(&len, frame.data(), sizeof(len));
+  if (read == WalRecord::HEADER_SIZE && len <= WalRecord::MAX_PAYLOAD_SIZE) {
+    frame.resize(WalRecord::HEADER_SIZE + len);
+    file_.read(frame.data() + WalRecord::HEADER_SIZE, len);
+    read += static_cast<size_t>(file_.gcount());
+  }
+
+  size_t pos = 0;
+  if (read != frame.size() || !ParseFrame(frame, &pos, entry)) {
+    // 残尾或损坏: 之后的数据都不可信
+    corrupted_ = true;
+    global_logger->warn("WAL frame at offset {} is torn or corrupted, stop reading", valid_offset_);
+    file_.close();
+    return false;
+  }
+  valid_offset_ += frame.size();
+  return true;
+}
+
+auto WalReader::ExpandBlock(const std::string &compressed) -> bool {
+  std::string raw;
+  if (!snappy::Uncompress(compressed.data(), compressed.size(), &raw)) {
+    corrupted_ = true;
+    global_logger->error("Failed to decompress WAL block ending at offset {}", valid_offset_);
+    file_.close();
+    return false;
+  }
+  block_entries_.clear();
+  block_pos_ = 0;
+  size_t pos = 0;
+  while (pos < raw.size()) {
+    WalRecord::Entry inner;
+    if (!ParseFrame(raw, &pos, &inner)) {
+      corrupted_ = true;
+      global_logger->error("Corrupted record inside WAL block ending at offset {}", valid_offset_);
+      file_.close();
+      return false;
+    }
+    block_entries_.push_back(std::move(inner));
+  }
+  return true;
+}
+
+}  // namespace vectordb
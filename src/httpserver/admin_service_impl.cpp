@@ -18,8 +18,15 @@ void AdminServiceImpl::snapshot(::google::protobuf::RpcController *controller, c
   global_logger->debug("Received snapshot request");
   brpc::ClosureGuard done_guard(done);
   auto *cntl = static_cast<brpc::Controller *>(controller);
+  // 没有请求体时从 URL 参数中取 groupId
+  rapidjson::Document json_request;
+  json_request.Parse(cntl->request_attachment().to_string().c_str());
+  RaftGroup *group = FindGroup(groups_, json_request, cntl);
+  if (group == nullptr) {
+    return;
+  }
 
-  vector_database_->TakeSnapshot();  // 调用 VectorDatabase::takeSnapshot
+  group->vector_database_->TakeSnapshot();  // 调用 VectorDatabase::takeSnapshot
 
   rapidjson::Document json_response;
   json_response.SetObject();
@@ -35,9 +42,15 @@ void AdminServiceImpl::SetLeader(::google::protobuf::RpcController *controller,
   global_logger->debug("Received setLeader request");
   brpc::ClosureGuard done_guard(done);
   auto *cntl = static_cast<brpc::Controller *>(controller);
+  rapidjson::Document json_request;
+  json_request.Parse(cntl->request_attachment().to_string().c_str());
+  RaftGroup *group = FindGroup(groups_, json_request, cntl);
+  if (group == nullptr) {
+    return;
+  }
 
   // 将当前节点设置为主节点
-  raft_stuff_->EnableElectionTimeout(10000, 20000);
+  group->raft_stuff_->EnableElectionTimeout(10000, 20000);
 
   rapidjson::Document json_response;
   json_response.SetObject();
@@ -68,8 +81,13 @@ void AdminServiceImpl::AddFollower(::google::protobuf::RpcController *controller
     return;
   }
 
+  RaftGroup *group = FindGroup(groups_, json_request, cntl);
+  if (group == nullptr) {
+    return;
+  }
+
   // 检查当前节点是否为leader
-  if (!raft_stuff_->IsLeader()) {
+  if (!group->raft_stuff_->IsLeader()) {
     global_logger->error("Current node is not the leader");
     cntl->http_response().set_status_code(400);
     SetErrorJsonResponse(cntl, RESPONSE_RETCODE_ERROR, "Invalid JSON request");
@@ -80,9 +98,21 @@ void AdminServiceImpl::AddFollower(::google::protobuf::RpcController *controller
   // 从JSON请求中获取follower节点信息
   int node_id = json_request["nodeId"].GetInt();
   std::string endpoint = json_request["endpoint"].GetString();
+  bool learner = false;
+  if (json_request.HasMember(REQUEST_LEARNER)) {
+    if (!json_request[REQUEST_LEARNER].IsBool()) {
+      global_logger->error("Invalid learner flag");
+      cntl->http_response().set_status_code(400);
+      SetErrorJsonResponse(cntl, RESPONSE_RETCODE_ERROR, "learner must be a boolean");
+      return;
+    }
+    learner = json_request[REQUEST_LEARNER].GetBool();
+  }
 
   // 调用 RaftStuff 的 addSrv 方法将新的follower节点添加到集群中
-  bool success = raft_stuff_->AddSrv(node_id, endpoint);
+  // endpoint 是 follower 组 0 的 raft 地址, 其他组的端口按相同的规则错开
+  endpoint = RaftGroupManager::GroupEndpoint(endpoint, group->group_id_);
+  bool success = group->raft_stuff_->AddSrv(node_id, endpoint, learner);
  
   if (!success) {
     global_logger->error("raft_stuff  AddSrv  failed");
@@ -106,9 +136,15 @@ void AdminServiceImpl::ListNode(::google::protobuf::RpcController *controller, c
   global_logger->debug("Received listNode request");
   brpc::ClosureGuard done_guard(done);
   auto *cntl = static_cast<brpc::Controller *>(controller);
+  rapidjson::Document json_request;
+  json_request.Parse(cntl->request_attachment().to_string().c_str());
+  RaftGroup *group = FindGroup(groups_, json_request, cntl);
+  if (group == nullptr) {
+    return;
+  }
 
   // 获取所有节点信息
-  auto nodes_info = raft_stuff_->GetAllNodesInfo();
+  auto nodes_info = group->raft_stuff_->GetAllNodesInfo();
 
   rapidjson::Document json_response;
   json_response.SetObject();
@@ -138,10 +174,16 @@ void AdminServiceImpl::GetNode(::google::protobuf::RpcController *controller, co
   global_logger->debug("Received getNode request");
   brpc::ClosureGuard done_guard(done);
   auto *cntl = static_cast<brpc::Controller *>(controller);
+  rapidjson::Document json_request;
+  json_request.Parse(cntl->request_attachment().to_string().c_str());
+  RaftGroup *group = FindGroup(groups_, json_request, cntl);
+  if (group == nullptr) {
+    return;
+  }
 
   // 获取所有节点信息
   std::tuple<int, std::string, std::string, nuraft::ulong, nuraft::ulong> node_info =
-      raft_stuff_->GetCurrentNodesInfo();
+      group->raft_stuff_->GetCurrentNodesInfo();
 
   rapidjson::Document json_response;
   json_response.SetObject();
@@ -164,4 +206,70 @@ void AdminServiceImpl::GetNode(::google::protobuf::RpcController *controller, co
   SetJsonResponse(json_response, cntl);
 }
 
-}  // namespace vectordb
\ No newline at end of file
+
+void AdminServiceImpl::StorageStats(::google::protobuf::RpcController *controller,
+                                    const ::nvm::HttpRequest * /*request*/, ::nvm::HttpResponse * /*response*/,
+                                    ::google::protobuf::Closure *done) {
+  global_logger->debug("Received storageStats request");
+  brpc::ClosureGuard done_guard(done);
+  auto *cntl = static_cast<brpc::Controller *>(controller);
+  rapidjson::Document json_request;
+  json_request.Parse(cntl->request_attachment().to_string().c_str());
+  RaftGroup *group = FindGroup(groups_, json_request, cntl);
+  if (group == nullptr) {
+    return;
+  }
+
+  rapidjson::Document json_response;
+  json_response.SetObject();
+  rapidjson::Document::AllocatorType &allocator = json_response.GetAllocator();
+
+  // 返回 RocksDB statistics 以及各 column family 的 rocksdb.stats 等属性
+  rapidjson::Value stats(rapidjson::kObjectType);
+  for (const auto &[name, value] : group->vector_database_->StorageStats()) {
+    stats.AddMember(rapidjson::Value(name.c_str(), allocator), rapidjson::Value(value.c_str(), allocator), allocator);
+  }
+  json_response.AddMember("stats", stats, allocator);
+  json_response.AddMember(RESPONSE_RETCODE, RESPONSE_RETCODE_SUCCESS, allocator);
+  SetJsonResponse(json_response, cntl);
+}
+
+void AdminServiceImpl::ReadIndex(::google::protobuf::RpcController *controller, const ::nvm::HttpRequest * /*request*/,
+                                 ::nvm::HttpResponse * /*response*/, ::google::protobuf::Closure *done) {
+  global_logger->debug("Received readIndex request");
+  brpc::ClosureGuard done_guard(done);
+  auto *cntl = static_cast<brpc::Controller *>(controller);
+
+  rapidjson::Document json_request;
+  json_request.Parse(cntl->request_attachment().to_string().c_str());
+  ReadConsistency consistency = ReadConsistency::READ_INDEX;
+  if (json_request.IsObject() && json_request.HasMember(REQUEST_CONSISTENCY) &&
+      json_request[REQUEST_CONSISTENCY].IsString() &&
+      !RaftStuff::ParseReadConsistency(json_request[REQUEST_CONSISTENCY].GetString(), &consistency)) {
+    cntl->http_response().set_status_code(400);
+    SetErrorJsonResponse(cntl, RESPONSE_RETCODE_ERROR, "Invalid consistency parameter in the request");
+    return;
+  }
+
+  RaftGroup *group = FindGroup(groups_, json_request, cntl);
+  if (group == nullptr) {
+    return;
+  }
+
+  // 在 leader 上确认领导权, 返回 follower 需要等待应用到的位置
+  ReadIndexResult result = group->raft_stuff_->ReadIndex(consistency);
+  if (!result.ok_) {
+    global_logger->warn("ReadIndex failed: {}", result.error_);
+    cntl->http_response().set_status_code(result.code_ == nuraft::cmd_result_code::NOT_LEADER ? 503 : 500);
+    SetErrorJsonResponse(cntl, RESPONSE_RETCODE_ERROR, result.error_);
+    return;
+  }
+
+  rapidjson::Document json_response;
+  json_response.SetObject();
+  rapidjson::Document::AllocatorType &allocator = json_response.GetAllocator();
+  json_response.AddMember(RESPONSE_READ_INDEX, result.read_index_, allocator);
+  json_response.AddMember(RESPONSE_RETCODE, RESPONSE_RETCODE_SUCCESS, allocator);
+  SetJsonResponse(json_response, cntl);
+}
+}  // namespace vectordb
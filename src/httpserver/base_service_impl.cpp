@@ -1,5 +1,7 @@
 #include "httpserver/base_service_impl.h"
+#include <cstdlib>
 #include <string>
+#include "logger/logger.h"
 
 namespace vectordb {
 void BaseServiceImpl::SetJsonResponse(const rapidjson::Document &json_response, brpc::Controller *cntl) {
@@ -41,11 +43,44 @@ void BaseServiceImpl::SetErrorJsonResponse(brpc::Controller *cntl, int error_cod
   SetJsonResponse(json_response, cntl);
 }
 
+auto BaseServiceImpl::FindGroup(RaftGroupManager *groups, const rapidjson::Document &json_request,
+                                brpc::Controller *cntl) -> RaftGroup * {
+  int group_id = 0;
+  bool valid = true;
+  if (json_request.IsObject() && json_request.HasMember(REQUEST_GROUP_ID)) {
+    valid = json_request[REQUEST_GROUP_ID].IsInt();
+    group_id = valid ? json_request[REQUEST_GROUP_ID].GetInt() : 0;
+  } else if (const std::string *value = cntl->http_request().uri().GetQuery(REQUEST_GROUP_ID); value != nullptr) {
+    // GET 请求没有请求体, 从 URL 参数中取
+    char *end = nullptr;
+    group_id = static_cast<int>(std::strtol(value->c_str(), &end, 10));
+    valid = !value->empty() && *end == '\0';
+  }
+  if (!valid) {
+    global_logger->error("Invalid groupId parameter in the request");
+    cntl->http_response().set_status_code(400);
+    SetErrorJsonResponse(cntl, RESPONSE_RETCODE_ERROR, "Invalid groupId parameter in the request");
+    return nullptr;
+  }
+  RaftGroup *group = groups->Get(group_id);
+  if (group == nullptr) {
+    global_logger->error("Raft group {} is not hosted on this node", group_id);
+    cntl->http_response().set_status_code(404);
+    SetErrorJsonResponse(cntl, RESPONSE_RETCODE_ERROR,
+                         "Raft group " + std::to_string(group_id) + " is not hosted on this node");
+  }
+  return group;
+}
+
 auto BaseServiceImpl::IsRequestValid(const rapidjson::Document &json_request, CheckType check_type) -> bool {
   switch (check_type) {
     case CheckType::SEARCH:
       return json_request.HasMember(REQUEST_VECTORS) && json_request.HasMember(REQUEST_K) &&
              (!json_request.HasMember(REQUEST_INDEX_TYPE) || json_request[REQUEST_INDEX_TYPE].IsString());
+    case CheckType::RANGE_SEARCH:
+      return json_request.HasMember(REQUEST_VECTORS) && json_request[REQUEST_VECTORS].IsArray() &&
+             json_request.HasMember(REQUEST_RADIUS) && json_request[REQUEST_RADIUS].IsNumber() &&
+             (!json_request.HasMember(REQUEST_INDEX_TYPE) || json_request[REQUEST_INDEX_TYPE].IsString());
     case CheckType::INSERT:
     case CheckType::UPSERT:
       return json_request.HasMember(REQUEST_VECTORS) && json_request.HasMember(REQUEST_ID) &&
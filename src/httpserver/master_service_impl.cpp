@@ -1,6 +1,7 @@
 #include "httpserver/master_service_impl.h"
 #include <cctype>
 #include <cstdint>
+#include <stdexcept>
 #include <string>
 #include "common/constants.h"
 namespace vectordb {
@@ -8,7 +9,19 @@ namespace vectordb {
 auto ServerInfo::FromJson(const rapidjson::Document &value) -> ServerInfo {
   ServerInfo info;
   info.url_ = value["url"].GetString();
-  info.role_ = static_cast<ServerRole>(value["role"].GetInt());
+  switch (value["role"].GetInt()) {
+    case NODE_ROLE_LEADER:
+      info.role_ = ServerRole::Master;
+      break;
+    case NODE_ROLE_FOLLOWER:
+      info.role_ = ServerRole::Backup;
+      break;
+    case NODE_ROLE_LEARNER:
+      info.role_ = ServerRole::Learner;
+      break;
+    default:
+      throw std::runtime_error("Unknown server role: " + std::to_string(value["role"].GetInt()));
+  }
   return info;
 }
 
@@ -109,6 +122,12 @@ void MasterServiceImpl::AddNode(::google::protobuf::RpcController *controller, c
     uint64_t instance_id = json_request[INSTANCE_ID].GetUint64();
     uint64_t node_id = json_request[NODE_ID].GetUint64();
     std::string etcd_key = "/instances/" + std::to_string(instance_id) + "/nodes/" + std::to_string(node_id);
+    // 以 learner 加入的节点记为 NODE_ROLE_LEARNER, proxy 优先把读请求发给它
+    if (json_request.HasMember(REQUEST_LEARNER) && json_request[REQUEST_LEARNER].IsBool() &&
+        json_request[REQUEST_LEARNER].GetBool()) {
+      json_request.RemoveMember("role");
+      json_request.AddMember("role", NODE_ROLE_LEARNER, json_request.GetAllocator());
+    }
 
     rapidjson::StringBuffer buffer;
     rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
@@ -284,7 +303,12 @@ void MasterServiceImpl::UpdateNodeStates() {
         get_node_response.Parse(response_str.c_str());
         if (get_node_response.HasMember("node") && get_node_response["node"].IsObject()) {
           std::string state = get_node_response["node"]["state"].GetString();
-          int new_role = (state == "leader") ? 0 : 1;
+          int new_role = NODE_ROLE_FOLLOWER;
+          if (state == NODE_STATE_LEADER) {
+            new_role = NODE_ROLE_LEADER;
+          } else if (state == NODE_STATE_LEARNER) {
+            new_role = NODE_ROLE_LEARNER;
+          }
 
           if (node_doc["role"].GetInt() != new_role) {
             node_doc["role"].SetInt(new_role);  // Update role
@@ -1,8 +1,10 @@
 #include "httpserver/proxy_service_impl.h"
+#include <algorithm>
 #include <cstdint>
 #include <functional>
 #include <future>
 #include <iostream>
+#include <iterator>
 #include <memory>
 #include <sstream>
 #include <unordered_map>
@@ -269,14 +271,21 @@ auto ProxyServiceImpl::SelectTargetNode(brpc::Controller *cntl, int partitionId,
   if (force_master || write_paths_.find(path) != write_paths_.end()) {
     // 寻找主节点
     for (const auto &node : available_nodes) {
-      if (node.role_ == 0) {
+      if (node.role_ == NODE_ROLE_LEADER) {
         targetNode = node;
         return true;
       }
     }
     global_logger->error("No master node available for partition ID: {}", partitionId);
     return false;
-  }  // 读请求 - 使用轮询算法选择节点
+  }
+  // 读请求 - 有 learner 时只在 learner 之间轮询, 不占用投票成员; 没有 learner 时在所有节点之间轮询
+  std::vector<NodeInfo> learners;
+  std::copy_if(available_nodes.begin(), available_nodes.end(), std::back_inserter(learners),
+               [](const NodeInfo &n) { return n.role_ == NODE_ROLE_LEARNER; });
+  if (!learners.empty()) {
+    available_nodes.swap(learners);
+  }
   size_t node_index = next_node_index_.fetch_add(1) % available_nodes.size();
   targetNode = available_nodes[node_index];
   return true;
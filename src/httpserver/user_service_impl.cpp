@@ -3,15 +3,56 @@
 #include <rapidjson/document.h>
 #include <rapidjson/stringbuffer.h>
 #include <rapidjson/writer.h>
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
+#include <exception>
 #include <iostream>
+#include <utility>
+#include "cluster/raft_command.h"
 #include "common/constants.h"
 #include "index/faiss_index.h"
 #include "index/hnswlib_index.h"
 #include "index/index_factory.h"
 #include "logger/logger.h"
 namespace vectordb {
+auto UserServiceImpl::PrepareRead(RaftStuff *raft_stuff, const rapidjson::Document &json_request,
+                                  brpc::Controller *cntl) -> bool {
+  ReadConsistency consistency = ReadConsistency::EVENTUAL;
+  if (json_request.HasMember(REQUEST_CONSISTENCY) &&
+      (!json_request[REQUEST_CONSISTENCY].IsString() ||
+       !RaftStuff::ParseReadConsistency(json_request[REQUEST_CONSISTENCY].GetString(), &consistency))) {
+    global_logger->error("Invalid consistency parameter in the request");
+    cntl->http_response().set_status_code(400);
+    SetErrorJsonResponse(cntl, RESPONSE_RETCODE_ERROR, "Invalid consistency parameter in the request");
+    return false;
+  }
+  ReadIndexResult result = raft_stuff->PrepareRead(consistency);
+  if (!result.ok_) {
+    global_logger->error("Consistent read failed: {}", result.error_);
+    SetRaftErrorResponse(raft_stuff, cntl, result.code_, result.error_);
+    return false;
+  }
+  return true;
+}
+
+void UserServiceImpl::SetRaftErrorResponse(RaftStuff *raft_stuff, brpc::Controller *cntl, nuraft::cmd_result_code code,
+                                           std::string error) {
+  int status_code = 500;
+  if (code == nuraft::cmd_result_code::NOT_LEADER) {
+    // 客户端应该改发给 leader
+    status_code = 503;
+    int leader = raft_stuff->GetLeader();
+    if (leader >= 0) {
+      error += ", leader is node " + std::to_string(leader);
+    }
+  } else if (code == nuraft::cmd_result_code::TIMEOUT) {
+    status_code = 504;
+  }
+  cntl->http_response().set_status_code(status_code);
+  SetErrorJsonResponse(cntl, RESPONSE_RETCODE_ERROR, error);
+}
+
 void UserServiceImpl::search(::google::protobuf::RpcController *controller, const ::nvm::HttpRequest * /*request*/,
                              ::nvm::HttpResponse * /*response*/, ::google::protobuf::Closure *done) {
   global_logger->debug("Received search request");
@@ -65,8 +106,14 @@ void UserServiceImpl::search(::google::protobuf::RpcController *controller, cons
     return;
   }
 
+  // 按请求的一致性要求等本地数据追上 leader
+  RaftGroup *group = FindGroup(groups_, json_request, cntl);
+  if (group == nullptr || !PrepareRead(group->raft_stuff_.get(), json_request, cntl)) {
+    return;
+  }
+
   // 使用 VectorDatabase 的 search 接口执行查询
-  std::pair<std::vector<int64_t>, std::vector<float>> results = vector_database_->Search(json_request);
+  std::pair<std::vector<int64_t>, std::vector<float>> results = group->vector_database_->Search(json_request);
 
   // 将结果转换为JSON
   rapidjson::Document json_response;
@@ -77,11 +124,13 @@ void UserServiceImpl::search(::google::protobuf::RpcController *controller, cons
   bool valid_results = false;
   rapidjson::Value vectors(rapidjson::kArrayType);
   rapidjson::Value distances(rapidjson::kArrayType);
+  std::vector<uint64_t> hit_ids;
   for (size_t i = 0; i < results.first.size(); ++i) {
     if (results.first[i] != -1) {
       valid_results = true;
       vectors.PushBack(results.first[i], allocator);
       distances.PushBack(results.second[i], allocator);
+      hit_ids.push_back(static_cast<uint64_t>(results.first[i]));
     }
   }
 
@@ -90,6 +139,28 @@ void UserServiceImpl::search(::google::protobuf::RpcController *controller, cons
     json_response.AddMember(RESPONSE_DISTANCES, distances, allocator);
   }
 
+  // 请求了 outputFields 时用一次 MultiGet 取回所有命中文档, 按命中顺序附带投影后的字段
+  if (valid_results && json_request.HasMember(REQUEST_OUTPUT_FIELDS) && json_request[REQUEST_OUTPUT_FIELDS].IsArray()) {
+    std::vector<std::string> output_fields;
+    for (const auto &field : json_request[REQUEST_OUTPUT_FIELDS].GetArray()) {
+      if (field.IsString()) {
+        output_fields.emplace_back(field.GetString());
+      }
+    }
+    if (!output_fields.empty()) {
+      std::vector<rapidjson::Document> docs = group->vector_database_->MultiQuery(hit_ids, output_fields);
+      rapidjson::Value fields(rapidjson::kArrayType);
+      for (auto &doc : docs) {
+        rapidjson::Value item(rapidjson::kObjectType);
+        if (doc.IsObject()) {
+          item.CopyFrom(doc, allocator);
+        }
+        fields.PushBack(item, allocator);
+      }
+      json_response.AddMember(RESPONSE_FIELDS, fields, allocator);
+    }
+  }
+
   // 设置响应
   json_response.AddMember(RESPONSE_RETCODE, RESPONSE_RETCODE_SUCCESS, allocator);
   SetJsonResponse(json_response, cntl);
@@ -143,8 +214,12 @@ void UserServiceImpl::insert(::google::protobuf::RpcController *controller, cons
     return;
   }
 
-  // 使用全局IndexFactory获取索引对象
-  void *index = IndexFactory::Instance().GetIndex(index_type);
+  RaftGroup *group = FindGroup(groups_, json_request, cntl);
+  if (group == nullptr) {
+    return;
+  }
+  // 使用请求所在组的 IndexFactory 获取索引对象
+  void *index = group->vector_database_->Indexes()->GetIndex(index_type);
   assert(index != nullptr);
 
   // 根据索引类型初始化索引对象并调用insert_vectors函数
@@ -203,26 +278,64 @@ void UserServiceImpl::upsert(::google::protobuf::RpcController *controller, cons
     return;
   }
 
-  // uint64_t label = json_request[REQUEST_ID].GetUint64();
-
-  // // 获取请求参数中的索引类型
-  // IndexFactory::IndexType index_type = GetIndexTypeFromRequest(json_request);
-
-   // 调用 RaftStuff 的 appendEntries 方法将新的日志条目添加到集群中
-  raft_stuff_->AppendEntries(cntl->request_attachment().to_string());
-
-  // vector_database_->Upsert(label, json_request, index_type);
-  // // 在 upsert 调用之后调用 VectorDatabase::writeWALLog
-  // vector_database_->WriteWalLog("upsert", json_request);
+  if (!json_request[REQUEST_ID].IsUint64()) {
+    global_logger->error("Invalid id parameter in the request");
+    cntl->http_response().set_status_code(400);
+    SetErrorJsonResponse(cntl, RESPONSE_RETCODE_ERROR, "Invalid id parameter in the request");
+    return;
+  }
+  uint64_t label = json_request[REQUEST_ID].GetUint64();
 
-  rapidjson::Document json_response;
-  json_response.SetObject();
-  rapidjson::Document::AllocatorType &response_allocator = json_response.GetAllocator();
+  RaftGroup *group = FindGroup(groups_, json_request, cntl);
+  if (group == nullptr) {
+    return;
+  }
+  RaftStuff *raft_stuff = group->raft_stuff_.get();
 
-  // 添加retCode到响应
-  json_response.AddMember(RESPONSE_RETCODE, RESPONSE_RETCODE_SUCCESS, response_allocator);
+  // 获取请求参数中的索引类型
+  IndexFactory::IndexType index_type = GetIndexTypeFromRequest(json_request);
 
-  SetJsonResponse(json_response, cntl);
+  // 只在 leader 上解析一次 JSON, 编码成二进制命令写进 raft 日志, follower 应用时不再解析
+  UpsertRecord record;
+  try {
+    record = VectorDatabase::MakeUpsertRecord(label, json_request, index_type);
+  } catch (const std::exception &e) {
+    global_logger->error("Invalid upsert request: {}", e.what());
+    cntl->http_response().set_status_code(400);
+    SetErrorJsonResponse(cntl, RESPONSE_RETCODE_ERROR, e.what());
+    return;
+  }
+  // 维数不对的写入一旦提交, 每个副本应用时都会失败, 在 leader 上直接拒绝
+  std::string error;
+  if (!group->vector_database_->CheckDimension(record, &error)) {
+    global_logger->error("Invalid upsert request: {}", error);
+    cntl->http_response().set_status_code(400);
+    SetErrorJsonResponse(cntl, RESPONSE_RETCODE_ERROR, error);
+    return;
+  }
+  std::string command = RaftCommand::EncodeUpsert(record);
+
+  // 写入交给 raft 异步提交, brpc 工作线程不等待共识; done 由提交回调持有, 提交成功或失败后才回复客户端
+  done_guard.release();
+  raft_stuff->AppendEntriesAsync(
+      std::move(command), [this, raft_stuff, cntl, done](const WriteResult &result) {
+        brpc::ClosureGuard async_done_guard(done);
+        if (!result.ok_) {
+          global_logger->error("Upsert failed: {}", result.error_);
+          SetRaftErrorResponse(raft_stuff, cntl, result.code_, result.error_);
+          return;
+        }
+
+        rapidjson::Document json_response;
+        json_response.SetObject();
+        rapidjson::Document::AllocatorType &response_allocator = json_response.GetAllocator();
+
+        // 添加retCode到响应
+        json_response.AddMember(RESPONSE_RETCODE, RESPONSE_RETCODE_SUCCESS, response_allocator);
+        json_response.AddMember(RESPONSE_LOG_INDEX, result.log_idx_, response_allocator);
+
+        SetJsonResponse(json_response, cntl);
+      });
 }
 
 void UserServiceImpl::query(::google::protobuf::RpcController *controller, const ::nvm::HttpRequest * /*request*/,
@@ -244,11 +357,16 @@ void UserServiceImpl::query(::google::protobuf::RpcController *controller, const
     return;
   }
 
+  RaftGroup *group = FindGroup(groups_, json_request, cntl);
+  if (group == nullptr || !PrepareRead(group->raft_stuff_.get(), json_request, cntl)) {
+    return;
+  }
+
   // 从JSON请求中获取ID
   uint64_t id = json_request[REQUEST_ID].GetUint64();  // 使用宏REQUEST_ID
 
   // 查询JSON数据
-  rapidjson::Document json_data = vector_database_->Query(id);
+  rapidjson::Document json_data = group->vector_database_->Query(id);
 
   // 将结果转换为JSON
   rapidjson::Document json_response;
@@ -267,4 +385,140 @@ void UserServiceImpl::query(::google::protobuf::RpcController *controller, const
   SetJsonResponse(json_response, cntl);
 }
 
+void UserServiceImpl::rangeSearch(::google::protobuf::RpcController *controller,
+                                  const ::nvm::HttpRequest * /*request*/, ::nvm::HttpResponse * /*response*/,
+                                  ::google::protobuf::Closure *done) {
+  global_logger->debug("Received range search request");
+
+  brpc::ClosureGuard done_guard(done);
+  auto *cntl = static_cast<brpc::Controller *>(controller);
+
+  rapidjson::Document json_request;
+  json_request.Parse(cntl->request_attachment().to_string().c_str());
+  global_logger->info("Range search request parameters: {}", cntl->request_attachment().to_string());
+
+  if (!json_request.IsObject()) {
+    global_logger->error("Invalid JSON request");
+    cntl->http_response().set_status_code(400);
+    SetErrorJsonResponse(cntl, RESPONSE_RETCODE_ERROR, "Invalid JSON request");
+    return;
+  }
+
+  if (!IsRequestValid(json_request, BaseServiceImpl::CheckType::RANGE_SEARCH)) {
+    global_logger->error("Missing vectors or radius parameter in the request");
+    cntl->http_response().set_status_code(400);
+    SetErrorJsonResponse(cntl, RESPONSE_RETCODE_ERROR, "Missing vectors or radius parameter in the request");
+    return;
+  }
+
+  if (GetIndexTypeFromRequest(json_request) == IndexFactory::IndexType::UNKNOWN) {
+    global_logger->error("Invalid indexType parameter in the request");
+    cntl->http_response().set_status_code(400);
+    SetErrorJsonResponse(cntl, RESPONSE_RETCODE_ERROR, "Invalid indexType parameter in the request");
+    return;
+  }
+
+  RaftGroup *group = FindGroup(groups_, json_request, cntl);
+  if (group == nullptr || !PrepareRead(group->raft_stuff_.get(), json_request, cntl)) {
+    return;
+  }
+
+  std::pair<std::vector<int64_t>, std::vector<float>> results = group->vector_database_->RangeSearch(json_request);
+
+  rapidjson::Document json_response;
+  json_response.SetObject();
+  rapidjson::Document::AllocatorType &allocator = json_response.GetAllocator();
+  rapidjson::Value vectors(rapidjson::kArrayType);
+  rapidjson::Value distances(rapidjson::kArrayType);
+  for (size_t i = 0; i < results.first.size(); ++i) {
+    vectors.PushBack(results.first[i], allocator);
+    distances.PushBack(results.second[i], allocator);
+  }
+  json_response.AddMember(RESPONSE_VECTORS, vectors, allocator);
+  json_response.AddMember(RESPONSE_DISTANCES, distances, allocator);
+  json_response.AddMember(RESPONSE_RETCODE, RESPONSE_RETCODE_SUCCESS, allocator);
+  SetJsonResponse(json_response, cntl);
+}
+
+void UserServiceImpl::batchQuery(::google::protobuf::RpcController *controller,
+                                 const ::nvm::HttpRequest * /*request*/, ::nvm::HttpResponse * /*response*/,
+                                 ::google::protobuf::Closure *done) {
+  global_logger->debug("Received batch query request");
+
+  brpc::ClosureGuard done_guard(done);
+  auto *cntl = static_cast<brpc::Controller *>(controller);
+
+  rapidjson::Document json_request;
+  json_request.Parse(cntl->request_attachment().to_string().c_str());
+
+  if (!json_request.IsObject()) {
+    global_logger->error("Invalid JSON request");
+    cntl->http_response().set_status_code(400);
+    SetErrorJsonResponse(cntl, RESPONSE_RETCODE_ERROR, "Invalid JSON request");
+    return;
+  }
+
+  if (!json_request.HasMember(REQUEST_IDS) || !json_request[REQUEST_IDS].IsArray()) {
+    global_logger->error("Missing ids parameter in the request");
+    cntl->http_response().set_status_code(400);
+    SetErrorJsonResponse(cntl, RESPONSE_RETCODE_ERROR, "Missing ids parameter in the request");
+    return;
+  }
+
+  const auto &id_array = json_request[REQUEST_IDS];
+  if (id_array.Size() > BATCH_QUERY_MAX_IDS) {
+    global_logger->error("Too many ids in batch query: {}", id_array.Size());
+    cntl->http_response().set_status_code(400);
+    SetErrorJsonResponse(cntl, RESPONSE_RETCODE_ERROR, "Too many ids in the request");
+    return;
+  }
+
+  std::vector<uint64_t> ids;
+  ids.reserve(id_array.Size());
+  for (const auto &id : id_array.GetArray()) {
+    if (!id.IsUint64()) {
+      global_logger->error("Invalid id in batch query");
+      cntl->http_response().set_status_code(400);
+      SetErrorJsonResponse(cntl, RESPONSE_RETCODE_ERROR, "Invalid id in the request");
+      return;
+    }
+    ids.push_back(id.GetUint64());
+  }
+
+  // 不带 outputFields 时返回完整文档
+  std::vector<std::string> output_fields;
+  if (json_request.HasMember(REQUEST_OUTPUT_FIELDS) && json_request[REQUEST_OUTPUT_FIELDS].IsArray()) {
+    for (const auto &field : json_request[REQUEST_OUTPUT_FIELDS].GetArray()) {
+      if (field.IsString()) {
+        output_fields.emplace_back(field.GetString());
+      }
+    }
+  }
+
+  RaftGroup *group = FindGroup(groups_, json_request, cntl);
+  if (group == nullptr || !PrepareRead(group->raft_stuff_.get(), json_request, cntl)) {
+    return;
+  }
+
+  std::vector<rapidjson::Document> docs = group->vector_database_->MultiQuery(ids, output_fields);
+  global_logger->debug("Batch query fetched {} ids", ids.size());
+
+  // 结果与请求中的 ids 一一对应, 不存在的 id 为 null
+  rapidjson::Document json_response;
+  json_response.SetObject();
+  rapidjson::Document::AllocatorType &allocator = json_response.GetAllocator();
+  rapidjson::Value documents(rapidjson::kArrayType);
+  documents.Reserve(docs.size(), allocator);
+  for (auto &doc : docs) {
+    rapidjson::Value item;
+    if (doc.IsObject()) {
+      item.CopyFrom(doc, allocator);
+    }
+    documents.PushBack(item, allocator);
+  }
+  json_response.AddMember(RESPONSE_DOCUMENTS, documents, allocator);
+  json_response.AddMember(RESPONSE_RETCODE, RESPONSE_RETCODE_SUCCESS, allocator);
+  SetJsonResponse(json_response, cntl);
+}
+
 }  // namespace vectordb
\ No newline at end of file
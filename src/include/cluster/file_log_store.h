@@ -0,0 +1,142 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cluster/log_flush_scheduler.h"
+#include "libnuraft/log_store.hxx"
+#include "libnuraft/pp_util.hxx"
+#include "libnuraft/raft_server.hxx"
+
+namespace vectordb {
+
+// 基于段文件的 raft 日志存储, 同时也是数据库的恢复日志:
+//   <dir>/raft_<first_index>.log  每个段以 magic 开头, 之后是若干帧
+//   帧: [u32 len][u32 crc32c(index, term, body)][u64 index][u64 term][body = log_entry::serialize()]
+// 段文件按 segment_bytes 预分配, 内存里只保留每条日志在段内的偏移和 term,
+// entry_at / log_entries 通过 pread 读盘. 写入只进页缓存, 后台线程批量 fdatasync
+// 后推进 last_durable_index 并通知 raft_server; compact 只删除整段文件.
+class FileLogStore : public nuraft::log_store {
+ public:
+  // 目录为空时日志从 initial_start_index 开始编号, 通常是数据库快照覆盖位置的下一条.
+  // scheduler 为空时使用自己的刷盘线程, 否则由多个 raft 组共用的刷盘线程池刷盘
+  FileLogStore(const std::string &dir, size_t segment_bytes, ulong initial_start_index = 1,
+               LogFlushScheduler *scheduler = nullptr);
+
+  ~FileLogStore() override;
+
+  // NOLINTNEXTLINE
+  __nocopy__(FileLogStore);
+
+ public:
+  auto next_slot() const -> ulong override;
+
+  auto start_index() const -> ulong override;
+
+  auto last_entry() const -> nuraft::ptr<nuraft::log_entry> override;
+
+  auto append(nuraft::ptr<nuraft::log_entry> &entry) -> ulong override;
+
+  void write_at(ulong index, nuraft::ptr<nuraft::log_entry> &entry) override;
+
+  auto log_entries(ulong start, ulong end) -> nuraft::ptr<std::vector<nuraft::ptr<nuraft::log_entry>>> override;
+
+  auto log_entries_ext(nuraft::ulong start, nuraft::ulong end, nuraft::int64 batch_size_hint_in_bytes = 0)
+      -> nuraft::ptr<std::vector<nuraft::ptr<nuraft::log_entry>>> override;
+
+  auto entry_at(ulong index) -> nuraft::ptr<nuraft::log_entry> override;
+
+  auto term_at(ulong index) -> ulong override;
+
+  auto pack(ulong index, nuraft::int32 cnt) -> nuraft::ptr<nuraft::buffer> override;
+
+  void apply_pack(ulong index, nuraft::buffer &pack) override;
+
+  auto compact(ulong last_log_index) -> bool override;
+
+  auto flush() -> bool override;
+
+  auto last_durable_index() -> ulong override;
+
+  // 设置后每次后台刷盘完成都会调用 notify_log_append_completion, 需要打开 parallel_log_appending_
+  void SetRaftServer(nuraft::raft_server *raft);
+
+  void Close();
+
+  // 刷一次盘并通知 raft_server, 由刷盘线程调用
+  auto FlushPending() -> bool;
+
+  auto SegmentCount() const -> size_t;
+
+  static constexpr size_t DEFAULT_SEGMENT_BYTES = 64 << 20;
+  static constexpr size_t FRAME_HEADER_SIZE = 24;
+  static constexpr char MAGIC[8] = {'V', 'D', 'B', 'R', 'A', 'F', 'T', '1'};
+
+ private:
+  struct Segment {
+    ~Segment();
+
+    ulong first_index_ = 0;
+    std::string path_;
+    int fd_ = -1;
+    uint64_t size_ = 0;              // 已写入的字节数
+    std::vector<uint32_t> offsets_;  // 第 i 条日志的帧偏移
+    std::vector<ulong> terms_;
+
+    auto LastIndex() const -> ulong { return first_index_ + offsets_.size() - 1; }
+    auto EndOffset(size_t i) const -> uint64_t { return i + 1 < offsets_.size() ? offsets_[i + 1] : size_; }
+  };
+
+  void OpenSegments();
+  // 读入段内连续有效的帧; 返回有效帧之后是否只剩预分配的零, 否则说明后面是半帧或坏帧
+  auto LoadSegment(const std::shared_ptr<Segment> &segment) -> bool;
+  auto CreateSegment(ulong first_index) -> std::shared_ptr<Segment>;
+  void SealSegment(const std::shared_ptr<Segment> &segment);
+  void RemoveSegment(const std::shared_ptr<Segment> &segment);
+  // 以下函数需要持有 mutex_
+  void AppendLocked(ulong index, const nuraft::ptr<nuraft::log_entry> &entry);
+  void TruncateLocked(ulong index);
+  void ResetLocked(ulong start_index);
+  auto FindSegment(ulong index) const -> std::shared_ptr<Segment>;
+  // 读取 [start, end) 范围内的日志, 同一段内的连续日志合并成一次 pread; size_hint 大于 0 时读够这么多字节就停止
+  // start 已被压缩掉时返回 nullptr, 中途读不到时只返回前面读到的部分
+  auto ReadEntries(ulong start, ulong end, int64_t size_hint) const
+      -> nuraft::ptr<std::vector<nuraft::ptr<nuraft::log_entry>>>;
+
+  void FlushLoop();
+  void NotifyFlush();
+  // fdatasync 活跃段并推进 durable_idx_
+  auto SyncActive() -> bool;
+
+  static auto MakeClone(const nuraft::ptr<nuraft::log_entry> &entry) -> nuraft::ptr<nuraft::log_entry>;
+  static auto DummyEntry() -> nuraft::ptr<nuraft::log_entry>;
+
+  std::string dir_;
+  size_t segment_bytes_;
+
+  mutable std::mutex mutex_;
+  std::deque<std::shared_ptr<Segment>> segments_;
+  std::atomic<ulong> start_idx_{1};
+  std::atomic<ulong> next_idx_{1};
+  mutable nuraft::ptr<nuraft::log_entry> last_entry_;
+
+  // 刷盘状态: sync_mutex_ 串行化 fdatasync, truncate_gen_ 防止截断前的刷盘结果覆盖 durable_idx_
+  std::mutex sync_mutex_;
+  std::atomic<ulong> durable_idx_{0};
+  std::atomic<uint64_t> truncate_gen_{0};
+  std::atomic<nuraft::raft_server *> raft_server_{nullptr};
+
+  LogFlushScheduler *scheduler_;
+  std::mutex flush_mutex_;
+  std::condition_variable flush_cv_;
+  bool stop_ = false;
+  std::thread flush_thread_;
+};
+
+}  // namespace vectordb
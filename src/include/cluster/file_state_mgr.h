@@ -0,0 +1,57 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include "cluster/file_log_store.h"
+#include "libnuraft/nuraft.hxx"
+
+namespace vectordb {
+
+// 持久化的 raft 状态管理器, 替代 InmemStateMgr: term / vote 和集群配置各存一个文件,
+// 与日志段放在同一目录. 文件内容为 [u32 crc32c][serialize() 的结果],
+// 写入时先写临时文件并 fsync, 再 rename 覆盖并 fsync 目录, 任何时刻崩溃都只会看到完整的旧值或新值.
+// 重启后节点带着原来的成员关系和投票记录加入集群, 从自己最后一条日志开始增量追赶.
+class FileStateMgr : public nuraft::state_mgr {
+ public:
+  FileStateMgr(int srv_id, const std::string &endpoint, const std::string &dir, nuraft::ptr<FileLogStore> log_store);
+
+  ~FileStateMgr() override = default;
+
+  auto load_config() -> nuraft::ptr<nuraft::cluster_config> override;
+
+  void save_config(const nuraft::cluster_config &config) override;
+
+  void save_state(const nuraft::srv_state &state) override;
+
+  auto read_state() -> nuraft::ptr<nuraft::srv_state> override;
+
+  auto load_log_store() -> nuraft::ptr<nuraft::log_store> override;
+
+  auto server_id() -> nuraft::int32 override { return my_id_; }
+
+  void system_exit(int exit_code) override;
+
+  auto GetSrvConfig() const -> nuraft::ptr<nuraft::srv_config> { return my_srv_config_; }
+
+  static constexpr const char *CONFIG_FILE_NAME = "raft_config";
+  static constexpr const char *STATE_FILE_NAME = "raft_state";
+
+ private:
+  // 原子替换 path 的内容
+  static void WriteFileAtomic(const std::string &path, nuraft::buffer &payload);
+  // 读取并校验文件, 不存在返回 nullptr, 校验失败抛异常
+  static auto ReadFileChecked(const std::string &path) -> nuraft::ptr<nuraft::buffer>;
+
+  int my_id_;
+  std::string my_endpoint_;
+  std::string config_path_;
+  std::string state_path_;
+  nuraft::ptr<FileLogStore> cur_log_store_;
+  nuraft::ptr<nuraft::srv_config> my_srv_config_;
+
+  std::mutex mutex_;
+  nuraft::ptr<nuraft::cluster_config> saved_config_;
+  nuraft::ptr<nuraft::srv_state> saved_state_;
+};
+
+}  // namespace vectordb
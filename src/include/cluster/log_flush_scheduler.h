@@ -0,0 +1,41 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace vectordb {
+
+class FileLogStore;
+
+// 多个 raft 组的日志存储共用的刷盘线程池. 每个日志存储自己开一个刷盘线程时,
+// 一个进程承载几百个组就有几百个线程; 这里有日志待刷的存储排队, 由固定数量的线程轮流刷盘.
+// 同一个存储同时只在一个线程上刷盘, 刷盘期间又有新日志时刷完再排一次队
+class LogFlushScheduler {
+ public:
+  explicit LogFlushScheduler(size_t threads);
+  ~LogFlushScheduler();
+
+  // 存储有新日志时调用, 已经在排队的存储不会重复排队
+  void Schedule(FileLogStore *store);
+  // 存储关闭前调用: 移出队列并等待正在进行的刷盘结束, 之后不会再访问这个存储
+  void Remove(FileLogStore *store);
+
+ private:
+  void Loop();
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::condition_variable idle_cv_;  // 某个存储刷盘结束
+  std::deque<FileLogStore *> queue_;
+  std::set<FileLogStore *> pending_;  // 等待刷盘的存储, 包括正在刷盘时又来了新日志的
+  std::set<FileLogStore *> running_;
+  bool stop_ = false;
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace vectordb
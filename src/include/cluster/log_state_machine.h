@@ -1,38 +1,83 @@
 #pragma once
 
+#include <bthread/condition_variable.h>
+#include <bthread/mutex.h>
 #include <libnuraft/nuraft.hxx>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "cluster/snapshot_transfer.h"
 #include "database/vector_database.h"
 namespace vectordb {
+// raft 快照是 <快照目录>/raft/<log_idx>/ 下的一个目录: 索引文件 + RocksDB checkpoint + 快照元数据.
+// leader 按块读出目录中的文件发给落后太多的 follower, follower 收齐后整体替换本地数据
 class LogStateMachine : public nuraft::state_machine {
  public:
   LogStateMachine() : last_committed_idx_(0) {}
-  ~LogStateMachine() override = default;
+  ~LogStateMachine() override;
   void SetVectorDatabase(VectorDatabase *vector_database);  // 重命名为 setVectorDatabase
   auto commit(nuraft::ulong log_idx, nuraft::buffer &data) -> nuraft::ptr<nuraft::buffer> override;
 
   auto pre_commit(nuraft::ulong log_idx, nuraft::buffer &data) -> nuraft::ptr<nuraft::buffer> override;
   void commit_config(const nuraft::ulong log_idx, nuraft::ptr<nuraft::cluster_config> &new_conf) override {
     // Nothing to do with configuration change. Just update committed index.
-    last_committed_idx_ = log_idx;
+    SetAppliedIndex(log_idx);
   }
   void rollback(const nuraft::ulong log_idx, nuraft::buffer &data) override {}
   auto read_logical_snp_obj(nuraft::snapshot &s, void *&user_snp_ctx, nuraft::ulong obj_id,
-                            nuraft::ptr<nuraft::buffer> &data_out, bool &is_last_obj) -> int override {
-    return 0;
-  }
+                            nuraft::ptr<nuraft::buffer> &data_out, bool &is_last_obj) -> int override;
   void save_logical_snp_obj(nuraft::snapshot &s, nuraft::ulong &obj_id, nuraft::buffer &data, bool is_first_obj,
-                            bool is_last_obj) override {}
-  auto apply_snapshot(nuraft::snapshot &s) -> bool override { return true; }
-  void free_user_snp_ctx(void *&user_snp_ctx) override {}
-  auto last_snapshot() -> nuraft::ptr<nuraft::snapshot> override { return nullptr; }
+                            bool is_last_obj) override;
+  auto apply_snapshot(nuraft::snapshot &s) -> bool override;
+  void free_user_snp_ctx(void *&user_snp_ctx) override;
+  auto last_snapshot() -> nuraft::ptr<nuraft::snapshot> override;
   auto last_commit_index() -> nuraft::ulong override { return last_committed_idx_; }
 
-  void create_snapshot(nuraft::snapshot &s, nuraft::async_result<bool>::handler_type &when_done) override {}
+  // 提交线程上只导出 RocksDB checkpoint, 保存索引和写快照目录在后台线程完成后调用 when_done
+  void create_snapshot(nuraft::snapshot &s, nuraft::async_result<bool>::handler_type &when_done) override;
+
+  // 等到本地状态机应用到 log_idx, 超时返回 false; 在 bthread 中等待, 不占用 brpc 的工作线程
+  auto WaitApplied(uint64_t log_idx, std::chrono::milliseconds timeout) -> bool;
+
+  static constexpr const char *SNAPSHOT_META_FILE_NAME = "snapshot.meta";
+  // 安装快照前写下的标记, 安装到一半崩溃时重启后重新安装
+  static constexpr const char *INSTALLING_FILE_NAME = "INSTALLING";
+  // 保留的快照个数, 正在传输的旧快照不会马上被删掉
+  static constexpr size_t SNAPSHOT_KEEP_COUNT = 2;
 
  private:
+  // 位于 VectorDatabase 的快照目录下, 每个 raft 组各自一份
+  auto SnapshotRoot() const -> std::string;
+  auto SnapshotDir(nuraft::ulong log_idx) const -> std::string;
+  auto ReceiveDir(const nuraft::snapshot &s) const -> std::string;
+  static void WriteSnapshotMeta(const std::string &dir, nuraft::snapshot &s);
+  // 启动时找到最新的完整快照
+  void LoadLastSnapshot();
+  void RecoverInterruptedInstall();
+  void RemoveOldSnapshots();
+  void InstallSnapshot(nuraft::ulong log_idx);
+  // 在后台线程中完成 create_snapshot
+  void FinishSnapshot(const nuraft::ptr<nuraft::snapshot> &s, const std::string &tmp_dir,
+                      const nuraft::async_result<bool>::handler_type &when_done);
+  // 等待上一次后台快照结束; 安装快照和析构前调用
+  void JoinSnapshotThread();
+  // 更新已应用的位置并唤醒等待读的请求
+  void SetAppliedIndex(nuraft::ulong log_idx);
+
   // Last committed Raft log number.
   std::atomic<uint64_t> last_committed_idx_;
+  bthread::Mutex applied_mutex_;
+  bthread::ConditionVariable applied_cv_;
   VectorDatabase *vector_database_;  // 添加一个 VectorDatabase 指针成员变量
+
+  std::mutex snapshot_mutex_;
+  nuraft::ptr<nuraft::snapshot> last_snapshot_;
+  std::unique_ptr<SnapshotReceiver> receiver_;  // 正在接收的快照
+  nuraft::ulong receiving_idx_ = 0;
+  // NuRaft 在 when_done 之前不会再次调用 create_snapshot, 同一时间最多一个后台快照
+  std::thread snapshot_thread_;
 };
 
-}  // namespace vectordb
\ No newline at end of file
+}  // namespace vectordb
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "database/vector_database.h"
+#include "libnuraft/buffer.hxx"
+#include "libnuraft/pp_util.hxx"
+
+namespace vectordb {
+
+// raft 日志条目的编码. leader 把写请求编码一次, follower 直接解码成 UpsertRecord 应用, 不解析 JSON:
+//   二进制批量: [i32 RECORD_BATCH_MARKER][u8 flags][u32 记录数][body]
+//              body 为每条记录 [u32 长度][记录], flags 带 FLAG_SNAPPY 时整个 body 经过 snappy 压缩
+//   记录:      [u8 op][u64 id][i8 索引类型][u32 维数][float32 向量][u32 长度][RecordCodec 编码的标量字段]
+// 之前的 JSON 格式仍然可以回放:
+//   单条:      [i32 长度][JSON 请求文本], 即 buffer_serializer::put_str
+//   JSON 批量: [i32 BATCH_MARKER][u32 请求数] 之后每个请求 [u32 长度][JSON 请求文本]
+// 单条格式的长度不会是负数, 靠第一个 i32 区分各种格式
+class RaftCommand {
+ public:
+  enum class Op : uint8_t {
+    UPSERT = 1,
+  };
+
+  static constexpr int32_t BATCH_MARKER = -1;
+  static constexpr int32_t RECORD_BATCH_MARKER = -2;
+  static constexpr uint8_t FLAG_SNAPPY = 1;
+
+  // 编码一条写入, 作为 EncodeBatch 的一个元素
+  static auto EncodeUpsert(const UpsertRecord &record) -> std::string;
+  // compress 为 true 时尝试 snappy 压缩, 压缩后没有变小则按原样存放
+  static auto EncodeBatch(const std::vector<std::string> &records, bool compress = false)
+      -> nuraft::ptr<nuraft::buffer>;
+  // 解出日志条目中的所有写入, 格式不对时抛出 std::runtime_error; 旧格式中无效的 JSON 请求被跳过
+  static auto Decode(nuraft::buffer &data) -> std::vector<UpsertRecord>;
+
+ private:
+  static void DecodeRecord(const char *pos, const char *end, UpsertRecord *record);
+  static auto DecodeJson(const char *data, size_t size, UpsertRecord *record) -> bool;
+};
+
+}  // namespace vectordb
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <libnuraft/asio_service.hxx>
+#include <map>
+#include <memory>
+#include <string>
+#include "cluster/log_flush_scheduler.h"
+#include "cluster/raft_stuff.h"
+#include "common/task_scheduler.h"
+#include "database/vector_database.h"
+#include "index/index_factory.h"
+
+namespace vectordb {
+
+// 一个 raft 组: 自己的索引, 数据目录, 状态机和 raft 日志. 成员按依赖顺序声明, 析构时先停 raft
+struct RaftGroup {
+  int group_id_ = 0;
+  std::unique_ptr<IndexFactory> index_factory_;  // 组 0 使用全局 IndexFactory, 这里为空
+  std::unique_ptr<VectorDatabase> vector_database_;
+  std::unique_ptr<RaftStuff> raft_stuff_;
+};
+
+// 一个 vdb_server 进程承载配置中 RAFT_GROUPS 列出的所有 raft 组.
+// 各组共用 asio 线程池, 日志刷盘、索引压缩、group commit 和批量查询解码的线程池以及 raft logger,
+// 进程的线程数不随组数增长; raft 日志目录(GroupPath)和端口(GroupPort)每组各自一份.
+// 按请求中的 groupId 找到对应的组
+class RaftGroupManager {
+ public:
+  RaftGroupManager() = default;
+  ~RaftGroupManager();
+
+  void Init();
+  // 不在本节点上时返回 nullptr
+  auto Get(int group_id) const -> RaftGroup *;
+  auto Groups() const -> const std::map<int, std::unique_ptr<RaftGroup>> & { return groups_; }
+
+  // NuRaft 的一个 rpc_listener 只服务一个 raft_server, 每个组监听自己的端口
+  static auto GroupPort(int port, int group_id) -> int;
+  // 把 host:port 形式的 raft 地址换成组 group_id 的端口
+  static auto GroupEndpoint(const std::string &endpoint, int group_id) -> std::string;
+
+ private:
+  auto CreateGroup(int group_id) -> std::unique_ptr<RaftGroup>;
+
+  nuraft::ptr<nuraft::asio_service> asio_service_;
+  std::unique_ptr<LogFlushScheduler> flush_scheduler_;
+  std::unique_ptr<TaskScheduler> compact_scheduler_;  // 组 1 起的索引压缩
+  std::unique_ptr<TaskScheduler> batch_scheduler_;    // 所有组的 WriteBatcher
+  std::unique_ptr<TaskScheduler> decode_scheduler_;   // 所有组批量查询的并行解码
+  nuraft::ptr<nuraft::logger> logger_;
+  std::map<int, std::unique_ptr<RaftGroup>> groups_;  // 最后声明, 先于共用的线程池析构
+};
+
+}  // namespace vectordb
@@ -1,39 +1,110 @@
 #pragma once
 
 #include <libnuraft/asio_service.hxx>
-#include "cluster/in_memory_state_mgr.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include "cluster/file_state_mgr.h"
+#include "cluster/log_flush_scheduler.h"
+#include "cluster/write_batcher.h"
 #include "log_state_machine.h"
 #include "logger/logger.h"  // 包含 logger.h 以使用日志记录器
+namespace brpc {
+class Channel;
+}  // namespace brpc
+
 namespace vectordb {
 
+// async_handler: append_entries 立即返回, 提交结果通过 when_ready 回调, 不占用 brpc 的工作线程
 static const nuraft::raft_params::return_method_type CALL_TYPE
-    = nuraft::raft_params::blocking;
-//  = nuraft::raft_params::async_handler;
+//  = nuraft::raft_params::blocking;
+    = nuraft::raft_params::async_handler;
+// search / query 等读请求的一致性
+enum class ReadConsistency {
+  EVENTUAL,    // 直接读本地数据, 可能读不到刚提交的写入
+  READ_INDEX,  // 向 leader 取得确认过领导权的 commit index, 等本地应用到这个位置后再读
+  LEASE,       // 同 READ_INDEX, 但 leader 在租约内不用等一轮心跳确认领导权
+};
+
+// 读之前的一致性检查的结果
+struct ReadIndexResult {
+  bool ok_ = false;
+  uint64_t read_index_ = 0;
+  nuraft::cmd_result_code code_ = nuraft::cmd_result_code::OK;
+  std::string error_;
+};
+
+// 一个进程承载多个 raft 组时每个组的参数和共用的资源, 由 RaftGroupManager 填写.
+// 缺省值对应只有组 0 的部署: 自己创建 asio_service 和日志刷盘线程
+struct RaftGroupOptions {
+  int group_id_ = 0;
+  std::string log_path_;  // raft 日志目录, 空串时使用 RAFT_LOG_PATH
+  nuraft::ptr<nuraft::asio_service> asio_service_;  // 所有组共用的网络和定时器线程池
+  LogFlushScheduler *flush_scheduler_ = nullptr;  // 所有组共用的日志刷盘线程池
+  TaskScheduler *batch_scheduler_ = nullptr;  // 所有组共用的 group commit 提交线程池
+  nuraft::ptr<nuraft::logger> logger_;  // 为空时写 ./srv<node_id>.log
+};
+
 class RaftStuff {
  public:
-  RaftStuff(int node_id, std::string &endpoint, int port, VectorDatabase *vector_database);
+  RaftStuff(int node_id, std::string &endpoint, int port, VectorDatabase *vector_database,
+            RaftGroupOptions options = RaftGroupOptions());
+  // 停掉 raft_server 并关闭监听端口, 共用的 asio_service 由创建者停止
+  ~RaftStuff();
 
   void Init();
-  auto AddSrv(int srv_id, const std::string &srv_endpoint) -> bool;
+  // learner 为 true 时作为不投票的 learner 加入, 只用来分担读请求
+  auto AddSrv(int srv_id, const std::string &srv_endpoint, bool learner = false) -> bool;
   void EnableElectionTimeout(int lower_bound, int upper_bound);  // 定义 enableElectionTimeout 方法
   auto IsLeader() const -> bool;                                 // 添加 isLeader 方法声明
   auto GetAllNodesInfo() const -> std::vector<std::tuple<int, std::string, std::string, nuraft::ulong, nuraft::ulong>>;
   auto GetCurrentNodesInfo() const -> std::tuple<int, std::string, std::string, nuraft::ulong, nuraft::ulong>;
   auto GetNodeStatus(int node_id) const -> std::string;  // 添加 getNodeStatus 方法声明
-  void AppendEntries(const std::string &entry);
+  auto GetLeader() const -> int;
+  auto GroupId() const -> int { return options_.group_id_; }
+  // 写请求交给 group commit, 不等待; 这一批提交到状态机(或失败)后调用 done
+  void AppendEntriesAsync(std::string entry, WriteBatcher::Callback done);
   auto GetSrvConfig(int srv_id) -> nuraft::ptr<nuraft::srv_config>;
-  void HandleResult(nuraft::cmd_result< nuraft::ptr<nuraft::buffer> >& result);
+  static auto ParseReadConsistency(const std::string &name, ReadConsistency *consistency) -> bool;
+  // 只在 leader 上调用: 确认自己仍是 leader 后返回当前的 commit index
+  auto ReadIndex(ReadConsistency consistency) -> ReadIndexResult;
+  // 任意节点: 按 consistency 取得 read index 并等本地状态机应用到这个位置, 返回后可以直接读本地数据
+  auto PrepareRead(ReadConsistency consistency) -> ReadIndexResult;
+  static auto ToWriteResult(nuraft::cmd_result<nuraft::ptr<nuraft::buffer>> &result) -> WriteResult;
+
  private:
- 
+  // WriteBatcher 的提交函数: 一批请求作为一条日志追加
+  void AppendBatch(nuraft::ptr<nuraft::buffer> batch, const WriteBatcher::Callback &done);
+  // 节点状态: leader / follower / learner
+  static auto NodeState(const nuraft::srv_config &srv, int leader_id) -> std::string;
+  // 过半投票成员(含自己)在最近 window_us 微秒内回复过 leader
+  auto QuorumRespondedWithin(uint64_t window_us) const -> bool;
+  // 等过半投票成员在调用之后回复过心跳, 说明这期间没有产生新的 leader
+  auto ConfirmLeadership() -> bool;
+  // follower 通过 HTTP 向 leader 请求 read index
+  auto RequestReadIndex(ReadConsistency consistency) -> ReadIndexResult;
+  // 到 leader 的 HTTP channel, leader 或其地址变化时重建; 建立失败返回 nullptr
+  auto LeaderChannel(int leader, const std::string &endpoint) -> std::shared_ptr<brpc::Channel>;
+
  private:
   int node_id_;
   std::string endpoint_;
+  nuraft::ptr<FileLogStore> log_store_;
   nuraft::ptr<nuraft::state_mgr> smgr_;
-  nuraft::ptr<nuraft::state_machine> sm_;
+  nuraft::ptr<LogStateMachine> sm_;
   int port_;
-  nuraft::raft_launcher launcher_;
+  RaftGroupOptions options_;
+  nuraft::ptr<nuraft::rpc_listener> listener_;
   nuraft::ptr<nuraft::raft_server> raft_instance_;
   VectorDatabase *vector_database_;  // 添加一个 VectorDatabase 指针成员变量
+  std::mutex leader_channel_mutex_;  // 保护下面三个成员
+  int leader_channel_id_ = -1;
+  std::string leader_channel_endpoint_;
+  std::shared_ptr<brpc::Channel> leader_channel_;  // 正在使用旧 channel 的请求持有它的引用, 重建不影响它们
+  std::unique_ptr<WriteBatcher> batcher_;  // 最后声明, 析构时先停掉提交线程
+
+  // 确认领导权时最多等待的心跳周期数
+  static constexpr int READ_INDEX_TIMEOUT_HEARTBEATS = 5;
 };
 
 }  // namespace vectordb
\ No newline at end of file
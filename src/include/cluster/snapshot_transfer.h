@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "libnuraft/buffer.hxx"
+#include "libnuraft/pp_util.hxx"
+
+namespace vectordb {
+
+// raft 快照按块传输. 一个快照是一个目录, 对象 0 是文件清单, 之后每个对象是某个文件中的一个定长块:
+//   清单: [u32 crc32c][u64 chunk_bytes][u32 文件数] 之后每个文件 [u32 路径长度][相对路径][u64 大小]
+//   数据块: [u64 obj_id][u32 crc32c(data)][data], 块不跨文件, obj_id 从 1 开始按文件顺序编号
+// 接收端把清单和已经落盘的块号记在接收目录里, 重新开始传输时从第一个没有落盘的块继续
+struct SnapshotFileEntry {
+  std::string path_;  // 相对快照目录的路径
+  uint64_t size_ = 0;
+};
+
+class SnapshotManifest {
+ public:
+  SnapshotManifest() = default;
+  SnapshotManifest(std::vector<SnapshotFileEntry> files, uint64_t chunk_bytes);
+
+  auto Serialize() const -> nuraft::ptr<nuraft::buffer>;
+  // 校验失败时抛出 std::runtime_error
+  static auto Deserialize(const nuraft::buffer &buf) -> SnapshotManifest;
+
+  auto Files() const -> const std::vector<SnapshotFileEntry> & { return files_; }
+  auto ChunkBytes() const -> uint64_t { return chunk_bytes_; }
+  auto ChunkCount() const -> uint64_t { return chunk_count_; }
+  // obj_id 对应的文件下标和文件内偏移
+  void Locate(uint64_t obj_id, size_t *file_idx, uint64_t *offset) const;
+
+ private:
+  std::vector<SnapshotFileEntry> files_;
+  uint64_t chunk_bytes_ = 0;
+  uint64_t chunk_count_ = 0;
+  std::vector<uint64_t> first_chunk_;  // 每个文件第一个块的 obj_id
+};
+
+// leader 端: 打开一个已经生成好的快照目录, 按 obj_id 读取清单或数据块
+class SnapshotReader {
+ public:
+  // exclude 中的文件(快照元数据)不参与传输
+  SnapshotReader(const std::string &dir, uint64_t chunk_bytes, const std::vector<std::string> &exclude = {});
+  ~SnapshotReader();
+
+  auto ChunkCount() const -> uint64_t { return manifest_.ChunkCount(); }
+  auto Read(uint64_t obj_id) -> nuraft::ptr<nuraft::buffer>;
+
+ private:
+  std::string dir_;
+  SnapshotManifest manifest_;
+  std::map<size_t, int> fds_;  // 打开过的文件
+};
+
+// follower 端: 把收到的块写进接收目录, 全部收齐后改名成最终的快照目录
+class SnapshotReceiver {
+ public:
+  explicit SnapshotReceiver(const std::string &dir, uint64_t sync_interval_bytes = SYNC_INTERVAL_BYTES);
+  ~SnapshotReceiver();
+
+  // 收到清单时调用, 返回下一个需要的 obj_id; 接收目录里是同一个清单时从上次落盘的位置继续
+  auto Begin(const nuraft::buffer &manifest) -> uint64_t;
+  // 进程重启后 leader 继续发数据块时, 从接收目录里恢复清单; 没有可用的清单时返回 false
+  auto Resume() -> bool;
+  // 写入一个数据块, 校验失败返回 false, 调用方应要求重发同一个块
+  auto Write(uint64_t obj_id, const nuraft::buffer &chunk) -> bool;
+  // 刷盘并把接收目录改名为 final_dir
+  void Finish(const std::string &final_dir);
+
+  auto ChunkCount() const -> uint64_t { return manifest_.ChunkCount(); }
+  auto NextObjId() const -> uint64_t { return next_obj_id_; }
+
+  static constexpr const char *MANIFEST_FILE_NAME = "TRANSFER_MANIFEST";
+  static constexpr const char *PROGRESS_FILE_NAME = "TRANSFER_PROGRESS";
+  // 每写这么多字节刷一次盘并记录进度
+  static constexpr uint64_t SYNC_INTERVAL_BYTES = 64 << 20;
+
+ private:
+  void Reset();
+  void CloseFiles();
+  // fdatasync 写过的文件后记录进度
+  void Sync();
+
+  std::string dir_;
+  uint64_t sync_interval_bytes_;
+  SnapshotManifest manifest_;
+  bool has_manifest_ = false;
+  uint64_t next_obj_id_ = 1;
+  uint64_t unsynced_bytes_ = 0;
+  std::map<size_t, int> fds_;
+};
+
+}  // namespace vectordb
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "common/task_scheduler.h"
+#include "libnuraft/async.hxx"
+#include "libnuraft/buffer.hxx"
+#include "libnuraft/pp_util.hxx"
+
+namespace vectordb {
+
+// 一次复制写入的结果, 同一批里的请求拿到相同的日志 id
+struct WriteResult {
+  bool ok_ = false;
+  uint64_t log_idx_ = 0;
+  // 失败原因, 调用方据此区分不是 leader / 超时 / 其他错误
+  nuraft::cmd_result_code code_ = nuraft::cmd_result_code::OK;
+  std::string error_;
+};
+
+// raft group commit: 并发到达的写请求攒成一条日志提交. 第一个请求到达后最多再等 max_delay,
+// 或者攒够 max_batch_bytes / max_batch_count 就立即提交; 上一批在复制期间到达的请求自然进入下一批
+class WriteBatcher : public ScheduledTask {
+ public:
+  using Callback = std::function<void(const WriteResult &)>;
+  // 把编码好的一批请求追加到 raft, 复制完成(或失败)后调用 done
+  using AppendFn = std::function<void(nuraft::ptr<nuraft::buffer>, const Callback &done)>;
+
+  // compress 为 true 时每一批用 snappy 压缩后再写进日志;
+  // scheduler 不为空时由共用的线程池按时提交, 否则自己开一个提交线程
+  WriteBatcher(AppendFn append, std::chrono::microseconds max_delay, size_t max_batch_bytes, size_t max_batch_count,
+               bool compress = false, TaskScheduler *scheduler = nullptr);
+  ~WriteBatcher() override;
+
+  // request 为 RaftCommand::EncodeUpsert 编码好的一条写入;
+  // done 在这一批提交完成后调用, 调用线程是批量提交线程或 raft 的提交线程
+  void Submit(std::string request, Callback done);
+  void Stop();
+  // 共用线程池到时调用: 提交当前攒下的请求
+  void RunScheduled() override;
+
+ private:
+  struct Pending {
+    std::string request_;
+    Callback done_;
+  };
+
+  void FlushLoop();
+  void Flush(std::vector<Pending> *batch);
+  // 取走当前攒下的请求, 调用时持有 mutex_
+  auto TakePending() -> std::vector<Pending>;
+
+  AppendFn append_;
+  std::chrono::microseconds max_delay_;
+  size_t max_batch_bytes_;
+  size_t max_batch_count_;
+  bool compress_;
+  TaskScheduler *scheduler_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<Pending> pending_;
+  size_t pending_bytes_ = 0;
+  bool stop_ = false;
+  std::thread flush_thread_;
+};
+
+}  // namespace vectordb
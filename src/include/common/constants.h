@@ -4,13 +4,47 @@ namespace vectordb {
 
 #define RESPONSE_VECTORS "vectors"
 #define RESPONSE_DISTANCES "distances"
+#define RESPONSE_FIELDS "fields"
+#define RESPONSE_DOCUMENTS "documents"
+#define RESPONSE_LOG_INDEX "logIndex" // 写入提交后的 raft 日志 id
+#define RESPONSE_READ_INDEX "readIndex" // leader 确认过领导权的 commit index
 
 #define REQUEST_VECTORS "vectors"
 #define REQUEST_K "k"
 #define REQUEST_ID "id"
 #define REQUEST_INDEX_TYPE "indexType"
+#define REQUEST_REFINE_FACTOR "refineFactor" // 精排过采样倍数
+#define REFINE_MAX_CANDIDATES 100000 // 精排时每个查询最多取的候选数
+#define REQUEST_RADIUS "radius" // 范围检索半径, 与索引返回的距离同单位(L2 平方)
+#define REQUEST_MAX_RESULTS "maxResults"
+#define REQUEST_OUTPUT_FIELDS "outputFields"
+#define REQUEST_IDS "ids"
+#define REQUEST_CONSISTENCY "consistency" // 读一致性, 缺省为 eventual
+#define CONSISTENCY_EVENTUAL "eventual"
+#define CONSISTENCY_READ_INDEX "read_index"
+#define CONSISTENCY_LEASE "lease"
+#define READ_INDEX_PATH "/AdminService/ReadIndex" // follower 向 leader 取 read index 的接口
+#define BATCH_QUERY_MAX_IDS 100000 // 单次批量查询的 id 上限
+#define REPLAY_APPLY_BATCH 4096 // WAL 回放时每批应用的记录数
+#define REPLAY_PROGRESS_INTERVAL_SEC 5 // WAL 回放进度日志的间隔
+#define SNAPSHOT_MAX_LOG_ID_FILE "MaxLogID" // 快照目录中记录快照覆盖到的最大日志 id
+#define VECTOR_STORE_FILE_NAME "vector_store" // 向量文件前缀
+#define VECTOR_STORE_DIR_SUFFIX "_vector_store" // 向量文件目录与 RocksDB 目录同级, 名字为 RocksDB 目录加此后缀
+#define VECTOR_REPAIR_BATCH 4096 // 启动时按批从 RocksDB 读取待修复的向量
+#define RAFT_SNAPSHOT_DIR "raft/" // raft 快照目录, 位于 SNAP_PATH 下, 每个快照一个以日志 id 命名的子目录
+#define SNAPSHOT_INDEX_DIR "index/" // raft 快照中的索引文件
+#define SNAPSHOT_ROCKSDB_DIR "rocksdb" // raft 快照中的 RocksDB checkpoint
+#define DEFAULT_RANGE_SEARCH_MAX_RESULTS 10000
 #define INSTANCE_ID "instanceId"
 #define NODE_ID "nodeId"
+#define REQUEST_LEARNER "learner" // 作为不投票的 learner 加入集群
+#define REQUEST_GROUP_ID "groupId" // 请求所在的 raft 组, 缺省为 0
+#define NODE_STATE_LEADER "leader" // AdminService 返回的节点状态
+#define NODE_STATE_FOLLOWER "follower"
+#define NODE_STATE_LEARNER "learner"
+#define NODE_ROLE_LEADER 0 // MasterService 节点信息中的 role
+#define NODE_ROLE_FOLLOWER 1
+#define NODE_ROLE_LEARNER 2 // proxy 优先把读请求发给 learner
 
 #define RESPONSE_RETCODE "retCode" // 添加宏定义
 #define RESPONSE_RETCODE_SUCCESS 0
@@ -21,6 +55,8 @@ namespace vectordb {
 #define RESPONSE_CONTENT_TYPE_JSON "application/json"
 #define RESPONSE_CONTENT_TYPE_TEXT "text/plain"
 
+#define DEFAULT_INDEX_DIM 1 // 启动时创建索引的向量维度
+#define DEFAULT_INDEX_CAPACITY 100 // 启动时 HNSW 索引的初始容量
 #define INDEX_TYPE_FLAT "FLAT" // 添加宏定义
 #define INDEX_TYPE_HNSW "HNSW" // 添加宏定义
 
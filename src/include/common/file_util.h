@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace vectordb {
+
+// raft 日志、raft 状态、快照接收和 WAL 转换共用的落盘工具
+
+// 目录项的新建和改名需要 fsync 目录才能保证崩溃后可见; 打不开目录时忽略
+void SyncDir(const std::string &dir);
+
+// 从 offset 开始把 size 字节全部 pwrite 到 fd, 处理 EINTR 和短写; 失败抛出 std::runtime_error, path 只用于报错
+void WriteFully(int fd, const char *data, size_t size, uint64_t offset, const std::string &path);
+
+// 先写 path.tmp 并 fsync, 再改名为 path 并 fsync 所在目录, 崩溃后 path 要么是旧内容要么是完整的新内容.
+// 失败抛出 std::runtime_error
+void WriteFileSync(const std::string &path, const std::string &content);
+
+}  // namespace vectordb
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace vectordb {
+
+// 交给 TaskScheduler 运行的后台任务
+class ScheduledTask {
+ public:
+  virtual ~ScheduledTask() = default;
+  virtual void RunScheduled() = 0;
+};
+
+// 一个进程承载多个 raft 组时共用的后台线程池, 取代每个索引、每个写入攒批器各自的后台线程.
+// Schedule 之后到了指定时间由池中的某个线程调用 RunScheduled; 同一个任务同时只在一个线程上运行,
+// 已经排队的任务再次 Schedule 时按较早的时间运行
+class TaskScheduler {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit TaskScheduler(size_t threads);
+  ~TaskScheduler();
+
+  void Schedule(ScheduledTask *task, Clock::time_point when = Clock::now());
+  // 任务析构前调用: 移出队列并等待正在进行的运行结束. 不能在任务自己的 RunScheduled 中调用
+  void Remove(ScheduledTask *task);
+
+ private:
+  void Loop();
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::condition_variable idle_cv_;  // 某个任务运行结束
+  std::map<ScheduledTask *, Clock::time_point> queued_;
+  std::set<std::pair<Clock::time_point, ScheduledTask *>> deadlines_;  // 按运行时间排序的 queued_
+  std::set<ScheduledTask *> running_;
+  bool stop_ = false;
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace vectordb
@@ -3,7 +3,9 @@
 #include <rapidjson/document.h>
 #include <rapidjson/istreamwrapper.h>
 #include <cassert>
+#include <map>
 #include <string>
+#include <vector>
 #include "common/vector_utils.h"
 #include "spdlog/spdlog.h"
 namespace vectordb {
@@ -17,6 +19,48 @@ struct RaftCfg {
   int node_id_;
   std::string endpoint_;
   int port_;
+  std::string log_path_;  // raft 日志段文件目录, 缺省为 WAL_PATH 同级的 raft_log
+};
+
+// vectordb_config 中可选的 RAFT_LOG 段
+struct RaftLogCfg {
+  size_t segment_bytes_{64 << 20};  // 单个段文件预分配的大小, 必须小于 4GiB
+  uint64_t snapshot_distance_{100000};  // 每提交这么多条日志生成一次 raft 快照
+  uint64_t reserved_log_items_{10000};  // 快照之后保留的日志条数, 落后不多的 follower 不需要传快照
+  size_t snapshot_chunk_bytes_{4 << 20};  // 快照传输时每个块的大小
+  uint64_t batch_delay_us_{300};  // group commit 从第一个请求到达起最多等待的时间
+  size_t batch_max_bytes_{1 << 20};  // 一条日志最多携带的请求字节数
+  size_t batch_max_count_{1024};  // 一条日志最多携带的请求数
+  std::string compression_{"none"};  // none / snappy, snappy 时每条日志的记录整体压缩
+};
+
+// vectordb_config 中可选的 MULTI_RAFT 段. 一个进程可以承载多个 raft 组(每个分区一个),
+// 所有组共用 asio 线程池和日志刷盘线程, 每个组有自己的端口、数据目录和状态机
+struct MultiRaftCfg {
+  int port_stride_{100};  // 组 g 监听 RAFT PORT + g * PORT_STRIDE
+  size_t asio_threads_{4};  // 所有组共用的 raft 网络和定时器线程数
+  size_t log_flush_threads_{2};  // 所有组共用的 raft 日志刷盘线程数
+  size_t compact_threads_{1};  // 所有组的索引共用的后台压缩线程数
+  size_t batch_threads_{2};  // 所有组共用的 group commit 提交线程数
+  size_t decode_threads_{4};  // 所有组的批量查询共用的解码线程数
+};
+
+// 单个 column family 的调优参数
+struct RocksDbCfCfg {
+  size_t block_cache_mb_;
+  int bloom_bits_per_key_;        // 0 表示不建 bloom filter
+  std::string compression_;       // none / snappy / lz4 / zstd, 链接的 RocksDB 不支持时换成 lz4 或 snappy
+  std::string compaction_style_;  // level / universal / fifo
+  size_t write_buffer_mb_;
+};
+
+// vectordb_config 中可选的 ROCKSDB 段, 缺省时使用下面的默认值
+struct RocksDbCfg {
+  bool statistics_{true};
+  // 向量是随机浮点, 压缩收益很小, 关闭压缩省 CPU
+  RocksDbCfCfg vectors_{256, 10, "none", "level", 64};
+  RocksDbCfCfg attributes_{128, 10, "zstd", "level", 64};
+  RocksDbCfCfg meta_{8, 0, "none", "level", 4};
 };
 
 class Cfg : public Singleton<Cfg> {
@@ -49,11 +93,25 @@ class Cfg : public Singleton<Cfg> {
   auto RaftNodeId() const noexcept -> int { return raft_cfg_.node_id_; }
   auto RaftPort() const noexcept -> int { return raft_cfg_.port_; }
   auto RaftEndpoint() const noexcept -> const std::string & { return raft_cfg_.endpoint_; }
+  auto RaftLogPath() const noexcept -> const std::string & { return raft_cfg_.log_path_; }
+  // CLUSTER_INFO 中其他节点的 HTTP 地址, 未知节点返回空串
+  auto HttpEndpoint(int node_id) const -> std::string {
+    auto it = http_endpoints_.find(node_id);
+    return it == http_endpoints_.end() ? std::string() : it->second;
+  }
+  auto RaftLog() const noexcept -> const RaftLogCfg & { return raft_log_cfg_; }
+  // 本节点承载的 raft 组, CLUSTER_INFO 中没有配置 RAFT_GROUPS 时只有组 0
+  auto RaftGroups() const noexcept -> const std::vector<int> & { return raft_groups_; }
+  auto MultiRaft() const noexcept -> const MultiRaftCfg & { return multi_raft_cfg_; }
+  // 组 0 使用配置中的目录, 其他组使用同级的 <目录>_group_<g>, 保留结尾的 '/'
+  static auto GroupPath(const std::string &path, int group_id) -> std::string;
+  auto RocksDb() const noexcept -> const RocksDbCfg & { return rocksdb_cfg_; }
 
  private:
   Cfg() { ParseCfgFile(cfg_path,node_id); }
 
   void ParseCfgFile(const std::string &path, const int &node_id);
+  static void ParseRocksDbCfCfg(const rapidjson::Value &cf_cfg, RocksDbCfCfg *cfg);
 
   
   std::string m_rocks_db_path_;
@@ -61,12 +119,17 @@ class Cfg : public Singleton<Cfg> {
   std::string snap_path_;
   LogCfg m_log_cfg_;
   RaftCfg raft_cfg_;
+  RocksDbCfg rocksdb_cfg_;
+  RaftLogCfg raft_log_cfg_;
+  MultiRaftCfg multi_raft_cfg_;
+  std::vector<int> raft_groups_{0};
 
   std::string test_rocks_db_path_;
   std::string test_wal_path_;
   std::string test_snap_path_;
   std::string address_;
   int port_;
+  std::map<int, std::string> http_endpoints_;  // node id -> RAFT ENDPOINT 的主机 + PORT
 
   static std::string cfg_path;
   static int node_id;
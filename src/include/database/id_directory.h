@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <rapidjson/document.h>
+#include "index/index_factory.h"
+
+namespace vectordb {
+
+// 常驻内存的 id 目录: 记录 id 是否存在、所在索引以及旧的 int 过滤字段,
+// 让 upsert 不再需要先从 RocksDB 读出并解析整条 JSON.
+// 以 id 为 key 的开放寻址表(线性探测), 每个槽位是定长的 16 字节: id + 索引类型 + 字段在共享字段区中的区间;
+// 所有 id 的 (字段编号, 值) 按列存放在同一块字段区里, 不为每个 id 单独分配内存
+class IdDirectory {
+public:
+    // 字段名统一驻留成 uint32 编号, 每个 id 的字段按编号升序排列
+    using FieldValues = std::vector<std::pair<uint32_t, int64_t>>;
+
+    struct Entry {
+        IndexFactory::IndexType index_type_;
+        FieldValues int_fields_;
+    };
+
+    IdDirectory();
+
+    // 查找 id, 不存在返回 false
+    auto Lookup(uint64_t id, Entry* entry) const -> bool;
+    auto Contains(uint64_t id) const -> bool;
+    // 插入或覆盖 id 的记录; 单个 id 的字段数超过 MAX_FIELDS_PER_ID 时抛出 std::runtime_error
+    void Put(uint64_t id, IndexFactory::IndexType index_type, FieldValues int_fields);
+    auto Size() const -> size_t;
+    void Clear();
+
+    // 从写入的 JSON 文档中提取 int 类型字段(不含 id)
+    auto ExtractIntFields(const rapidjson::Value& data) -> FieldValues;
+    // 同上, 输入是 RecordCodec 编码的标量字段
+    auto ExtractEncodedIntFields(std::string_view attributes) -> FieldValues;
+    auto InternField(const std::string& field_name) -> uint32_t;
+    auto FieldName(uint32_t field_id) const -> std::string;
+    // 在 FieldValues 中查找某个字段的旧值, 没有返回 false
+    static auto FindField(const FieldValues& fields, uint32_t field_id, int64_t* value) -> bool;
+
+    static constexpr size_t INITIAL_CAPACITY = 1024;  // 槽位数, 保持为 2 的幂
+    static constexpr size_t MAX_LOAD_PERCENT = 70;    // 占用超过该比例时槽位数翻倍
+    static constexpr size_t MAX_FIELDS_PER_ID = UINT16_MAX;
+
+private:
+    struct Slot {
+        uint64_t id_;
+        uint32_t field_offset_;  // 在 field_ids_ / field_values_ 中的起始位置
+        uint16_t field_count_;
+        int8_t index_type_;
+        uint8_t used_;
+    };
+    static_assert(sizeof(Slot) == 16, "IdDirectory::Slot must stay packed");
+
+    // 返回 id 所在的槽位, 不存在时返回应插入的空槽位
+    auto FindSlot(uint64_t id) const -> size_t;
+    void Grow();
+    // 字段区中失效的部分超过一半时按槽位顺序重新排列
+    void CompactFields();
+
+    mutable std::mutex mutex_;
+    std::vector<Slot> slots_;
+    size_t size_ = 0;
+    // 共享字段区, 按列存放: 字段编号和值分成两个数组, 每个字段占 12 字节
+    std::vector<uint32_t> field_ids_;
+    std::vector<int64_t> field_values_;
+    size_t dead_fields_ = 0;  // 覆盖写留下的、不再被任何槽位引用的字段数
+
+    std::unordered_map<std::string, uint32_t> field_name_ids_;
+    std::vector<std::string> field_names_;
+};
+
+}  // namespace vectordb
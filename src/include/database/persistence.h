@@ -1,35 +1,67 @@
 #pragma once
 
+#include <atomic>
 #include <string>
 #include <fstream>
+#include <mutex>
 #include <cstdint> // 包含 <cstdint> 以使用 uint64_t 类型
+#include <functional>
+#include <vector>
 #include <rapidjson/document.h> // 包含 rapidjson/document.h 以使用 JSON 对象
 #include <snappy/snappy.h>
 #include "index/index_factory.h"
 #include "common/vector_cfg.h"
+#include "database/wal_record.h"
 namespace vectordb {
 
+// 回放时交给上层应用的一条 WAL 记录
+struct WalReplayRecord {
+    uint64_t log_id_ = 0;
+    std::string operation_type_;
+    rapidjson::Document data_;
+};
+
+// 复制写入只写 raft 日志, 这里不再写 WAL; 只负责回放旧版本留下的 WAL 目录,
+// 以及索引快照的保存、加载和导出
 class Persistence {
 public:
     Persistence();
     ~Persistence();
 
-    void Init(const std::string& local_path); // 添加 init 方法声明
-    auto IncreaseId() -> uint64_t;
+    // index_factory 为空时使用全局实例, snap_path 为空时使用配置中的 SNAP_PATH
+    void Init(const std::string& local_path, IndexFactory* index_factory = nullptr,
+              const std::string& snap_path = std::string());
     auto GetId() const -> uint64_t;
-    void WriteWalLog(const std::string& operation_type, const rapidjson::Document& json_data, const std::string& version); // 添加 version 参数
-    void WriteWalRawLog(uint64_t log_id, const std::string& operation_type, const std::string& raw_data, const std::string& version); // 添加 writeWALRawLog 函数声明
-    void ReadNextWalLog(std::string* operation_type, rapidjson::Document* json_data); // 更改返回类型为 void 并添加指针参数
-    void TakeSnapshot(); 
+    // 记录已应用的日志 id, 快照以它为覆盖位置
+    void AdvanceId(uint64_t log_id);
+    // 并行回放: 多个线程同时解码一组段, 合并后同一个 id 只保留最后一次写入,
+    // 再按 WAL 顺序分批交给 apply; 解码下一组段与应用当前这组同时进行
+    void ReplayWal(const std::function<void(std::vector<WalReplayRecord>*)>& apply);
+    // 可以在提交线程以外调用: 先取覆盖位置再保存索引, 保存下来的索引至少包含到这个位置
+    void TakeSnapshot();
     void LoadSnapshot(); // 添加 loadSnapshot 方法声明
+    // 把最近一次快照的索引文件硬链接到 dir, 作为 raft 快照的一部分
+    void ExportSnapshot(const std::string& dir);
+    // 用 raft 快照中的索引文件替换本地快照并加载, 快照覆盖位置设为 log_id
+    void InstallSnapshot(const std::string& dir, uint64_t log_id);
     void SaveLastSnapshotId(const std::string& folder_path); // 添加 saveLastSnapshotID 方法声明
     void LoadLastSnapshotId(const std::string& folder_path); // 添加 loadLastSnapshotID 方法声明
 
 
 private:
-    uint64_t increase_id_;
+    // 回放前的准备: 转换旧的按行格式
+    void PrepareWalFile(const std::string& path);
+    void ConvertLegacyWal(const std::string& path);
+    // 旧版本的单文件 WAL 迁移到段目录中
+    void MigrateSingleFileWal(const std::string& path);
+
+    std::atomic<uint64_t> increase_id_; // 只在提交线程中推进, 后台保存快照时读取
     uint64_t last_snapshot_id_; // 添加 lastSnapshotID_ 成员变量
-    std::fstream wal_log_file_; // 将 wal_log_file_ 类型更改为 std::fstream
+    std::mutex snapshot_mutex_; // 管理接口和 raft 的后台快照可能同时保存索引文件
+    std::string wal_dir_;
+    std::string snap_path_; // 索引快照目录
+    IndexFactory* index_factory_ = nullptr;
+    std::vector<std::string> replay_segments_; // 启动时需要回放的段
 };
 
 }  // namespace vectordb
\ No newline at end of file
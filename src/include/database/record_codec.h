@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <rapidjson/document.h>
+
+namespace vectordb {
+
+// 标量存储的二进制记录格式:
+// [u8 格式版本][u32 字段数] 之后每个字段为 [u16 名字长度][名字][u8 类型][值]
+// 向量字段保存为原始 float32 数组, 嵌套对象和普通数组退化为 JSON 文本; 数值按本机字节序(小端)存放
+class RecordCodec {
+public:
+    static constexpr uint8_t RECORD_FORMAT_V1 = 1;
+
+    enum class FieldType : uint8_t {
+        NULL_VALUE = 0,
+        FALSE_VALUE = 1,
+        TRUE_VALUE = 2,
+        INT64 = 3,
+        UINT64 = 4,
+        DOUBLE = 5,
+        STRING = 6,
+        FLOAT_VECTOR = 7,  // [u32 个数][float32 ...]
+        JSON = 8,          // [u32 长度][JSON 文本]
+    };
+
+    // 字段名长度以 u16 存放
+    static constexpr size_t MAX_FIELD_NAME_LENGTH = UINT16_MAX;
+
+    // include_vectors 为 false 时跳过向量字段, 向量单独存放在 vectors column family;
+    // 字段名超过 MAX_FIELD_NAME_LENGTH 时抛出 std::runtime_error
+    static auto Encode(const rapidjson::Value& doc, bool include_vectors = true) -> std::string;
+    // fields 非空时只解码这些字段, 其余字段按长度跳过
+    static auto Decode(std::string_view data, rapidjson::Document* doc, const std::vector<std::string>& fields = {})
+        -> bool;
+    // 只取向量字段, 不构造 JSON
+    static auto DecodeVector(std::string_view data, std::vector<float>* vector) -> bool;
+    // 只取 int32 范围内的整数字段(与 JSON 的 IsInt() 一致), 不构造 JSON; 名字指向 data 内部
+    static auto DecodeIntFields(std::string_view data, std::vector<std::pair<std::string_view, int64_t>>* fields)
+        -> bool;
+
+    // vectors column family 的值: 原始 float32 数组, 不带任何头部
+    static auto EncodeRawVector(const rapidjson::Value& array) -> std::string;
+    static void DecodeRawVector(std::string_view data, std::vector<float>* vector);
+
+    // 8 字节大端 key, 字典序与 id 数值序一致
+    static auto EncodeKey(uint64_t id) -> std::string;
+    static auto DecodeKey(std::string_view key, uint64_t* id) -> bool;
+};
+
+}  // namespace vectordb
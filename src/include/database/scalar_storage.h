@@ -2,28 +2,130 @@
 #define SCALART_STORAGE_H
 
 #include <rocksdb/db.h>
+#include <rocksdb/statistics.h>
+#include <rocksdb/write_batch.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <shared_mutex>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 #include <rapidjson/document.h> // 包含rapidjson头文件
+#include "common/task_scheduler.h"
+#include "common/vector_cfg.h"
 namespace vectordb {
+// 已经编码好的一条记录, 直接写入对应的 column family
+struct EncodedScalar {
+    uint64_t id_;
+    std::string_view vector_;      // 原始 float32 数组, 为空时删除旧向量
+    std::string_view attributes_;  // RecordCodec 编码的标量字段, 不含向量
+};
+
+// 数据按用途拆成三个 column family:
+//   vectors    -> 原始 float32 向量, 向量的持久化来源; mmap 的 VectorStore 不逐条刷盘, 启动时据此修复
+//   attributes -> 去掉向量后的标量字段(二进制记录)
+//   meta       -> 存储格式版本、快照标记等内部元数据, 以及向量存储的刷盘水位和之后写入的 id
 class ScalarStorage {
 public:
-    // 构造函数，打开RocksDB
-    explicit ScalarStorage(const std::string& db_path);
+    // 构造函数，打开RocksDB; decode_scheduler 不为空时 MultiGetScalar 借用这个共用线程池并行解码
+    explicit ScalarStorage(const std::string& db_path, const RocksDbCfg& cfg = RocksDbCfg(),
+                           TaskScheduler* decode_scheduler = nullptr);
 
     // 析构函数，关闭RocksDB
     ~ScalarStorage();
 
-    // 向量插入函数
-    void InsertScalar(uint64_t id, const rapidjson::Document& data); // 将参数类型更改为rapidjson::Document
+    // 向量插入函数; log_id 非 0 时在同一个 WriteBatch 中记下已应用的日志 id
+    void InsertScalar(uint64_t id, const rapidjson::Document& data, uint64_t log_id = 0);
+
+    // 多条记录放进同一个 WriteBatch 写入, 用于 WAL 回放
+    void InsertScalarBatch(const std::vector<std::pair<uint64_t, const rapidjson::Document*>>& records,
+                           uint64_t log_id = 0);
+    // 同上, 记录已经是存储格式, 不经过 JSON; 用于应用 raft 日志中的二进制命令
+    void InsertEncodedBatch(const std::vector<EncodedScalar>& records, uint64_t log_id = 0);
+    // 已经持久化到 RocksDB 的最大日志 id, 没有记录时返回 0
+    auto AppliedLogId() -> uint64_t;
 
     // 根据ID查询向量函数
     auto GetScalar(uint64_t id) -> rapidjson::Document; // 将返回类型更改为rapidjson::Document
 
+    // 一次 MultiGet 批量读取多个 id, fields 非空时只保留这些字段; 不存在的 id 对应空文档
+    auto MultiGetScalar(const std::vector<uint64_t>& ids, const std::vector<std::string>& fields = {})
+        -> std::vector<rapidjson::Document>;
+
+    // 顺序遍历所有记录, 用于启动时预热内存结构; with_vectors 为 false 时不读 vectors column family
+    void ForEach(const std::function<void(uint64_t, const rapidjson::Document&)>& callback, bool with_vectors = true);
+
+    // 每个写入 batch 分到一个递增的序号, 并在 meta 中记下本批写入的 id.
+    // 向量存储 msync 之前取当前序号, 成功后调用 MarkVectorsFlushed 记为水位并删除序号更小的记录
+    auto VectorWriteSeq() const -> uint64_t { return vector_write_seq_.load(); }
+    void MarkVectorsFlushed(uint64_t seq);
+    // 取出水位之后写入过的 id(已去重); 没有水位(新库或刚安装快照)时返回 false, 需要全量比对
+    auto UnflushedVectorIds(std::vector<uint64_t>* ids) -> bool;
+
+    // 内部元数据读写
+    void PutMeta(const std::string& key, const std::string& value);
+    auto GetMeta(const std::string& key, std::string* value) -> bool;
+
+    // 在 dir(不能已经存在)导出当前数据的 checkpoint, 用于生成 raft 快照
+    void CreateCheckpoint(const std::string& dir);
+    // 用 checkpoint 替换当前数据并重新打开, 用于安装 leader 发来的 raft 快照
+    void RestoreCheckpoint(const std::string& checkpoint_dir);
+
+    // RocksDB 统计信息和各 column family 的属性, 供 admin 接口调优使用
+    auto Stats() -> std::vector<std::pair<std::string, std::string>>;
+
+    // 并行解码时每块的结果数, 结果较少时不启用并行
+    static constexpr size_t MULTI_GET_DECODE_CHUNK = 256;
+    // 一次请求最多交给线程池的任务数, 调用线程自己也参与解码
+    static constexpr size_t MULTI_GET_MAX_HELPERS = 8;
+
+    static constexpr const char* CF_VECTORS = "vectors";
+    static constexpr const char* CF_ATTRIBUTES = "attributes";
+    static constexpr const char* CF_META = "meta";
+
+    // 存储格式版本: 0 为十进制 key + JSON, 1 为 default CF 中的二进制记录, 2 为拆分 column family
+    static constexpr const char* SCALAR_FORMAT_VERSION_KEY = "__meta__:format_version";
+    static constexpr int SCALAR_FORMAT_VERSION = 2;
+    static constexpr size_t SCALAR_MIGRATION_BATCH = 1000;
+    // 迁移时无法转换而留在 default CF 中的旧记录数
+    static constexpr const char* MIGRATION_SKIPPED_KEY = "__meta__:migration_skipped";
+    static constexpr const char* APPLIED_LOG_ID_KEY = "__meta__:applied_log_id";
+    // 向量存储已经刷盘的写入序号; 之后每个 batch 一条 VECTOR_DIRTY_PREFIX + 大端序号 -> 本批 id 数组
+    static constexpr const char* VECTOR_FLUSHED_SEQ_KEY = "__meta__:vector_flushed_seq";
+    static constexpr const char* VECTOR_DIRTY_PREFIX = "__meta__:vector_dirty:";
+
 private:
-    // RocksDB实例
-    rocksdb::DB* db_;
+    void Open(const std::string& db_path, const RocksDbCfg& cfg);
+    void Close();
+    static auto BuildCfOptions(const RocksDbCfCfg& cfg) -> rocksdb::ColumnFamilyOptions;
+    // 打开时把 default CF 中的旧格式数据迁移到拆分后的 column family
+    void MigrateIfNeeded();
+    void WriteOrThrow(rocksdb::WriteBatch* batch);
+    // 在 batch 中记下这批写入的 id, 调用方持有 db_mutex_
+    void MarkVectorsDirty(rocksdb::WriteBatch* batch, const std::vector<uint64_t>& ids);
+    // 打开时从 meta 恢复写入序号; 在 Open 内调用, 不加锁
+    void LoadVectorWriteSeq();
+    // 删除水位和所有待刷盘记录, 快照带来的记录描述的是 leader 的向量文件
+    void ResetVectorWatermark();
+    void PutRecord(rocksdb::WriteBatch* batch, uint64_t id, const rapidjson::Value& data);
+    static void DecodeScalar(const rocksdb::Slice& attributes, const rocksdb::Slice* vector,
+                             const std::vector<std::string>& fields, rapidjson::Document* result);
+
+    std::string db_path_;
+    RocksDbCfg cfg_;
+    // RocksDB实例; RestoreCheckpoint 替换 db_ 时持独占锁, 其余访问持共享锁
+    mutable std::shared_mutex db_mutex_;
+    rocksdb::DB* db_ = nullptr;
+    std::vector<rocksdb::ColumnFamilyHandle*> handles_;
+    rocksdb::ColumnFamilyHandle* vectors_cf_ = nullptr;
+    rocksdb::ColumnFamilyHandle* attributes_cf_ = nullptr;
+    rocksdb::ColumnFamilyHandle* meta_cf_ = nullptr;
+    std::shared_ptr<rocksdb::Statistics> statistics_;
+    std::atomic<uint64_t> vector_write_seq_{0};
+    TaskScheduler* decode_scheduler_;
 };
 }  // namespace vectordb
 
-#endif
\ No newline at end of file
+#endif
@@ -1,6 +1,8 @@
 #pragma once
 
+#include "database/id_directory.h"
 #include "database/scalar_storage.h"
+#include "database/vector_store.h"
 #include "index/index_factory.h"
 #include <string>
 #include <vector>
@@ -8,23 +10,81 @@
 #include "database/persistence.h"
 namespace vectordb {
 
+// 一条已经解码的写入. raft 日志中的二进制命令直接解码成它, follower 应用时不再解析 JSON
+struct UpsertRecord {
+    uint64_t id_ = 0;
+    IndexFactory::IndexType index_type_ = IndexFactory::IndexType::UNKNOWN;
+    std::vector<float> vector_;
+    std::string attributes_;  // RecordCodec 编码的标量字段, 不含向量
+};
+
 class VectorDatabase {
 public:
-    // 构造函数
-    explicit VectorDatabase(const std::string& db_path,const std::string& wal_path);
+    // 构造函数. 多个 raft 组各有一个 VectorDatabase, 索引和快照目录互相独立;
+    // index_factory 为空时使用全局实例, snap_path 为空时使用配置中的 SNAP_PATH,
+    // decode_scheduler 为各组共用的批量查询解码线程池, 为空时在请求线程中解码
+    explicit VectorDatabase(const std::string& db_path,const std::string& wal_path, const RocksDbCfg& rocksdb_cfg = RocksDbCfg(),
+                            IndexFactory* index_factory = nullptr, const std::string& snap_path = std::string(),
+                            TaskScheduler* decode_scheduler = nullptr);
+    ~VectorDatabase();
 
     // 插入或更新向量
-    void Upsert(uint64_t id, const rapidjson::Document& data, IndexFactory::IndexType index_type);
+    // log_id 为产生这次写入的日志 id, 与数据一起持久化, 重启回放时据此跳过已落盘的标量
+    void Upsert(uint64_t id, const rapidjson::Document& data, IndexFactory::IndexType index_type, uint64_t log_id = 0);
+    // 一条 raft 日志携带的一批写入, 按顺序应用到索引, 标量在同一个 WriteBatch 中写入 RocksDB
+    void UpsertBatch(const std::vector<UpsertRecord>& records, uint64_t log_id);
+    // 把 JSON 写请求转换成 UpsertRecord, vectors 不是数值数组时抛出 std::runtime_error
+    static auto MakeUpsertRecord(uint64_t id, const rapidjson::Document& data, IndexFactory::IndexType index_type)
+        -> UpsertRecord;
     auto Query(uint64_t id) -> rapidjson::Document; // 添加query接口
+    auto MultiQuery(const std::vector<uint64_t>& ids, const std::vector<std::string>& fields = {})
+        -> std::vector<rapidjson::Document>;
     auto Search(const rapidjson::Document& json_request) -> std::pair<std::vector<int64_t>, std::vector<float>>;
+    // 返回与查询距离不超过 radius 的所有向量(按距离升序, 最多 maxResults 个)
+    auto RangeSearch(const rapidjson::Document& json_request) -> std::pair<std::vector<int64_t>, std::vector<float>>;
     void ReloadDatabase(); // 添加 reloadDatabase 方法声明
-    void WriteWalLog(const std::string& operation_type, const rapidjson::Document& json_data); // 添加 writeWALLog 方法声明
-    void WriteWalLogWithId(uint64_t log_id, const std::string& data);
-    auto GetIndexTypeFromRequest(const rapidjson::Document& json_request) -> vectordb::IndexFactory::IndexType; 
+    // 向量维数与目标索引和向量存储一致时返回 true, 否则在 error 中给出原因;
+    // leader 据此拒绝写入, 维数不对的记录不会进入 raft 日志
+    auto CheckDimension(const UpsertRecord& record, std::string* error) -> bool;
+    static auto GetIndexTypeFromRequest(const rapidjson::Document& json_request) -> vectordb::IndexFactory::IndexType;
     void TakeSnapshot();
+    // 生成 raft 快照分两步: 提交线程上把 log_id 时的 RocksDB checkpoint 导出到 dir,
+    // 之后在后台线程保存索引并把索引文件导出到 dir
+    void PrepareSnapshot(const std::string& dir, uint64_t log_id);
+    void CreateSnapshot(const std::string& dir);
+    // 安装 leader 发来的 raft 快照, 替换全部本地数据
+    void InstallSnapshot(const std::string& dir, uint64_t log_id);
     auto GetStartIndexId() const -> int64_t; // 添加 getStartIndexID 函数声明
+    auto StorageStats() -> std::vector<std::pair<std::string, std::string>>;
+    auto Indexes() const -> IndexFactory* { return index_factory_; }
+    auto SnapPath() const -> const std::string& { return snap_path_; }
 private:
+    void WarmUpIdDirectory(); // 启动时扫描 RocksDB 重建 id 目录, 并以 RocksDB 为准修复向量存储中缺失、过期或多余的向量
+    // 让向量存储中 id 的向量与 RocksDB 中的记录 data 一致, 有改动时返回 true
+    auto RepairStoredVector(uint64_t id, const rapidjson::Document& data, std::vector<float>* buffer) -> bool;
+    // 向量存储 msync 成功后在 RocksDB 中推进刷盘水位
+    void FlushVectorStore();
+    void RemoveFromIndex(uint64_t id, IndexFactory::IndexType index_type);
+    // Upsert 中除 RocksDB 写入以外的部分: ANN 索引、过滤位图、id 目录和向量存储
+    void ApplyToIndexes(const UpsertRecord& record, bool recommitted);
+    // 把 id 从两种 ANN 索引和所有过滤位图中移除, 不依赖 id 目录中的旧值
+    void DetachFromIndexes(uint64_t id);
+    // 应用一批回放的 WAL 记录, 记录的 id 互不相同; log_id 不超过 applied_log_id 的记录只重建内存索引.
+    // 返回重新写入 RocksDB 的记录数
+    auto ApplyReplayBatch(std::vector<WalReplayRecord>* records, uint64_t applied_log_id) -> size_t;
+    // 根据请求中的 filter 参数生成位图, 没有 filter 时返回 nullptr, 调用方负责释放
+    auto BuildFilterBitmap(const rapidjson::Document& json_request) -> roaring_bitmap_t*;
+    // 用全精度向量重算 k * refine_factor 个候选的距离, 返回真实的前 k 个; inner_product 时按内积降序
+    auto Refine(const std::vector<float>& query, int k, bool inner_product,
+                const std::pair<std::vector<int64_t>, std::vector<float>>& candidates)
+        -> std::pair<std::vector<int64_t>, std::vector<float>>;
+
     ScalarStorage scalar_storage_;
+    IdDirectory id_directory_; // 写路径只查内存目录, 不再回读 RocksDB
+    VectorStore vector_store_; // mmap 的全精度向量存储, 放在与 RocksDB 同级的目录下
+    IndexFactory* index_factory_; // 本数据库的 ANN 和过滤索引
+    std::string snap_path_; // 索引快照和 raft 快照所在的目录
     Persistence persistence_; // 添加 Persistence 对象
+    uint64_t recovered_log_id_ = 0; // 启动时 RocksDB 中已应用的最大日志 id, 不超过它的日志重新提交时不再写 RocksDB
 };
 }  // namespace vectordb
\ No newline at end of file
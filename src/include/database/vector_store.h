@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace vectordb {
+
+// 列式、mmap 的全精度向量存储, 与 ANN 索引解耦:
+//   <path>.data  每个槽位固定 dim 个 float32, 槽位 i 从 i * dim 开始, 可以直接交给 faiss 的批量距离计算
+//   <path>.meta  文件头 + 每个槽位的 (id, seq, state)
+// 写入只追加到空闲槽位, 更新时先写新槽位再释放旧槽位, 进程崩溃不会留下写了一半的存活向量;
+// 打开时扫描 meta 重建 id -> 槽位映射和空闲链表, 同一 id 有多个存活槽位时保留 seq 最大的.
+// 写入不逐条 msync, 只是 RocksDB vectors CF 的可重建副本; VectorDatabase 在 RocksDB 中记录刷盘水位,
+// 启动时只修复水位之后写入的 id
+class VectorStore {
+public:
+    explicit VectorStore(const std::string& path);
+    ~VectorStore();
+
+    // 写入 id 的向量, 维度以第一次写入为准
+    void Put(uint64_t id, const std::vector<float>& vector);
+    void Remove(uint64_t id);
+    auto Get(uint64_t id, std::vector<float>* vector) const -> bool;
+    auto Contains(uint64_t id) const -> bool;
+    auto Dim() const -> size_t;
+    auto Size() const -> size_t;
+    // 所有存活的 id, 用于启动时清理 RocksDB 中已经不存在的向量
+    auto Ids() const -> std::vector<uint64_t>;
+
+    // 批量计算 query 与若干 id 的精确 L2 平方距离, 不存在的 id 距离为 +inf
+    void ComputeL2(const float* query, const std::vector<int64_t>& ids, std::vector<float>* distances) const;
+    // 同上, 计算内积, 不存在的 id 为 -inf
+    void ComputeInnerProduct(const float* query, const std::vector<int64_t>& ids, std::vector<float>* products) const;
+    // 把脏页刷到磁盘, 失败时返回 false
+    auto Flush() -> bool;
+
+    static constexpr uint32_t SLOT_NEVER_USED = 0;
+    static constexpr uint32_t SLOT_LIVE = 1;
+    static constexpr uint32_t SLOT_FREE = 2;
+    static constexpr size_t INITIAL_CAPACITY = 1024;
+
+private:
+    struct FileHeader {
+        char magic_[8];
+        uint32_t dim_;
+        uint32_t version_;
+        uint64_t capacity_;
+    };
+
+    struct SlotMeta {
+        uint64_t id_;
+        uint64_t seq_;
+        uint32_t state_;
+        uint32_t reserved_;
+    };
+
+    void OpenFiles();
+    void CreateFiles(size_t dim);
+    void Grow(size_t capacity);
+    void Unmap();
+    auto MetaAt(size_t slot) const -> SlotMeta*;
+    auto DataAt(size_t slot) const -> float*;
+    void ComputeByIdx(const float* query, const std::vector<int64_t>& ids, bool inner_product,
+                      std::vector<float>* results) const;
+
+    std::string data_path_;
+    std::string meta_path_;
+    int data_fd_ = -1;
+    int meta_fd_ = -1;
+    void* data_addr_ = nullptr;
+    void* meta_addr_ = nullptr;
+    size_t data_size_ = 0;
+    size_t meta_size_ = 0;
+
+    size_t dim_ = 0;
+    size_t capacity_ = 0;
+    size_t used_ = 0;  // 从未使用过的第一个槽位
+    uint64_t next_seq_ = 1;
+    std::unordered_map<uint64_t, uint32_t> id_to_slot_;
+    std::vector<uint32_t> free_slots_;
+
+    // 查询持共享锁; 写入和扩容(重新映射)持独占锁
+    mutable std::shared_mutex mutex_;
+};
+
+}  // namespace vectordb
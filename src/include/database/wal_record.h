@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vectordb {
+
+// WAL 二进制格式: 文件以 8 字节魔数开头, 之后是连续的帧
+//   [u32 payload 长度][u32 crc32c][u64 log_id][u8 op][payload]
+// crc 覆盖 log_id、op 和 payload; payload 是 RecordCodec 编码后的请求.
+// op 为 BLOCK 的帧把一批完整的帧 snappy 压缩后整体存放, 用于跨记录的块压缩
+class WalRecord {
+public:
+    enum class Op : uint8_t {
+        UPSERT = 1,
+        BLOCK = 0x80,
+    };
+
+    struct Entry {
+        uint64_t log_id_ = 0;
+        Op op_ = Op::UPSERT;
+        std::string payload_;
+    };
+
+    static constexpr char MAGIC[8] = {'V', 'D', 'B', 'W', 'A', 'L', '0', '1'};
+    static constexpr size_t HEADER_SIZE = sizeof(uint32_t) * 2 + sizeof(uint64_t) + sizeof(uint8_t);
+    // 超过这个长度的帧视为损坏, 避免读到坏的长度字段时分配巨大内存
+    static constexpr uint32_t MAX_PAYLOAD_SIZE = 256 << 20;
+
+    static auto Encode(uint64_t log_id, Op op, std::string_view payload) -> std::string;
+    // 把若干条已编码的帧压缩成一个 BLOCK 帧
+    static auto EncodeBlock(const std::vector<std::string>& frames) -> std::string;
+
+    static auto OpName(Op op) -> std::string;
+    static auto ParseOp(const std::string& name, Op* op) -> bool;
+};
+
+// WAL 目录中的一个段文件. 正在写入的段命名为 wal_<seq>.log,
+// 写满后改名为 wal_<seq>_<min_log_id>_<max_log_id>.log, 不打开文件就能知道段内日志 id 的范围
+struct WalSegment {
+    uint64_t seq_ = 0;
+    uint64_t min_log_id_ = 0;
+    uint64_t max_log_id_ = 0;
+    bool sealed_ = false;
+    std::string path_;
+
+    static auto ActiveName(uint64_t seq) -> std::string;
+    static auto SealedName(uint64_t seq, uint64_t min_log_id, uint64_t max_log_id) -> std::string;
+    static auto Parse(const std::string& dir, const std::string& file_name, WalSegment* segment) -> bool;
+    // 按 seq 升序列出目录中的所有段
+    static auto List(const std::string& dir) -> std::vector<WalSegment>;
+    // 删除所有 max_log_id <= log_id 的已封存段, 返回删除的个数; 正在写入的段不会被删除
+    static auto Purge(const std::string& dir, uint64_t log_id) -> size_t;
+};
+
+// 顺序读取 WAL 文件, BLOCK 帧会被展开成其中的记录.
+// 遇到不完整或校验失败的帧时停止, ValidOffset() 给出最后一个完整帧的结束位置, 供截断残尾使用
+class WalReader {
+public:
+    explicit WalReader(const std::string& path);
+
+    auto IsOpen() const -> bool { return file_.is_open(); }
+    // 文件非空但不以魔数开头(旧的按行格式)
+    auto IsLegacy() const -> bool { return legacy_; }
+    auto Next(WalRecord::Entry* entry) -> bool;
+    auto ValidOffset() const -> uint64_t { return valid_offset_; }
+    // 是否因为损坏(而不是正常读到文件末尾)停止
+    auto Corrupted() const -> bool { return corrupted_; }
+
+private:
+    auto ReadFrame(WalRecord::Entry* entry) -> bool;
+    auto ExpandBlock(const std::string& compressed) -> bool;
+
+    std::ifstream file_;
+    bool legacy_ = false;
+    bool corrupted_ = false;
+    uint64_t valid_offset_ = 0;
+    // 当前 BLOCK 解压后尚未读取的记录
+    std::vector<WalRecord::Entry> block_entries_;
+    size_t block_pos_ = 0;
+};
+
+}  // namespace vectordb
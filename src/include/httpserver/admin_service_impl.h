@@ -2,6 +2,7 @@
 #include <rapidjson/document.h>
 #include <string>
 #include "brpc/stream.h"
+#include "cluster/raft_group_manager.h"
 #include "cluster/raft_stuff.h"
 #include "database/vector_database.h"
 #include "http.pb.h"
@@ -14,8 +15,8 @@ namespace vectordb {
 
 class AdminServiceImpl : public nvm::AdminService, public BaseServiceImpl {
  public:
-  explicit AdminServiceImpl(VectorDatabase *database, RaftStuff *raft_stuff)
-      : vector_database_(database), raft_stuff_(raft_stuff){};
+  // 管理请求按 groupId 作用于其中一个 raft 组, 缺省为组 0
+  explicit AdminServiceImpl(RaftGroupManager *groups) : groups_(groups){};
   ~AdminServiceImpl() override = default;
 
   void snapshot(::google::protobuf::RpcController *controller, const ::nvm::HttpRequest * /*request*/,
@@ -29,9 +30,13 @@ class AdminServiceImpl : public nvm::AdminService, public BaseServiceImpl {
                 ::nvm::HttpResponse * /*response*/, ::google::protobuf::Closure *done) override;
   void GetNode(::google::protobuf::RpcController *controller, const ::nvm::HttpRequest * /*request*/,
                ::nvm::HttpResponse * /*response*/, ::google::protobuf::Closure *done) override;
+  void StorageStats(::google::protobuf::RpcController *controller, const ::nvm::HttpRequest * /*request*/,
+                    ::nvm::HttpResponse * /*response*/, ::google::protobuf::Closure *done) override;
+  // follower 做一致性读前向 leader 请求 read index
+  void ReadIndex(::google::protobuf::RpcController *controller, const ::nvm::HttpRequest * /*request*/,
+                 ::nvm::HttpResponse * /*response*/, ::google::protobuf::Closure *done) override;
 
  private:
-  VectorDatabase *vector_database_ = nullptr;
-  RaftStuff *raft_stuff_ = nullptr;
+  RaftGroupManager *groups_ = nullptr;
 };
 }  // namespace vectordb
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <string>
 #include "brpc/controller.h"
 #include "brpc/stream.h"
+#include "cluster/raft_group_manager.h"
 #include "common/constants.h"
 #include "database/vector_database.h"
 #include "http.pb.h"
@@ -14,7 +15,7 @@
 namespace vectordb {
 class BaseServiceImpl {
  public:
-  enum class CheckType { SEARCH, INSERT, UPSERT };
+  enum class CheckType { SEARCH, INSERT, UPSERT, RANGE_SEARCH };
   void SetJsonResponse(const rapidjson::Document &json_response, brpc::Controller *cntl);
   void SetTextResponse(const std::string &response, brpc::Controller *cntl);
   void SetJsonResponse(const std::string &response, brpc::Controller *cntl);
@@ -28,6 +29,11 @@ class BaseServiceImpl {
 
   auto GetIndexTypeFromRequest(const rapidjson::Document &json_request) -> vectordb::IndexFactory::IndexType;
 
+  // 请求所在的 raft 组: 取请求体或 URL 参数中的 groupId, 都没有时为组 0.
+  // 本节点没有承载这个组时写好错误响应并返回 nullptr
+  auto FindGroup(RaftGroupManager *groups, const rapidjson::Document &json_request, brpc::Controller *cntl)
+      -> RaftGroup *;
+
   static auto WriteCallback(void *contents, size_t size, size_t nmemb, void *userp) -> size_t ;
 };
 
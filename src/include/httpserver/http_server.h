@@ -3,6 +3,7 @@
 #include "httplib/httplib.h"
 #include "index/index_factory.h"
 #include "database/vector_database.h"
+#include "cluster/raft_group_manager.h"
 #include "httpserver/admin_service_impl.h"
 #include "httpserver/user_service_impl.h"
 #include <rapidjson/document.h>
@@ -13,12 +14,12 @@ namespace vectordb {
 
 class HttpServer: public brpc::Server {
 public:
-   auto Init(VectorDatabase *vector_database,RaftStuff *raft_stuff) -> bool;
+   // 所有 raft 组共用同一个 HTTP 端口, 请求按 groupId 分派
+   auto Init(RaftGroupManager *raft_groups) -> bool;
 
 private:
 
-    VectorDatabase* vector_database_;
-    RaftStuff *raft_stuff_;
+    RaftGroupManager *raft_groups_;
     std::unique_ptr<UserServiceImpl> user_service_impl_;
     std::unique_ptr<AdminServiceImpl> admin_service_impl_;
 };
@@ -7,6 +7,7 @@
 #include <utility>
 #include "brpc/stream.h"
 #include "cluster/raft_stuff.h"
+#include "common/constants.h"
 #include "database/vector_database.h"
 #include "gmock/gmock.h"
 #include "http.pb.h"
@@ -15,7 +16,8 @@
 #include "index/index_factory.h"
 namespace vectordb {
 
-enum class ServerRole { Master, Backup };
+// 取值与节点信息中的 NODE_ROLE_* 一致
+enum class ServerRole { Master = NODE_ROLE_LEADER, Backup = NODE_ROLE_FOLLOWER, Learner = NODE_ROLE_LEARNER };
 
 struct ServerInfo {
   std::string url_;
@@ -17,7 +17,7 @@ namespace vectordb {
 struct NodeInfo {
   uint64_t node_id_;
   std::string url_;
-  int role_;  // 例如，0 表示主节点，1 表示从节点
+  int role_;  // NODE_ROLE_LEADER / NODE_ROLE_FOLLOWER / NODE_ROLE_LEARNER
 };
 
 struct NodePartitionInfo {
@@ -2,6 +2,7 @@
 #include <rapidjson/document.h>
 #include <string>
 #include "brpc/stream.h"
+#include "cluster/raft_group_manager.h"
 #include "cluster/raft_stuff.h"
 #include "database/vector_database.h"
 #include "http.pb.h"
@@ -14,8 +15,7 @@ namespace vectordb {
 
 class UserServiceImpl : public nvm::UserService, public BaseServiceImpl {
  public:
-  explicit UserServiceImpl(VectorDatabase *database, RaftStuff *raft_stuff)
-      : vector_database_(database), raft_stuff_(raft_stuff){};
+  explicit UserServiceImpl(RaftGroupManager *groups) : groups_(groups){};
   ~UserServiceImpl() override = default;
 
   void search(::google::protobuf::RpcController *controller, const ::nvm::HttpRequest * /*request*/,
@@ -30,8 +30,19 @@ class UserServiceImpl : public nvm::UserService, public BaseServiceImpl {
   void query(::google::protobuf::RpcController *controller, const ::nvm::HttpRequest * /*request*/,
              ::nvm::HttpResponse * /*response*/, ::google::protobuf::Closure *done) override;
 
+  void rangeSearch(::google::protobuf::RpcController *controller, const ::nvm::HttpRequest * /*request*/,
+                   ::nvm::HttpResponse * /*response*/, ::google::protobuf::Closure *done) override;
+
+  void batchQuery(::google::protobuf::RpcController *controller, const ::nvm::HttpRequest * /*request*/,
+                  ::nvm::HttpResponse * /*response*/, ::google::protobuf::Closure *done) override;
+
  private:
-  VectorDatabase *vector_database_ = nullptr;
-  RaftStuff *raft_stuff_ = nullptr;
+  // 按请求中的 consistency 参数等本地数据追上 leader, 失败时已经写好错误响应
+  auto PrepareRead(RaftStuff *raft_stuff, const rapidjson::Document &json_request, brpc::Controller *cntl) -> bool;
+  // raft 错误按原因映射成 HTTP 状态码: 不是 leader 503, 超时 504, 其他 500
+  void SetRaftErrorResponse(RaftStuff *raft_stuff, brpc::Controller *cntl, nuraft::cmd_result_code code,
+                            std::string error);
+
+  RaftGroupManager *groups_ = nullptr;
 };
 }  // namespace vectordb
\ No newline at end of file
@@ -3,8 +3,15 @@
 #include <faiss/impl/IDSelector.h>
 #include "faiss/Index.h"
 #include <faiss/utils/utils.h>
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
 #include <vector>
+#include "common/task_scheduler.h"
 #include "roaring/roaring.h"
 namespace vectordb {
 
@@ -18,15 +25,68 @@ struct RoaringBitmapIDSelector : faiss::IDSelector {
 
     const roaring_bitmap_t* bitmap_;
 };
-class FaissIndex {
+
+// 作用于底层 flat 索引的行号: 跳过已删除的行, 并按外部 id 应用过滤位图
+struct TombstoneIDSelector : faiss::IDSelector {
+    TombstoneIDSelector(const roaring_bitmap_t* deleted_rows, const roaring_bitmap_t* filter, const int64_t* id_map)
+        : deleted_rows_(deleted_rows), filter_(filter), id_map_(id_map) {}
+
+    auto is_member(int64_t row) const -> bool final;
+
+    ~TombstoneIDSelector() override = default;
+
+    const roaring_bitmap_t* deleted_rows_;
+    const roaring_bitmap_t* filter_;
+    const int64_t* id_map_;
+};
+
+class FaissIndex : public ScheduledTask {
 public:
-    explicit FaissIndex(faiss::Index* index); 
+    // scheduler 不为空时墓碑检查在共用的线程池上定期运行, 否则自己开一个压缩线程
+    explicit FaissIndex(faiss::Index* index, TaskScheduler* scheduler = nullptr);
+    ~FaissIndex() override;
     void InsertVectors(const std::vector<float>& data, int64_t label);
+    // 一次 add_with_ids 插入多个向量, data 为按行拼接的向量, labels 内不能有重复
+    void InsertVectorsBatch(const std::vector<float>& data, const std::vector<int64_t>& labels);
     auto SearchVectors(const std::vector<float>& query, int k, const roaring_bitmap_t* bitmap = nullptr) -> std::pair<std::vector<int64_t>, std::vector<float>>;
+    // 返回距离不超过 radius 的向量, 按距离升序截断到 max_results 个
+    auto RangeSearchVectors(const std::vector<float>& query, float radius, size_t max_results,
+                            const roaring_bitmap_t* bitmap = nullptr) -> std::pair<std::vector<int64_t>, std::vector<float>>;
+    // 只标记墓碑, 物理删除由后台 Compact 批量完成
     void RemoveVectors(const std::vector<int64_t>& ids);
+    void Compact();
+    // 共用线程池定期调用: 墓碑够多时压缩, 然后安排下一次检查
+    void RunScheduled() override;
+    auto DeletedCount() const -> uint64_t;
+    auto Dim() const -> int;
+    // 距离类型; METRIC_INNER_PRODUCT 时结果按内积降序
+    auto Metric() const -> faiss::MetricType;
     void SaveIndex(const std::string& file_path); // 添加 saveIndex 方法声明
     void LoadIndex(const std::string& file_path); // 将返回类型更改为 faiss::Index*
+
+    // 墓碑占比超过阈值时触发物理删除
+    static constexpr double COMPACT_DELETED_RATIO = 0.1;
+    static constexpr uint64_t COMPACT_MIN_DELETED = 1024;
+    static constexpr int COMPACT_CHECK_INTERVAL_SEC = 10;
+    // SaveIndex 在共享锁下写文件前最多压缩几次
+    static constexpr int SAVE_COMPACT_RETRIES = 3;
+
 private:
+    void RebuildRowMap();
+    void DoCompact();
+    void CompactLoop();
+    void MaybeCompact();
+
     faiss::Index* index_;
+    // 外部 id -> 底层 flat 索引中的行号, 只包含存活的行
+    std::unordered_map<int64_t, int64_t> id_to_row_;
+    roaring_bitmap_t* deleted_rows_;
+    mutable std::shared_mutex mutex_;
+
+    TaskScheduler* scheduler_;
+    std::atomic<bool> stop_compactor_{false};
+    std::mutex compactor_mutex_;
+    std::condition_variable compactor_cv_;
+    std::thread compactor_thread_;
 };
 }  // namespace vectordb
@@ -21,6 +21,8 @@ public:
     FilterIndex();
     void AddIntFieldFilter(const std::string& fieldname, int64_t value, uint64_t id);
     void UpdateIntFieldFilter(const std::string& fieldname, int64_t* old_value, int64_t new_value, uint64_t id); // 将 old_value 参数更改为指针类型
+    // 把 ids 中的 id 从所有字段的位图中移除
+    void RemoveIds(const roaring_bitmap_t* ids);
     void GetIntFieldFilterBitmap(const std::string& fieldname, Operation op, int64_t value, roaring_bitmap_t* result_bitmap); // 添加 result_bitmap 参数
     auto SerializeIntFieldFilter() -> std::string; // 添加 serializeIntFieldFilter 方法声明
     void DeserializeIntFieldFilter(const std::string& serialized_data); // 添加 deserializeIntFieldFilter 方法声明
@@ -1,25 +1,47 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
 #include <vector>
+#include "common/task_scheduler.h"
 #include "hnswlib/hnswlib.h"
 #include "index_factory.h"
 namespace vectordb {
-class HNSWLibIndex {
+class HNSWLibIndex : public ScheduledTask {
 public:
-    // 构造函数
-    HNSWLibIndex(int dim, int num_data, IndexFactory::MetricType metric, int M = 16, int ef_construction = 200); // 将MetricType参数修改为第三个参数
+    // 构造函数; scheduler 不为空时重建检查在共用的线程池上定期运行, 否则自己开一个后台线程
+    HNSWLibIndex(int dim, int num_data, IndexFactory::MetricType metric, int M = 16, int ef_construction = 200,
+                 TaskScheduler* scheduler = nullptr); // 将MetricType参数修改为第三个参数
+    ~HNSWLibIndex() override;
 
     // 插入向量
     void InsertVectors(const std::vector<float>& data, int64_t label);
+    // 批量插入, 按块并行调用 addPoint; labels 内不能有重复
+    void InsertVectorsBatch(const std::vector<float>& data, const std::vector<int64_t>& labels);
 
     // 查询向量
     auto SearchVectors(const std::vector<float>& query, int k, const roaring_bitmap_t* bitmap = nullptr,int ef_search = 50) -> std::pair<std::vector<int64_t>, std::vector<float>>;
 
+    // 从入口点做有界的 best-first 扩展, 返回距离不超过 radius 的向量(最多 max_results 个)
+    auto RangeSearchVectors(const std::vector<float>& query, float radius, size_t max_results,
+                            const roaring_bitmap_t* bitmap = nullptr, int ef_search = 50) -> std::pair<std::vector<int64_t>, std::vector<float>>;
+
     void RemoveVectors(const std::vector<int64_t>& ids);
 
     void SaveIndex(const std::string& file_path); // 添加 saveIndex 方法声明
     void LoadIndex(const std::string& file_path); // 添加 loadIndex 方法声明
 
+    // 用存活向量重建图并原子替换, 回收 markDelete 留下的墓碑
+    void Compact();
+    // 共用线程池定期调用: 墓碑够多时重建, 然后安排下一次检查
+    void RunScheduled() override;
+    auto DeletedRatio() const -> double;
+    auto Dim() const -> int { return dim_; }
+
         // 定义 RoaringBitmapIDFilter 类
     class RoaringBitmapIDFilter : public hnswlib::BaseFilterFunctor {
     public:
@@ -32,12 +54,48 @@ public:
     private:
         const roaring_bitmap_t* bitmap_;
     };
-    
+
+    // 墓碑占比超过该阈值时后台线程触发重建
+    static constexpr size_t INSERT_BATCH_CHUNK = 256; // 每个插入线程至少处理的向量数
+    static constexpr double COMPACT_DELETED_RATIO = 0.3;
+    // 墓碑数太少时重建不划算
+    static constexpr size_t COMPACT_MIN_DELETED = 1024;
+    static constexpr int COMPACT_CHECK_INTERVAL_SEC = 10;
+
 private:
-    // int dim_;
+    // 重建期间的写操作, 在替换前重放到新图上
+    struct PendingOp {
+        bool remove_;
+        int64_t label_;
+        std::vector<float> data_;
+    };
+
+    void DoInsert(hnswlib::HierarchicalNSW<float>* index, const float* data, int64_t label);
+    void DoRemove(hnswlib::HierarchicalNSW<float>* index, int64_t label);
+    void CompactLoop();
+    void MaybeCompact();
+
+    int dim_;
+    int m_;
+    int ef_construction_;
     hnswlib::SpaceInterface<float>* space_;
     hnswlib::HierarchicalNSW<float>* index_;
     size_t max_elements_; // 添加 max_elements 成员变量
+
+    // 保护 index_ 指针本身: 查询/写入持共享锁, 扩容和替换持独占锁(很短)
+    mutable std::shared_mutex index_mutex_;
+    // 串行化写操作, 并保证重建期间的写入都被记录到 pending_ops_
+    std::mutex write_mutex_;
+    bool compacting_ = false;
+    std::vector<PendingOp> pending_ops_;
+    // LoadIndex 时加一, 重建开始后图被整体替换过的话丢弃重建结果
+    uint64_t generation_ = 0;
+
+    TaskScheduler* scheduler_;
+    std::atomic<bool> stop_compactor_{false};
+    std::mutex compactor_mutex_;
+    std::condition_variable compactor_cv_;
+    std::thread compactor_thread_;
 };
 }  // namespace vectordb
 
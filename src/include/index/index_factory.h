@@ -3,6 +3,7 @@
 #include "faiss_index.h"
 #include "faiss/IndexFlat.h"
 #include "faiss/IndexIDMap.h"
+#include "common/task_scheduler.h"
 #include "common/vector_utils.h"
 #include <map>
 
@@ -22,7 +23,15 @@ public:
         IP
     };
 
+    // 全局实例供单组部署和测试使用; 多 raft 组时每个 VectorDatabase 持有自己的 IndexFactory.
+    // compact_scheduler 不为空时索引的后台压缩在这个共用线程池上运行
+    explicit IndexFactory(TaskScheduler* compact_scheduler = nullptr) : compact_scheduler_(compact_scheduler) {}
+    // 按类型删除各个索引, 同时停掉它们的后台压缩
+    ~IndexFactory();
+
     void Init(IndexType type, int dim,  int num_data, MetricType metric = MetricType::L2);
+    // 初始化 FLAT / HNSW / FILTER 三种索引
+    void InitAll(int dim, int num_data, MetricType metric = MetricType::L2);
     auto GetIndex(IndexType type) const -> void*;
      void SaveIndex(const std::string& folder_path); // 添加 ScalarStorage 参数
     void LoadIndex(const std::string& folder_path); // 添加 loadIndex 方法声明
@@ -32,6 +41,7 @@ public:
 private:
 
     std::map<IndexType, void*> index_map_; 
+    TaskScheduler* compact_scheduler_;
 
 };
 
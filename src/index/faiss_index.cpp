@@ -1,5 +1,8 @@
 #include "index/faiss_index.h"
 #include <faiss/IndexIDMap.h>
+#include <faiss/impl/AuxIndexStructures.h>
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
 #include <iostream>
 #include <vector>
@@ -9,15 +12,95 @@
 #include <fstream>
 
 namespace vectordb {
-FaissIndex::FaissIndex(faiss::Index *index) : index_(index) {}
+FaissIndex::FaissIndex(faiss::Index *index, TaskScheduler *scheduler)
+    : index_(index), deleted_rows_(roaring_bitmap_create()), scheduler_(scheduler) {
+  RebuildRowMap();
+  if (scheduler_ != nullptr) {
+    scheduler_->Schedule(this, TaskScheduler::Clock::now() + std::chrono::seconds(COMPACT_CHECK_INTERVAL_SEC));
+  } else {
+    compactor_thread_ = std::thread(&FaissIndex::CompactLoop, this);
+  }
+}
+
+FaissIndex::~FaissIndex() {
+  stop_compactor_ = true;
+  compactor_cv_.notify_all();
+  if (compactor_thread_.joinable()) {
+    compactor_thread_.join();
+  }
+  if (scheduler_ != nullptr) {
+    scheduler_->Remove(this);
+  }
+  roaring_bitmap_free(deleted_rows_);
+  delete index_;
+}
 
 auto RoaringBitmapIDSelector::is_member(int64_t id) const -> bool {
   return roaring_bitmap_contains(bitmap_, static_cast<uint32_t>(id));
 }
 
+auto TombstoneIDSelector::is_member(int64_t row) const -> bool {
+  if (roaring_bitmap_contains(deleted_rows_, static_cast<uint32_t>(row))) {
+    return false;
+  }
+  return filter_ == nullptr || roaring_bitmap_contains(filter_, static_cast<uint32_t>(id_map_[row]));
+}
+
+void FaissIndex::RebuildRowMap() {
+  id_to_row_.clear();
+  auto *id_map = dynamic_cast<faiss::IndexIDMap *>(index_);
+  if (id_map == nullptr) {
+    return;
+  }
+  for (size_t row = 0; row < id_map->id_map.size(); ++row) {
+    if (!roaring_bitmap_contains(deleted_rows_, static_cast<uint32_t>(row))) {
+      id_to_row_[id_map->id_map[row]] = static_cast<int64_t>(row);
+    }
+  }
+}
+
 void FaissIndex::InsertVectors(const std::vector<float> &data, int64_t label) {
   auto id = static_cast<int64_t>(label);
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  auto *id_map = dynamic_cast<faiss::IndexIDMap *>(index_);
+  if (id_map == nullptr) {
+    index_->add_with_ids(1, data.data(), &id);
+    return;
+  }
+
+  // 同一个 id 重复插入时旧行直接记为墓碑, 避免出现重复结果
+  auto it = id_to_row_.find(id);
+  if (it != id_to_row_.end()) {
+    roaring_bitmap_add(deleted_rows_, static_cast<uint32_t>(it->second));
+  }
+  int64_t row = id_map->ntotal;
   index_->add_with_ids(1, data.data(), &id);
+  id_to_row_[id] = row;
+}
+
+void FaissIndex::InsertVectorsBatch(const std::vector<float> &data, const std::vector<int64_t> &labels) {
+  if (labels.empty()) {
+    return;
+  }
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  auto n = static_cast<faiss::idx_t>(labels.size());
+  auto *id_map = dynamic_cast<faiss::IndexIDMap *>(index_);
+  if (id_map == nullptr) {
+    index_->add_with_ids(n, data.data(), labels.data());
+    return;
+  }
+
+  for (auto label : labels) {
+    auto it = id_to_row_.find(label);
+    if (it != id_to_row_.end()) {
+      roaring_bitmap_add(deleted_rows_, static_cast<uint32_t>(it->second));
+    }
+  }
+  int64_t first_row = id_map->ntotal;
+  index_->add_with_ids(n, data.data(), labels.data());
+  for (size_t i = 0; i < labels.size(); ++i) {
+    id_to_row_[labels[i]] = first_row + static_cast<int64_t>(i);
+  }
 }
 
 auto FaissIndex::SearchVectors(const std::vector<float> &query, int k, const roaring_bitmap_t *bitmap)
@@ -27,15 +110,31 @@ auto FaissIndex::SearchVectors(const std::vector<float> &query, int k, const roa
   std::vector<int64_t> indices(num_queries * k);
   std::vector<float> distances(num_queries * k);
 
-  // 如果传入了 bitmap 参数，则使用 RoaringBitmapIDSelector 初始化 faiss::SearchParameters 对象
-  faiss::SearchParameters search_params;
-  RoaringBitmapIDSelector selector(bitmap);
-  if (bitmap != nullptr) {
-    search_params.sel = &selector;
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  auto *id_map = dynamic_cast<faiss::IndexIDMap *>(index_);
+  if (id_map == nullptr) {
+    // 如果传入了 bitmap 参数，则使用 RoaringBitmapIDSelector 初始化 faiss::SearchParameters 对象
+    faiss::SearchParameters search_params;
+    RoaringBitmapIDSelector selector(bitmap);
+    if (bitmap != nullptr) {
+      search_params.sel = &selector;
+    }
+    index_->search(num_queries, query.data(), k, distances.data(), indices.data(), &search_params);
+  } else {
+    // 直接搜索底层 flat 索引, 以行号为粒度跳过墓碑, 再把行号翻译回外部 id
+    faiss::SearchParameters search_params;
+    TombstoneIDSelector selector(deleted_rows_, bitmap, id_map->id_map.data());
+    if (bitmap != nullptr || !roaring_bitmap_is_empty(deleted_rows_)) {
+      search_params.sel = &selector;
+    }
+    id_map->index->search(num_queries, query.data(), k, distances.data(), indices.data(), &search_params);
+    for (auto &index : indices) {
+      if (index >= 0) {
+        index = id_map->id_map[index];
+      }
+    }
   }
 
-  index_->search(num_queries, query.data(), k, distances.data(), indices.data(),&search_params);
-
   global_logger->debug("Retrieved values:");
   for (size_t i = 0; i < indices.size(); ++i) {
     if (indices[i] != -1) {
@@ -47,19 +146,161 @@ auto FaissIndex::SearchVectors(const std::vector<float> &query, int k, const roa
   return {indices, distances};
 }
 
-void FaissIndex::RemoveVectors(const std::vector<int64_t> &ids) {  // 添加remove_vectors函数实现
+auto FaissIndex::RangeSearchVectors(const std::vector<float> &query, float radius, size_t max_results,
+                                    const roaring_bitmap_t *bitmap) -> std::pair<std::vector<int64_t>, std::vector<float>> {
+  faiss::RangeSearchResult result(1);
+  std::shared_lock<std::shared_mutex> lock(mutex_);
   auto *id_map = dynamic_cast<faiss::IndexIDMap *>(index_);
-  if (index_ != nullptr) {
-    // 初始化IDSelectorBatch对象
-    faiss::IDSelectorBatch selector(ids.size(), ids.data());
-    auto remove_size = id_map->remove_ids(selector);
-    global_logger->debug("remove size = {}", remove_size);
+  if (id_map == nullptr) {
+    faiss::SearchParameters search_params;
+    RoaringBitmapIDSelector selector(bitmap);
+    if (bitmap != nullptr) {
+      search_params.sel = &selector;
+    }
+    index_->range_search(1, query.data(), radius, &result, &search_params);
   } else {
+    // 与 SearchVectors 一样直接作用于底层 flat 索引, 按行号跳过墓碑
+    faiss::SearchParameters search_params;
+    TombstoneIDSelector selector(deleted_rows_, bitmap, id_map->id_map.data());
+    if (bitmap != nullptr || !roaring_bitmap_is_empty(deleted_rows_)) {
+      search_params.sel = &selector;
+    }
+    id_map->index->range_search(1, query.data(), radius, &result, &search_params);
+    for (size_t i = 0; i < result.lims[1]; ++i) {
+      result.labels[i] = id_map->id_map[result.labels[i]];
+    }
+  }
+
+  // range_search 的结果无序, 按距离排序后截断
+  size_t count = result.lims[1];
+  std::vector<size_t> order(count);
+  for (size_t i = 0; i < count; ++i) {
+    order[i] = i;
+  }
+  size_t top = std::min(count, max_results);
+  std::partial_sort(order.begin(), order.begin() + static_cast<int64_t>(top), order.end(),
+                    [&result](size_t a, size_t b) { return result.distances[a] < result.distances[b]; });
+
+  std::vector<int64_t> indices(top);
+  std::vector<float> distances(top);
+  for (size_t i = 0; i < top; ++i) {
+    indices[i] = result.labels[order[i]];
+    distances[i] = result.distances[order[i]];
+  }
+  global_logger->debug("Faiss range search found {} vectors within {}, returned {}", count, radius, top);
+  return {indices, distances};
+}
+
+void FaissIndex::RemoveVectors(const std::vector<int64_t> &ids) {  // 添加remove_vectors函数实现
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  auto *id_map = dynamic_cast<faiss::IndexIDMap *>(index_);
+  if (id_map == nullptr) {
     throw std::runtime_error("Underlying Faiss index is not an IndexIDMap");
   }
+  for (const auto &id : ids) {
+    auto it = id_to_row_.find(id);
+    if (it == id_to_row_.end()) {
+      continue;
+    }
+    roaring_bitmap_add(deleted_rows_, static_cast<uint32_t>(it->second));
+    id_to_row_.erase(it);
+  }
+  global_logger->debug("remove size = {}, pending tombstones = {}", ids.size(),
+                       roaring_bitmap_get_cardinality(deleted_rows_));
+}
+
+auto FaissIndex::DeletedCount() const -> uint64_t {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  return roaring_bitmap_get_cardinality(deleted_rows_);
+}
+
+auto FaissIndex::Dim() const -> int {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  return index_->d;
+}
+
+auto FaissIndex::Metric() const -> faiss::MetricType {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  return index_->metric_type;
+}
+
+void FaissIndex::DoCompact() {
+  auto *id_map = dynamic_cast<faiss::IndexIDMap *>(index_);
+  if (id_map == nullptr || roaring_bitmap_is_empty(deleted_rows_)) {
+    return;
+  }
+
+  // 一次性搬移底层 flat 数据, 再同步压缩 id_map
+  RoaringBitmapIDSelector row_selector(deleted_rows_);
+  size_t removed = id_map->index->remove_ids(row_selector);
+
+  size_t j = 0;
+  for (size_t row = 0; row < id_map->id_map.size(); ++row) {
+    if (!roaring_bitmap_contains(deleted_rows_, static_cast<uint32_t>(row))) {
+      id_map->id_map[j++] = id_map->id_map[row];
+    }
+  }
+  id_map->id_map.resize(j);
+  id_map->ntotal = static_cast<faiss::idx_t>(j);
+
+  roaring_bitmap_clear(deleted_rows_);
+  RebuildRowMap();
+  global_logger->info("Faiss compaction removed {} rows, {} rows left", removed, j);
+}
+
+void FaissIndex::Compact() {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  DoCompact();
+}
+
+void FaissIndex::CompactLoop() {
+  std::unique_lock<std::mutex> lock(compactor_mutex_);
+  while (!stop_compactor_) {
+    compactor_cv_.wait_for(lock, std::chrono::seconds(COMPACT_CHECK_INTERVAL_SEC),
+                           [this] { return stop_compactor_.load(); });
+    if (stop_compactor_) {
+      break;
+    }
+    MaybeCompact();
+  }
+}
+
+void FaissIndex::RunScheduled() {
+  MaybeCompact();
+  if (!stop_compactor_) {
+    scheduler_->Schedule(this, TaskScheduler::Clock::now() + std::chrono::seconds(COMPACT_CHECK_INTERVAL_SEC));
+  }
+}
+
+void FaissIndex::MaybeCompact() {
+  uint64_t deleted = 0;
+  uint64_t total = 0;
+  {
+    std::shared_lock<std::shared_mutex> index_lock(mutex_);
+    deleted = roaring_bitmap_get_cardinality(deleted_rows_);
+    total = index_->ntotal;
+  }
+  if (deleted >= COMPACT_MIN_DELETED && static_cast<double>(deleted) >= COMPACT_DELETED_RATIO * total) {
+    Compact();
+  }
 }
 
 void FaissIndex::SaveIndex(const std::string& file_path) { // 添加 saveIndex 方法实现
+    // 落盘前先做物理删除, 否则加载后墓碑会重新出现. 只在压缩时持有独占锁, 写文件时持有共享锁,
+    // 写文件期间查询不受阻塞; 两次加锁之间又有删除时重新压缩, 多次仍有新墓碑时整个过程持有独占锁
+    for (int attempt = 0; attempt < SAVE_COMPACT_RETRIES; ++attempt) {
+        {
+            std::unique_lock<std::shared_mutex> lock(mutex_);
+            DoCompact();
+        }
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        if (roaring_bitmap_is_empty(deleted_rows_)) {
+            faiss::write_index(index_, file_path.c_str());
+            return;
+        }
+    }
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    DoCompact();
     faiss::write_index(index_, file_path.c_str());
 }
 
@@ -67,11 +308,16 @@ void FaissIndex::LoadIndex(const std::string& file_path) { // 添加 loadIndex 
     std::ifstream file(file_path); // 尝试打开文件
     if (file.good()) { // 检查文件是否存在
         file.close();
+        // Compact 全程持有同一把独占锁, 加载不会与进行中的压缩交错;
+        // 之后的压缩看到清空的墓碑位图, 不会改动加载的数据
+        std::unique_lock<std::shared_mutex> lock(mutex_);
         delete index_;
         index_ = faiss::read_index(file_path.c_str());
+        roaring_bitmap_clear(deleted_rows_);
+        RebuildRowMap();
     } else {
         global_logger->warn("File not found: {}. Skipping loading index.", file_path);
     }
 }
 
-}  // namespace vectordb
\ No newline at end of file
+}  // namespace vectordb
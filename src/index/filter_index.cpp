@@ -55,6 +55,14 @@ void FilterIndex::UpdateIntFieldFilter(const std::string &fieldname, int64_t *ol
   }
 }
 
+void FilterIndex::RemoveIds(const roaring_bitmap_t *ids) {
+  for (auto &[fieldname, value_map] : int_field_filter_) {
+    for (auto &[value, bitmap] : value_map) {
+      roaring_bitmap_andnot_inplace(bitmap, ids);
+    }
+  }
+}
+
 void FilterIndex::GetIntFieldFilterBitmap(const std::string &fieldname, Operation op, int64_t value,
                                           roaring_bitmap_t *result_bitmap) {  // 添加 result_bitmap 参数
   auto it = int_field_filter_.find(fieldname);
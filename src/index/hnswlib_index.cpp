@@ -1,10 +1,17 @@
 #include "index/hnswlib_index.h"
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
+#include <future>
+#include <memory>
+#include <thread>
 #include <vector>
 #include "logger/logger.h"
 namespace vectordb {
 
-HNSWLibIndex::HNSWLibIndex(int dim, int num_data, IndexFactory::MetricType metric, int M, int ef_construction):max_elements_(num_data)
+HNSWLibIndex::HNSWLibIndex(int dim, int num_data, IndexFactory::MetricType metric, int M, int ef_construction,
+                           TaskScheduler* scheduler)
+    : dim_(dim), m_(M), ef_construction_(ef_construction), max_elements_(num_data), scheduler_(scheduler)
 { // 将MetricType参数修改为第三个参数
     // bool normalize = false;
     if (metric == IndexFactory::MetricType::L2) {
@@ -12,25 +19,145 @@ HNSWLibIndex::HNSWLibIndex(int dim, int num_data, IndexFactory::MetricType metri
     } else {
         throw std::runtime_error("Invalid metric type.");
     }
-    index_ = new hnswlib::HierarchicalNSW<float>(space_, num_data, M, ef_construction);
+    // 开启 allow_replace_deleted, 新插入的向量可以复用被 markDelete 的槽位
+    index_ = new hnswlib::HierarchicalNSW<float>(space_, num_data, M, ef_construction, 100, true);
+    if (scheduler_ != nullptr) {
+        scheduler_->Schedule(this, TaskScheduler::Clock::now() + std::chrono::seconds(COMPACT_CHECK_INTERVAL_SEC));
+    } else {
+        compactor_thread_ = std::thread(&HNSWLibIndex::CompactLoop, this);
+    }
+}
+
+HNSWLibIndex::~HNSWLibIndex() {
+    stop_compactor_ = true;
+    compactor_cv_.notify_all();
+    if (compactor_thread_.joinable()) {
+        compactor_thread_.join();
+    }
+    if (scheduler_ != nullptr) {
+        scheduler_->Remove(this);
+    }
+    delete index_;
+    delete space_;
+}
+
+void HNSWLibIndex::DoInsert(hnswlib::HierarchicalNSW<float>* index, const float* data, int64_t label) {
+    auto external = static_cast<hnswlib::labeltype>(label);
+    bool exists = false;
+    bool deleted = false;
+    {
+        std::lock_guard<std::mutex> lock_table(index->label_lookup_lock);
+        auto it = index->label_lookup_.find(external);
+        if (it != index->label_lookup_.end()) {
+            exists = true;
+            deleted = index->isMarkedDeleted(it->second);
+        }
+    }
+
+    if (exists) {
+        // upsert 会先 markDelete 再插入同一个 id, 这里直接恢复原槽位并原地更新, 不产生新的墓碑
+        if (deleted) {
+            index->unmarkDelete(external);
+        }
+        index->addPoint(data, external, false);
+        return;
+    }
+    // 新 id 优先复用已删除的槽位
+    index->addPoint(data, external, true);
+}
+
+void HNSWLibIndex::DoRemove(hnswlib::HierarchicalNSW<float>* index, int64_t label) {
+    auto external = static_cast<hnswlib::labeltype>(label);
+    {
+        std::lock_guard<std::mutex> lock_table(index->label_lookup_lock);
+        auto it = index->label_lookup_.find(external);
+        if (it == index->label_lookup_.end() || index->isMarkedDeleted(it->second)) {
+            return;
+        }
+    }
+    index->markDelete(external);
 }
 
 void HNSWLibIndex::InsertVectors(const std::vector<float>& data, int64_t label) {
     assert(index_ != nullptr);
-    index_->addPoint(data.data(), label);
+    std::lock_guard<std::mutex> write_lock(write_mutex_);
+
+    // 没有可复用的槽位且容量已满时扩容, 扩容会重新分配内存, 需要独占
+    if (index_->getDeletedCount() == 0 && index_->getCurrentElementCount() >= index_->getMaxElements()) {
+        std::unique_lock<std::shared_mutex> lock(index_mutex_);
+        max_elements_ = std::max<size_t>(max_elements_ * 2, 1);
+        index_->resizeIndex(max_elements_);
+        global_logger->info("HNSW index resized to {}", max_elements_);
+    }
+
+    {
+        std::shared_lock<std::shared_mutex> lock(index_mutex_);
+        DoInsert(index_, data.data(), label);
+    }
+    if (compacting_) {
+        pending_ops_.push_back({false, label, data});
+    }
+}
+
+void HNSWLibIndex::InsertVectorsBatch(const std::vector<float>& data, const std::vector<int64_t>& labels) {
+    assert(index_ != nullptr);
+    size_t n = labels.size();
+    if (n == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> write_lock(write_mutex_);
+
+    // 先一次扩容到能放下整批, 之后的并发插入不会触发重新分配
+    if (index_->getCurrentElementCount() + n > index_->getMaxElements()) {
+        std::unique_lock<std::shared_mutex> lock(index_mutex_);
+        max_elements_ = std::max<size_t>(max_elements_ * 2, index_->getCurrentElementCount() + n);
+        index_->resizeIndex(max_elements_);
+        global_logger->info("HNSW index resized to {}", max_elements_);
+    }
+
+    {
+        // hnswlib 的 addPoint 对不同 label 可以并发执行
+        std::shared_lock<std::shared_mutex> lock(index_mutex_);
+        auto insert = [this, &data, &labels](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                DoInsert(index_, data.data() + i * dim_, labels[i]);
+            }
+        };
+        size_t workers = std::min<size_t>(std::max(1U, std::thread::hardware_concurrency()),
+                                          (n + INSERT_BATCH_CHUNK - 1) / INSERT_BATCH_CHUNK);
+        size_t chunk = (n + workers - 1) / workers;
+        std::vector<std::future<void>> futures;
+        for (size_t begin = chunk; begin < n; begin += chunk) {
+            futures.push_back(std::async(std::launch::async, insert, begin, std::min(begin + chunk, n)));
+        }
+        insert(0, std::min(chunk, n));
+        for (auto& future : futures) {
+            future.get();
+        }
+    }
+    if (compacting_) {
+        for (size_t i = 0; i < n; ++i) {
+            const float* begin = data.data() + i * dim_;
+            pending_ops_.push_back({false, labels[i], std::vector<float>(begin, begin + dim_)});
+        }
+    }
 }
 
 // 找到最多K个 可能不满K个 不满的都是label distance 为-1
 auto HNSWLibIndex::SearchVectors(const std::vector<float>& query, int k,const roaring_bitmap_t* bitmap , int ef_search) -> std::pair<std::vector<int64_t>, std::vector<float>> { // 修改返回类型
     assert(index_ != nullptr);
-    index_->setEf(ef_search);
 
     RoaringBitmapIDFilter* selector = nullptr;
     if (bitmap != nullptr) {
         selector = new RoaringBitmapIDFilter(bitmap);
-    } 
+    }
 
-    auto result = index_->searchKnn(query.data(), k,selector);
+    std::priority_queue<std::pair<float, hnswlib::labeltype>> result;
+    {
+        std::shared_lock<std::shared_mutex> lock(index_mutex_);
+        index_->setEf(ef_search);
+        result = index_->searchKnn(query.data(), k, selector);
+    }
 
     std::vector<int64_t> indices(k,-1);
     std::vector<float> distances(k,-1);
@@ -51,18 +178,169 @@ auto HNSWLibIndex::SearchVectors(const std::vector<float>& query, int k,const ro
 
     if (bitmap != nullptr) {
         delete selector;
-    } 
+    }
+    return {indices, distances};
+}
+
+auto HNSWLibIndex::RangeSearchVectors(const std::vector<float>& query, float radius, size_t max_results,
+                                      const roaring_bitmap_t* bitmap, int ef_search) -> std::pair<std::vector<int64_t>, std::vector<float>> {
+    assert(index_ != nullptr);
+    std::unique_ptr<RoaringBitmapIDFilter> selector;
+    if (bitmap != nullptr) {
+        selector = std::make_unique<RoaringBitmapIDFilter>(bitmap);
+    }
+
+    // 至少扩展 ef_search 个候选, 候选距离都超过 radius 后停止, 候选集上限为 max_results
+    size_t min_candidates = std::min<size_t>(std::max(ef_search, 1), std::max<size_t>(max_results, 1));
+    hnswlib::EpsilonSearchStopCondition<float> stop_condition(radius, min_candidates, std::max<size_t>(max_results, 1));
+    std::vector<std::pair<float, hnswlib::labeltype>> result;
+    {
+        std::shared_lock<std::shared_mutex> lock(index_mutex_);
+        result = index_->searchStopConditionClosest(query.data(), stop_condition, selector.get());
+    }
+    std::sort(result.begin(), result.end());
+
+    std::vector<int64_t> indices;
+    std::vector<float> distances;
+    for (const auto &item : result) {
+        if (item.first > radius || indices.size() >= max_results) {
+            break;
+        }
+        indices.push_back(static_cast<int64_t>(item.second));
+        distances.push_back(item.first);
+    }
+    global_logger->debug("HNSW range search found {} vectors within {}", indices.size(), radius);
     return {indices, distances};
 }
 
 void HNSWLibIndex::RemoveVectors(const std::vector<int64_t>& ids) { // 添加RemoveVectors函数实现
     assert(index_ != nullptr);
-    for(const auto &id:ids){
-        index_->markDelete(id);
+    std::lock_guard<std::mutex> write_lock(write_mutex_);
+    {
+        std::shared_lock<std::shared_mutex> lock(index_mutex_);
+        for (const auto &id : ids) {
+            DoRemove(index_, id);
+        }
+    }
+    if (compacting_) {
+        for (const auto &id : ids) {
+            pending_ops_.push_back({true, id, {}});
+        }
+    }
+}
+
+auto HNSWLibIndex::DeletedRatio() const -> double {
+    std::shared_lock<std::shared_mutex> lock(index_mutex_);
+    size_t count = index_->getCurrentElementCount();
+    if (count == 0) {
+        return 0;
+    }
+    return static_cast<double>(index_->getDeletedCount()) / static_cast<double>(count);
+}
+
+void HNSWLibIndex::Compact() {
+    std::vector<hnswlib::labeltype> labels;
+    std::vector<float> vectors;
+    size_t capacity = 0;
+    uint64_t generation = 0;
+    {
+        // 拷贝存活向量期间暂停写入, 之后的写入记录到 pending_ops_
+        std::lock_guard<std::mutex> write_lock(write_mutex_);
+        if (compacting_) {
+            return;
+        }
+        generation = generation_;
+        size_t count = index_->getCurrentElementCount();
+        size_t live = count - index_->getDeletedCount();
+        labels.reserve(live);
+        vectors.reserve(live * dim_);
+        for (hnswlib::tableint i = 0; i < count; ++i) {
+            if (index_->isMarkedDeleted(i)) {
+                continue;
+            }
+            labels.push_back(index_->getExternalLabel(i));
+            const auto *data = reinterpret_cast<const float *>(index_->getDataByInternalId(i));
+            vectors.insert(vectors.end(), data, data + dim_);
+        }
+        capacity = std::max<size_t>(max_elements_, 1);
+        compacting_ = true;
+        global_logger->info("HNSW compaction started: {} live of {} elements", live, count);
+    }
+
+    // 重建不持有任何锁, 查询继续走旧图
+    auto *new_index = new hnswlib::HierarchicalNSW<float>(space_, capacity, m_, ef_construction_, 100, true);
+    for (size_t i = 0; i < labels.size(); ++i) {
+        new_index->addPoint(vectors.data() + i * dim_, labels[i]);
+    }
+
+    hnswlib::HierarchicalNSW<float>* old_index = nullptr;
+    {
+        std::lock_guard<std::mutex> write_lock(write_mutex_);
+        // 重建期间安装了快照: 新图来自旧数据, pending_ops_ 已被 LoadIndex 清空或属于之后的重建
+        if (generation != generation_) {
+            global_logger->info("HNSW compaction discarded, index reloaded while rebuilding");
+            delete new_index;
+            return;
+        }
+        for (const auto &op : pending_ops_) {
+            if (op.remove_) {
+                DoRemove(new_index, op.label_);
+                continue;
+            }
+            if (new_index->getDeletedCount() == 0 &&
+                new_index->getCurrentElementCount() >= new_index->getMaxElements()) {
+                new_index->resizeIndex(new_index->getMaxElements() * 2);
+            }
+            DoInsert(new_index, op.data_.data(), op.label_);
+        }
+        global_logger->info("HNSW compaction replayed {} pending ops", pending_ops_.size());
+        pending_ops_.clear();
+        compacting_ = false;
+
+        std::unique_lock<std::shared_mutex> lock(index_mutex_);
+        old_index = index_;
+        index_ = new_index;
+        max_elements_ = new_index->getMaxElements();
+    }
+    delete old_index;
+    global_logger->info("HNSW compaction finished: {} elements", labels.size());
+}
+
+void HNSWLibIndex::CompactLoop() {
+    std::unique_lock<std::mutex> lock(compactor_mutex_);
+    while (!stop_compactor_) {
+        compactor_cv_.wait_for(lock, std::chrono::seconds(COMPACT_CHECK_INTERVAL_SEC),
+                               [this] { return stop_compactor_.load(); });
+        if (stop_compactor_) {
+            break;
+        }
+        lock.unlock();
+        MaybeCompact();
+        lock.lock();
+    }
+}
+
+void HNSWLibIndex::RunScheduled() {
+    MaybeCompact();
+    if (!stop_compactor_) {
+        scheduler_->Schedule(this, TaskScheduler::Clock::now() + std::chrono::seconds(COMPACT_CHECK_INTERVAL_SEC));
+    }
+}
+
+void HNSWLibIndex::MaybeCompact() {
+    size_t deleted = 0;
+    {
+        std::shared_lock<std::shared_mutex> index_lock(index_mutex_);
+        deleted = index_->getDeletedCount();
+    }
+    if (deleted >= COMPACT_MIN_DELETED && DeletedRatio() >= COMPACT_DELETED_RATIO) {
+        Compact();
     }
 }
 
 void HNSWLibIndex::SaveIndex(const std::string& file_path) { // 添加 saveIndex 方法实现
+    std::lock_guard<std::mutex> write_lock(write_mutex_);
+    std::shared_lock<std::shared_mutex> lock(index_mutex_);
     index_->saveIndex(file_path);
 }
 
@@ -70,10 +348,17 @@ void HNSWLibIndex::LoadIndex(const std::string& file_path) { // 添加 loadIndex
     std::ifstream file(file_path); // 尝试打开文件
     if (file.good()) { // 检查文件是否存在
         file.close();
+        std::lock_guard<std::mutex> write_lock(write_mutex_);
+        std::unique_lock<std::shared_mutex> lock(index_mutex_);
         index_->loadIndex(file_path, space_, max_elements_);
+        max_elements_ = index_->getMaxElements();
+        // 取消进行中的重建: 它的结果和记录的写操作都针对加载前的数据
+        compacting_ = false;
+        pending_ops_.clear();
+        ++generation_;
     } else {
         global_logger->warn("File not found: {}. Skipping loading index.", file_path);
     }
 }
 
-}  // namespace vectordb
\ No newline at end of file
+}  // namespace vectordb
@@ -1,17 +1,39 @@
 #include "index/index_factory.h"
 #include "index/hnswlib_index.h"
 #include "index/filter_index.h"
+#include <filesystem>
 namespace vectordb {
 
+IndexFactory::~IndexFactory() {
+    for (const auto& [type, index] : index_map_) {
+        switch (type) {
+            case IndexType::FLAT:
+                delete static_cast<FaissIndex*>(index);
+                break;
+            case IndexType::HNSW:
+                delete static_cast<HNSWLibIndex*>(index);
+                break;
+            case IndexType::FILTER:
+                delete static_cast<FilterIndex*>(index);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
 void IndexFactory::Init(IndexType type, int dim,  int num_data,MetricType metric) {
     faiss::MetricType faiss_metric = (metric == MetricType::L2) ? faiss::METRIC_L2 : faiss::METRIC_INNER_PRODUCT;
 
     switch (type) {
-        case IndexType::FLAT:
-            index_map_[type] = new vectordb::FaissIndex(new faiss::IndexIDMap(new faiss::IndexFlat(dim, faiss_metric)));
+        case IndexType::FLAT: {
+            auto* id_map = new faiss::IndexIDMap(new faiss::IndexFlat(dim, faiss_metric));
+            id_map->own_fields = true;  // 删除索引时一起释放底层的 flat 索引
+            index_map_[type] = new vectordb::FaissIndex(id_map, compact_scheduler_);
             break;
+        }
         case IndexType::HNSW:
-            index_map_[type] = new vectordb::HNSWLibIndex(dim, num_data, metric, 16, 200);
+            index_map_[type] = new vectordb::HNSWLibIndex(dim, num_data, metric, 16, 200, compact_scheduler_);
             break;
         case IndexType::FILTER: // 初始化 FilterIndex 对象
             index_map_[type] = new FilterIndex();
@@ -21,6 +43,12 @@ void IndexFactory::Init(IndexType type, int dim,  int num_data,MetricType metric
     }
 }
 
+void IndexFactory::InitAll(int dim, int num_data, MetricType metric) {
+    Init(IndexType::FLAT, dim, num_data, metric);
+    Init(IndexType::HNSW, dim, num_data, metric);
+    Init(IndexType::FILTER, dim, num_data, metric);
+}
+
 auto IndexFactory::GetIndex(IndexType type) const -> void* { 
     auto it = index_map_.find(type);
     if (it != index_map_.end()) {
@@ -37,15 +65,20 @@ void IndexFactory::SaveIndex(const std::string& folder_path) { // 添加 ScalarS
 
         // 为每个索引类型生成一个文件名
         std::string file_path = folder_path + std::to_string(static_cast<int>(index_type)) + ".index";
+        // 先写临时文件再改名: 保存到一半崩溃不会损坏上一份索引, raft 快照里硬链接的旧文件也保持不变
+        std::string tmp_path = file_path + ".tmp";
 
         // 根据索引类型调用相应的 saveIndex 函数
         if (index_type == IndexType::FLAT) {
-            static_cast<FaissIndex*>(index)->SaveIndex(file_path);
+            static_cast<FaissIndex*>(index)->SaveIndex(tmp_path);
         } else if (index_type == IndexType::HNSW) {
-            static_cast<HNSWLibIndex*>(index)->SaveIndex(file_path);
+            static_cast<HNSWLibIndex*>(index)->SaveIndex(tmp_path);
         } else if (index_type == IndexType::FILTER) { // 保存 FilterIndex 类型的索引
-            static_cast<FilterIndex*>(index)->SaveIndex(file_path);
+            static_cast<FilterIndex*>(index)->SaveIndex(tmp_path);
+        } else {
+            continue;
         }
+        std::filesystem::rename(tmp_path, file_path);
     }
 }
 
@@ -0,0 +1,198 @@
+#include "cluster/file_log_store.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "common/vector_init.h"
+#include "gtest/gtest.h"
+#include "libnuraft/nuraft.hxx"
+namespace vectordb {
+
+namespace {
+auto MakeEntry(uint64_t term, const std::string& payload) -> nuraft::ptr<nuraft::log_entry> {
+  nuraft::ptr<nuraft::buffer> buf = nuraft::buffer::alloc(sizeof(int) + payload.size());
+  nuraft::buffer_serializer bs(buf);
+  bs.put_str(payload);
+  return nuraft::cs_new<nuraft::log_entry>(term, buf);
+}
+
+auto Payload(const nuraft::ptr<nuraft::log_entry>& entry) -> std::string {
+  nuraft::buffer_serializer bs(entry->get_buf());
+  return bs.get_str();
+}
+}  // namespace
+
+// NOLINTNEXTLINE
+TEST(FileLogStoreTest, AppendReopenTest) {
+  VdbServerInit(1);
+  std::string dir = Cfg::Instance().TestWalPath() + "_file_log_store_test";
+  std::filesystem::remove_all(dir);
+  {
+    // 很小的段, 覆盖封存和新建段的路径
+    FileLogStore store(dir, 1024);
+    EXPECT_EQ(store.start_index(), 1U);
+    for (uint64_t i = 1; i <= 100; ++i) {
+      auto entry = MakeEntry(i / 10 + 1, "entry-" + std::to_string(i));
+      EXPECT_EQ(store.append(entry), i);
+    }
+    EXPECT_GT(store.SegmentCount(), 1U);
+    EXPECT_TRUE(store.flush());
+    EXPECT_EQ(store.last_durable_index(), 100U);
+    EXPECT_EQ(Payload(store.last_entry()), "entry-100");
+
+    auto entries = store.log_entries(10, 60);
+    ASSERT_EQ(entries->size(), 50U);
+    for (size_t i = 0; i < entries->size(); ++i) {
+      EXPECT_EQ(Payload((*entries)[i]), "entry-" + std::to_string(10 + i));
+    }
+    // 按字节数截断的批量读取至少返回一条
+    EXPECT_EQ(store.log_entries_ext(10, 60, 1)->size(), 1U);
+  }
+
+  FileLogStore store(dir, 1024);
+  EXPECT_EQ(store.next_slot(), 101U);
+  EXPECT_EQ(store.term_at(55), 6U);
+  EXPECT_EQ(Payload(store.entry_at(77)), "entry-77");
+  EXPECT_EQ(Payload(store.last_entry()), "entry-100");
+}
+
+// NOLINTNEXTLINE
+TEST(FileLogStoreTest, TruncateCompactTest) {
+  VdbServerInit(1);
+  std::string dir = Cfg::Instance().TestWalPath() + "_file_log_store_test";
+  std::filesystem::remove_all(dir);
+  {
+    FileLogStore store(dir, 1024);
+    for (uint64_t i = 1; i <= 100; ++i) {
+      auto entry = MakeEntry(1, "entry-" + std::to_string(i));
+      store.append(entry);
+    }
+
+    // 新 leader 覆盖 index 40 之后的日志
+    auto entry = MakeEntry(2, "new-40");
+    store.write_at(40, entry);
+    EXPECT_EQ(store.next_slot(), 41U);
+    EXPECT_EQ(store.term_at(40), 2U);
+    EXPECT_EQ(Payload(store.entry_at(39)), "entry-39");
+
+    size_t segments = store.SegmentCount();
+    EXPECT_TRUE(store.compact(30));
+    EXPECT_EQ(store.start_index(), 31U);
+    EXPECT_LT(store.SegmentCount(), segments);
+    EXPECT_EQ(Payload(store.entry_at(31)), "entry-31");
+
+    // pack / apply_pack 往返
+    auto pack = store.pack(35, 6);
+    std::filesystem::remove_all(dir + "_other");
+    FileLogStore other(dir + "_other", 1024);
+    other.apply_pack(35, *pack);
+    EXPECT_EQ(other.start_index(), 35U);
+    EXPECT_EQ(other.next_slot(), 41U);
+    EXPECT_EQ(Payload(other.entry_at(40)), "new-40");
+  }
+
+  FileLogStore store(dir, 1024);
+  EXPECT_EQ(store.next_slot(), 41U);
+  EXPECT_LE(store.start_index(), 31U);
+  EXPECT_EQ(Payload(store.entry_at(40)), "new-40");
+
+  // 快照覆盖全部日志时只留下一个空段, 重启后仍能恢复起始位置
+  EXPECT_TRUE(store.compact(200));
+  EXPECT_EQ(store.SegmentCount(), 1U);
+  EXPECT_EQ(store.next_slot(), 201U);
+  std::filesystem::remove_all(dir + "_other");
+}
+
+// NOLINTNEXTLINE
+TEST(FileLogStoreTest, CompactedReadTest) {
+  VdbServerInit(1);
+  std::string dir = Cfg::Instance().TestWalPath() + "_file_log_store_test";
+  std::filesystem::remove_all(dir);
+  FileLogStore store(dir, 1024);
+  for (uint64_t i = 1; i <= 100; ++i) {
+    auto entry = MakeEntry(1, "entry-" + std::to_string(i));
+    store.append(entry);
+  }
+  EXPECT_TRUE(store.compact(50));
+  // 已压缩的日志不能用 term 0 的占位日志充数
+  EXPECT_EQ(store.log_entries(40, 60), nullptr);
+  EXPECT_EQ(store.log_entries_ext(40, 60, 0), nullptr);
+  EXPECT_EQ(store.log_entries(51, 60)->size(), 9U);
+}
+
+// NOLINTNEXTLINE
+TEST(FileLogStoreTest, CorruptedSealedSegmentTest) {
+  VdbServerInit(1);
+  std::string dir = Cfg::Instance().TestWalPath() + "_file_log_store_test";
+  std::filesystem::remove_all(dir);
+  {
+    FileLogStore store(dir, 1024);
+    for (uint64_t i = 1; i <= 100; ++i) {
+      auto entry = MakeEntry(1, "entry-" + std::to_string(i));
+      store.append(entry);
+    }
+    EXPECT_GT(store.SegmentCount(), 2U);
+    EXPECT_TRUE(store.flush());
+  }
+
+  // 损坏第一个(已封存)段中间的一个字节
+  std::vector<std::string> segments;
+  for (const auto& file : std::filesystem::directory_iterator(dir)) {
+    segments.push_back(file.path().string());
+  }
+  std::sort(segments.begin(), segments.end());
+  {
+    std::fstream file(segments.front(), std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(static_cast<std::streamoff>(std::filesystem::file_size(segments.front()) / 2));
+    file.put('\x7f');
+  }
+  // 拒绝启动, 后面已确认的段不能被当作不连续的段删掉
+  EXPECT_THROW(FileLogStore(dir, 1024), std::runtime_error);
+  size_t remaining = 0;
+  for (const auto& file : std::filesystem::directory_iterator(dir)) {
+    (void)file;
+    ++remaining;
+  }
+  EXPECT_EQ(remaining, segments.size());
+}
+
+// NOLINTNEXTLINE
+TEST(FileLogStoreTest, SharedFlushSchedulerTest) {
+  VdbServerInit(1);
+  std::string dir = Cfg::Instance().TestWalPath() + "_file_log_store_shared_test";
+  std::filesystem::remove_all(dir);
+  // 多个 raft 组的日志存储共用一个刷盘线程
+  LogFlushScheduler scheduler(1);
+  std::vector<std::unique_ptr<FileLogStore>> stores;
+  for (int g = 0; g < 4; ++g) {
+    stores.push_back(std::make_unique<FileLogStore>(dir + "/" + std::to_string(g), 1024, 1, &scheduler));
+  }
+  for (uint64_t i = 1; i <= 50; ++i) {
+    for (auto &store : stores) {
+      auto entry = MakeEntry(1, "entry-" + std::to_string(i));
+      EXPECT_EQ(store->append(entry), i);
+    }
+  }
+  for (auto &store : stores) {
+    for (int retry = 0; retry < 500 && store->last_durable_index() < 50; ++retry) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(store->last_durable_index(), 50U);
+  }
+  // 关闭一个存储后其他存储仍然由线程池刷盘
+  stores[0]->Close();
+  auto entry = MakeEntry(1, "entry-51");
+  EXPECT_EQ(stores[1]->append(entry), 51U);
+  for (int retry = 0; retry < 500 && stores[1]->last_durable_index() < 51; ++retry) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_EQ(stores[1]->last_durable_index(), 51U);
+  stores.clear();
+  std::filesystem::remove_all(dir);
+}
+
+}  // namespace vectordb
@@ -0,0 +1,43 @@
+#include "cluster/file_state_mgr.h"
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include "common/vector_init.h"
+#include "gtest/gtest.h"
+namespace vectordb {
+
+// NOLINTNEXTLINE
+TEST(FileStateMgrTest, ReloadTest) {
+  VdbServerInit(1);
+  std::string dir = Cfg::Instance().TestWalPath() + "_file_state_mgr_test";
+  std::filesystem::remove_all(dir);
+  {
+    FileStateMgr mgr(1, "127.0.0.1:8081", dir, nuraft::cs_new<FileLogStore>(dir, 1024));
+    // 第一次启动只有自己, 也没有 term / vote
+    EXPECT_EQ(mgr.load_config()->get_servers().size(), 1U);
+    EXPECT_EQ(mgr.read_state(), nullptr);
+
+    nuraft::cluster_config config(7, 6);
+    config.get_servers().push_back(nuraft::cs_new<nuraft::srv_config>(1, "127.0.0.1:8081"));
+    config.get_servers().push_back(nuraft::cs_new<nuraft::srv_config>(2, "127.0.0.1:8082"));
+    mgr.save_config(config);
+    nuraft::srv_state state(5, 2, false);
+    mgr.save_state(state);
+  }
+
+  FileStateMgr mgr(1, "127.0.0.1:8081", dir, nuraft::cs_new<FileLogStore>(dir, 1024));
+  auto config = mgr.load_config();
+  EXPECT_EQ(config->get_log_idx(), 7U);
+  ASSERT_EQ(config->get_servers().size(), 2U);
+  EXPECT_EQ(config->get_servers().back()->get_endpoint(), "127.0.0.1:8082");
+  auto state = mgr.read_state();
+  ASSERT_NE(state, nullptr);
+  EXPECT_EQ(state->get_term(), 5U);
+  EXPECT_EQ(state->get_voted_for(), 2);
+
+  // 内容损坏时拒绝启动, 而不是带着空的投票记录加入集群
+  std::ofstream(dir + "/" + FileStateMgr::STATE_FILE_NAME, std::ios::binary | std::ios::app) << "x";
+  EXPECT_THROW(FileStateMgr(1, "127.0.0.1:8081", dir, nullptr), std::runtime_error);
+}
+
+}  // namespace vectordb
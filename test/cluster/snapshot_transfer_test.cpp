@@ -0,0 +1,75 @@
+#include "cluster/snapshot_transfer.h"
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include "common/vector_init.h"
+#include "gtest/gtest.h"
+namespace vectordb {
+
+namespace {
+void WriteTestFile(const std::string& path, size_t size, char seed) {
+  std::filesystem::create_directories(std::filesystem::path(path).parent_path());
+  std::string content(size, '\0');
+  for (size_t i = 0; i < size; ++i) {
+    content[i] = static_cast<char>(seed + i % 251);
+  }
+  std::ofstream(path, std::ios::binary) << content;
+}
+
+auto ReadTestFile(const std::string& path) -> std::string {
+  std::ifstream file(path, std::ios::binary);
+  return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+}  // namespace
+
+// NOLINTNEXTLINE
+TEST(SnapshotTransferTest, ResumeTest) {
+  VdbServerInit(1);
+  std::string base = (std::filesystem::path(Cfg::Instance().TestSnapPath()) / "snapshot_transfer_test").string();
+  std::filesystem::remove_all(base);
+  std::string src = base + "/src";
+  WriteTestFile(src + "/index/0.index", 1000, 'a');
+  WriteTestFile(src + "/index/1.index", 0, 'b');  // 空文件没有数据块
+  WriteTestFile(src + "/rocksdb/000010.sst", 256, 'c');
+  WriteTestFile(src + "/snapshot.meta", 10, 'd');
+
+  SnapshotReader reader(src, 128, {"snapshot.meta"});
+  // 1000 字节 8 块, 256 字节 2 块
+  ASSERT_EQ(reader.ChunkCount(), 10U);
+
+  std::string recv = base + "/recv";
+  uint64_t obj_id = 0;
+  {
+    // 每个块都落盘记录进度, 写到第 5 块时"崩溃"
+    SnapshotReceiver receiver(recv, 128);
+    obj_id = receiver.Begin(*reader.Read(0));
+    EXPECT_EQ(obj_id, 1U);
+    for (; obj_id <= 5; ++obj_id) {
+      EXPECT_TRUE(receiver.Write(obj_id, *reader.Read(obj_id)));
+    }
+  }
+
+  SnapshotReceiver receiver(recv, 128);
+  obj_id = receiver.Begin(*reader.Read(0));
+  EXPECT_EQ(obj_id, 6U);
+
+  // 损坏的块被拒绝, 重发后正常写入
+  auto chunk = reader.Read(obj_id);
+  chunk->data_begin()[chunk->size() - 1] ^= 0x1;
+  EXPECT_FALSE(receiver.Write(obj_id, *chunk));
+  for (; obj_id <= reader.ChunkCount(); ++obj_id) {
+    EXPECT_TRUE(receiver.Write(obj_id, *reader.Read(obj_id)));
+  }
+  std::string dst = base + "/dst";
+  receiver.Finish(dst);
+
+  EXPECT_EQ(ReadTestFile(dst + "/index/0.index"), ReadTestFile(src + "/index/0.index"));
+  EXPECT_TRUE(std::filesystem::exists(dst + "/index/1.index"));
+  EXPECT_EQ(ReadTestFile(dst + "/rocksdb/000010.sst"), ReadTestFile(src + "/rocksdb/000010.sst"));
+  EXPECT_FALSE(std::filesystem::exists(dst + "/snapshot.meta"));
+  EXPECT_FALSE(std::filesystem::exists(dst + "/" + SnapshotReceiver::PROGRESS_FILE_NAME));
+  std::filesystem::remove_all(base);
+}
+
+}  // namespace vectordb
@@ -0,0 +1,145 @@
+#include "cluster/write_batcher.h"
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cluster/raft_command.h"
+#include "common/vector_init.h"
+#include "gtest/gtest.h"
+namespace vectordb {
+
+// NOLINTNEXTLINE
+TEST(WriteBatcherTest, GroupCommitTest) {
+  VdbServerInit(1);
+  std::mutex mutex;
+  std::vector<UpsertRecord> applied;
+  std::atomic<uint64_t> next_idx{1};
+  std::atomic<size_t> batches{0};
+  WriteBatcher batcher(
+      [&](nuraft::ptr<nuraft::buffer> batch, const WriteBatcher::Callback &done) {
+        // 模拟一次复制往返, 期间到达的请求进入下一批
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        auto records = RaftCommand::Decode(*batch);
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          applied.insert(applied.end(), records.begin(), records.end());
+        }
+        ++batches;
+        WriteResult result;
+        result.ok_ = true;
+        result.log_idx_ = next_idx++;
+        done(result);
+      },
+      std::chrono::microseconds(500), 1 << 20, 64, true);
+
+  constexpr int THREADS = 8;
+  constexpr int PER_THREAD = 50;
+  std::atomic<int> acked{0};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < THREADS; ++t) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < PER_THREAD; ++i) {
+        std::promise<WriteResult> promise;
+        auto future = promise.get_future();
+        UpsertRecord record;
+        record.id_ = t * PER_THREAD + i;
+        record.index_type_ = IndexFactory::IndexType::FLAT;
+        record.vector_ = {1.0F, 2.0F, 3.0F};
+        record.attributes_ = "attributes";
+        batcher.Submit(RaftCommand::EncodeUpsert(record),
+                       [&promise](const WriteResult &result) { promise.set_value(result); });
+        WriteResult result = future.get();
+        EXPECT_TRUE(result.ok_);
+        EXPECT_GT(result.log_idx_, 0U);
+        ++acked;
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  batcher.Stop();
+
+  EXPECT_EQ(acked.load(), THREADS * PER_THREAD);
+  EXPECT_EQ(applied.size(), static_cast<size_t>(THREADS * PER_THREAD));
+  // 并发的请求被合并, 日志条数明显少于请求数
+  EXPECT_LT(batches.load(), static_cast<size_t>(THREADS * PER_THREAD / 2));
+}
+
+// NOLINTNEXTLINE
+TEST(WriteBatcherTest, SharedSchedulerTest) {
+  VdbServerInit(1);
+  TaskScheduler scheduler(1);
+  std::atomic<size_t> batches{0};
+  auto append = [&batches](nuraft::ptr<nuraft::buffer> batch, const WriteBatcher::Callback &done) {
+    ++batches;
+    WriteResult result;
+    result.ok_ = true;
+    result.log_idx_ = RaftCommand::Decode(*batch).size();
+    done(result);
+  };
+
+  UpsertRecord record;
+  record.id_ = 1;
+  record.vector_ = {1.0F};
+  std::atomic<int> acked{0};
+  auto on_done = [&acked](const WriteResult &result) {
+    EXPECT_TRUE(result.ok_);
+    ++acked;
+  };
+  {
+    // 两个攒批器共用一个提交线程; 攒满 4 条立即提交, 不满的一批等到期后提交
+    WriteBatcher first(append, std::chrono::microseconds(500), 1 << 20, 4, false, &scheduler);
+    WriteBatcher second(append, std::chrono::microseconds(500), 1 << 20, 4, false, &scheduler);
+    for (int i = 0; i < 6; ++i) {
+      first.Submit(RaftCommand::EncodeUpsert(record), on_done);
+      second.Submit(RaftCommand::EncodeUpsert(record), on_done);
+    }
+    for (int i = 0; i < 100 && acked.load() < 12; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(acked.load(), 12);
+
+    // 停止时还没到期的请求也会提交
+    WriteBatcher slow(append, std::chrono::seconds(10), 1 << 20, 64, false, &scheduler);
+    slow.Submit(RaftCommand::EncodeUpsert(record), on_done);
+    slow.Stop();
+    EXPECT_EQ(acked.load(), 13);
+  }
+  EXPECT_LT(batches.load(), 13U);
+}
+
+// NOLINTNEXTLINE
+TEST(WriteBatcherTest, RaftCommandTest) {
+  UpsertRecord record;
+  record.id_ = 42;
+  record.index_type_ = IndexFactory::IndexType::HNSW;
+  record.vector_ = {0.5F, -1.0F};
+  record.attributes_ = "attributes";
+  std::vector<std::string> commands(100, RaftCommand::EncodeUpsert(record));
+
+  // 压缩和不压缩的批量都能解出同样的记录
+  for (bool compress : {false, true}) {
+    auto records = RaftCommand::Decode(*RaftCommand::EncodeBatch(commands, compress));
+    ASSERT_EQ(records.size(), 100U);
+    EXPECT_EQ(records[99].id_, 42U);
+    EXPECT_EQ(records[99].index_type_, IndexFactory::IndexType::HNSW);
+    EXPECT_EQ(records[99].vector_, record.vector_);
+    EXPECT_EQ(records[99].attributes_, "attributes");
+  }
+
+  // 旧格式的单条 JSON 日志仍然能回放
+  std::string request = R"({"id": 1, "vectors": [1.0, 2.0], "indexType": "FLAT"})";
+  nuraft::ptr<nuraft::buffer> buf = nuraft::buffer::alloc(sizeof(int) + request.size());
+  nuraft::buffer_serializer bs(buf);
+  bs.put_str(request);
+  auto records = RaftCommand::Decode(*buf);
+  ASSERT_EQ(records.size(), 1U);
+  EXPECT_EQ(records[0].id_, 1U);
+  EXPECT_EQ(records[0].index_type_, IndexFactory::IndexType::FLAT);
+  EXPECT_EQ(records[0].vector_.size(), 2U);
+}
+
+}  // namespace vectordb
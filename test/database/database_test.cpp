@@ -1,7 +1,10 @@
 #include <logger/logger.h>
 #include <cstdint>
+#include "common/constants.h"
 #include "common/vector_init.h"
+#include "database/scalar_storage.h"
 #include "database/vector_database.h"
+#include "database/vector_store.h"
 #include "gtest/gtest.h"
 #include "index/faiss_index.h"
 #include "index/index_factory.h"
@@ -11,6 +14,7 @@ namespace vectordb {
 TEST(DatabaseTest, SampleTest) {
   Init();
   std::experimental::filesystem::remove_all(Cfg::Instance().TestRocksDbPath());
+  std::experimental::filesystem::remove_all(Cfg::Instance().TestRocksDbPath() + VECTOR_STORE_DIR_SUFFIX);
   VectorDatabase db(Cfg::Instance().TestRocksDbPath(),Cfg::Instance().TestWalPath());
   rapidjson::Document doc;
   doc.SetObject();
@@ -47,4 +51,66 @@ TEST(DatabaseTest, SampleTest) {
   }
   EXPECT_EQ(int(vec[0]), 11);
 }
+
+// NOLINTNEXTLINE
+TEST(DatabaseTest, DimensionMismatchTest) {
+  VdbServerInit(1);
+  std::experimental::filesystem::remove_all(Cfg::Instance().TestRocksDbPath());
+  std::experimental::filesystem::remove_all(Cfg::Instance().TestRocksDbPath() + VECTOR_STORE_DIR_SUFFIX);
+  VectorDatabase db(Cfg::Instance().TestRocksDbPath(), Cfg::Instance().TestWalPath());
+
+  UpsertRecord good;
+  good.id_ = 1;
+  good.index_type_ = IndexFactory::IndexType::FLAT;
+  good.vector_ = {1.0F};
+  UpsertRecord bad = good;
+  bad.id_ = 2;
+  bad.vector_ = {1.0F, 2.0F};
+
+  std::string error;
+  EXPECT_TRUE(db.CheckDimension(good, &error));
+  EXPECT_FALSE(db.CheckDimension(bad, &error));
+  EXPECT_FALSE(error.empty());
+
+  // 提交路径上的坏记录被跳过, 不影响同一批中的其他记录
+  EXPECT_NO_THROW(db.UpsertBatch({bad, good}, 1));
+  EXPECT_TRUE(db.Query(1).IsObject());
+  EXPECT_FALSE(db.Query(2).IsObject());
+}
+
+// NOLINTNEXTLINE
+TEST(DatabaseTest, StaleVectorRepairTest) {
+  VdbServerInit(1);
+  std::string db_path = Cfg::Instance().TestRocksDbPath();
+  std::string store_dir = db_path + VECTOR_STORE_DIR_SUFFIX;
+  std::experimental::filesystem::remove_all(db_path);
+  std::experimental::filesystem::remove_all(store_dir);
+  std::string store_path = store_dir + "/" + VECTOR_STORE_FILE_NAME;
+  UpsertRecord record;
+  record.id_ = 1;
+  record.index_type_ = IndexFactory::IndexType::FLAT;
+  record.vector_ = {1.0F, 2.0F};
+  {
+    VectorDatabase db(db_path, Cfg::Instance().TestWalPath());
+    db.UpsertBatch({record}, 1);
+  }
+  // 模拟崩溃: 刷盘水位之后 RocksDB 中写入了新向量, 向量文件停留在旧值, 还留着 RocksDB 中没有的 id
+  {
+    rapidjson::Document doc;
+    doc.Parse(R"({"id": 1, "vectors": [3.0, 4.0]})");
+    ScalarStorage storage(db_path);
+    storage.InsertScalar(1, doc);
+  }
+  {
+    VectorStore store(store_path);
+    store.Put(2, {9.0F, 9.0F});
+  }
+  { VectorDatabase db(db_path, Cfg::Instance().TestWalPath()); }
+
+  VectorStore store(store_path);
+  std::vector<float> vec;
+  ASSERT_TRUE(store.Get(1, &vec));
+  EXPECT_EQ(vec, std::vector<float>({3.0F, 4.0F}));
+  EXPECT_FALSE(store.Contains(2));
+}
 }  // namespace vectordb
\ No newline at end of file
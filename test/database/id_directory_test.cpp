@@ -0,0 +1,68 @@
+#include "database/id_directory.h"
+#include <cstdint>
+#include "gtest/gtest.h"
+namespace vectordb {
+// NOLINTNEXTLINE
+TEST(IdDirectoryTest, SampleTest) {
+  IdDirectory directory;
+  rapidjson::Document doc;
+  doc.Parse(R"({"id": 1, "vectors": [0.1], "category": 3, "name": "a"})");
+
+  auto fields = directory.ExtractIntFields(doc);
+  ASSERT_EQ(fields.size(), 1);
+  EXPECT_EQ(directory.FieldName(fields[0].first), "category");
+
+  EXPECT_FALSE(directory.Contains(1));
+  directory.Put(1, IndexFactory::IndexType::FLAT, fields);
+  EXPECT_TRUE(directory.Contains(1));
+
+  IdDirectory::Entry entry;
+  ASSERT_TRUE(directory.Lookup(1, &entry));
+  EXPECT_EQ(entry.index_type_, IndexFactory::IndexType::FLAT);
+  int64_t value = 0;
+  EXPECT_TRUE(IdDirectory::FindField(entry.int_fields_, directory.InternField("category"), &value));
+  EXPECT_EQ(value, 3);
+  EXPECT_FALSE(IdDirectory::FindField(entry.int_fields_, directory.InternField("other"), &value));
+
+  // 覆盖写
+  directory.Put(1, IndexFactory::IndexType::HNSW, {});
+  directory.Put(2, IndexFactory::IndexType::HNSW, {});
+  ASSERT_TRUE(directory.Lookup(1, &entry));
+  EXPECT_EQ(entry.index_type_, IndexFactory::IndexType::HNSW);
+  EXPECT_TRUE(entry.int_fields_.empty());
+  EXPECT_EQ(directory.Size(), 2);
+}
+
+// NOLINTNEXTLINE
+TEST(IdDirectoryTest, GrowAndRewriteTest) {
+  IdDirectory directory;
+  uint32_t a = directory.InternField("a");
+  uint32_t b = directory.InternField("b");
+  // 超过初始槽位数, 触发扩容; 反复改变字段数, 触发字段区整理
+  const uint64_t n = IdDirectory::INITIAL_CAPACITY * 4;
+  for (int round = 0; round < 3; ++round) {
+    for (uint64_t id = 0; id < n; ++id) {
+      IdDirectory::FieldValues fields = {{a, static_cast<int64_t>(id + round)}};
+      if (round % 2 == 1) {
+        fields.emplace_back(b, -static_cast<int64_t>(id));
+      }
+      directory.Put(id, IndexFactory::IndexType::HNSW, fields);
+    }
+  }
+  EXPECT_EQ(directory.Size(), n);
+  EXPECT_FALSE(directory.Contains(n));
+
+  IdDirectory::Entry entry;
+  int64_t value = 0;
+  for (uint64_t id = 0; id < n; ++id) {
+    ASSERT_TRUE(directory.Lookup(id, &entry));
+    ASSERT_EQ(entry.int_fields_.size(), 1);
+    EXPECT_TRUE(IdDirectory::FindField(entry.int_fields_, a, &value));
+    EXPECT_EQ(value, static_cast<int64_t>(id + 2));
+  }
+
+  directory.Clear();
+  EXPECT_EQ(directory.Size(), 0);
+  EXPECT_FALSE(directory.Lookup(1, &entry));
+}
+}  // namespace vectordb
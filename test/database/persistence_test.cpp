@@ -0,0 +1,102 @@
+#include "database/persistence.h"
+#include <snappy.h>
+#include <experimental/filesystem>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "common/vector_init.h"
+#include "database/record_codec.h"
+#include "gtest/gtest.h"
+namespace vectordb {
+// NOLINTNEXTLINE
+TEST(PersistenceTest, ReplayTest) {
+  VdbServerInit(1);
+  std::string dir = Cfg::Instance().TestWalPath() + "_persistence_test";
+  std::experimental::filesystem::remove_all(dir);
+  // 取一个很大的 log id, 不会被快照目录里已有的 MaxLogID 覆盖
+  uint64_t base = 1ULL << 40;
+  {
+    // 旧版本留下的 WAL 段
+    std::experimental::filesystem::create_directories(dir);
+    std::ofstream segment(dir + "/" + WalSegment::ActiveName(1), std::ios::out | std::ios::binary);
+    segment.write(WalRecord::MAGIC, sizeof(WalRecord::MAGIC));
+    for (const auto& [log_id, json] : std::vector<std::pair<uint64_t, std::string>>{
+             {base + 1, R"({"id":1,"vectors":[1.0],"version":1})"},
+             {base + 2, R"({"id":2,"vectors":[2.0],"version":1})"},
+             {base + 3, R"({"id":1,"vectors":[3.0],"version":2})"}}) {
+      rapidjson::Document doc;
+      doc.Parse(json.c_str());
+      segment << WalRecord::Encode(log_id, WalRecord::Op::UPSERT, RecordCodec::Encode(doc));
+    }
+  }
+
+  Persistence persistence;
+  persistence.Init(dir);
+  std::vector<WalReplayRecord> replayed;
+  persistence.ReplayWal([&replayed](std::vector<WalReplayRecord>* records) {
+    for (auto& record : *records) {
+      replayed.push_back(std::move(record));
+    }
+  });
+
+  // id 1 只保留最后一次写入, 顺序与 WAL 一致
+  ASSERT_EQ(replayed.size(), 2);
+  EXPECT_EQ(replayed[0].log_id_, base + 2);
+  EXPECT_EQ(replayed[1].log_id_, base + 3);
+  EXPECT_EQ(replayed[1].operation_type_, "upsert");
+  EXPECT_EQ(replayed[1].data_["version"].GetInt(), 2);
+  EXPECT_EQ(persistence.GetId(), base + 3);
+  std::experimental::filesystem::remove_all(dir);
+}
+
+// NOLINTNEXTLINE
+TEST(PersistenceTest, LegacyWalConversionTest) {
+  VdbServerInit(1);
+  std::string dir = Cfg::Instance().TestWalPath() + "_persistence_legacy_test";
+  std::experimental::filesystem::remove_all(dir);
+  std::experimental::filesystem::create_directories(std::experimental::filesystem::path(dir).parent_path());
+  uint64_t base = 1ULL << 41;
+  {
+    // 旧版本的单文件 WAL, 中间夹着无法解压、日志 id 非法和 JSON 损坏的行
+    std::ofstream legacy(dir, std::ios::out | std::ios::binary);
+    std::vector<std::string> lines = {
+        std::to_string(base + 1) + R"(|1|upsert|{"id":1,"vectors":[1.0]})",
+        "",
+        "not_a_number|1|upsert|{\"id\":2}",
+        std::to_string(base + 3) + "|1|upsert|{broken",
+        std::to_string(base + 4) + R"(|1|upsert|{"id":4,"vectors":[4.0]})",
+    };
+    for (size_t i = 0; i < lines.size(); ++i) {
+      std::string compressed = "garbage";
+      if (i != 1) {
+        snappy::Compress(lines[i].data(), lines[i].size(), &compressed);
+        ASSERT_EQ(compressed.find('\n'), std::string::npos);
+      }
+      legacy << compressed << "\n";
+    }
+  }
+
+  Persistence persistence;
+  persistence.Init(dir);
+  std::vector<WalReplayRecord> replayed;
+  persistence.ReplayWal([&replayed](std::vector<WalReplayRecord>* records) {
+    for (auto& record : *records) {
+      replayed.push_back(std::move(record));
+    }
+  });
+
+  // 坏行被跳过, 之后的记录照常转换; 原文件保留为 .legacy
+  ASSERT_EQ(replayed.size(), 2);
+  EXPECT_EQ(replayed[0].log_id_, base + 1);
+  EXPECT_EQ(replayed[1].log_id_, base + 4);
+  bool kept = false;
+  for (const auto& entry : std::experimental::filesystem::directory_iterator(dir)) {
+    std::string name = entry.path().filename().string();
+    kept = kept || (name.size() > 7 && name.compare(name.size() - 7, 7, ".legacy") == 0);
+  }
+  EXPECT_TRUE(kept);
+  std::experimental::filesystem::remove_all(dir);
+}
+}  // namespace vectordb
@@ -0,0 +1,62 @@
+#include "database/record_codec.h"
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include "gtest/gtest.h"
+namespace vectordb {
+// NOLINTNEXTLINE
+TEST(RecordCodecTest, SampleTest) {
+  rapidjson::Document doc;
+  doc.Parse(R"({"id": 7, "vectors": [0.5, 2], "category": -3, "big": 18446744073709551615,
+                "score": 1.25, "name": "abc", "ok": true, "tags": [1, "x"], "empty": null})");
+  std::string encoded = RecordCodec::Encode(doc);
+
+  rapidjson::Document decoded;
+  ASSERT_TRUE(RecordCodec::Decode(encoded, &decoded));
+  EXPECT_EQ(decoded, doc);
+  EXPECT_TRUE(decoded["category"].IsInt());
+  EXPECT_FLOAT_EQ(decoded["vectors"][1].GetFloat(), 2.0);
+
+  // 投影
+  rapidjson::Document projected;
+  ASSERT_TRUE(RecordCodec::Decode(encoded, &projected, {"name", "missing"}));
+  EXPECT_EQ(projected.MemberCount(), 1);
+  EXPECT_STREQ(projected["name"].GetString(), "abc");
+
+  std::vector<float> vec;
+  ASSERT_TRUE(RecordCodec::DecodeVector(encoded, &vec));
+  EXPECT_EQ(vec.size(), 2);
+
+  // 只取 int32 范围内的整数字段
+  std::vector<std::pair<std::string_view, int64_t>> int_fields;
+  ASSERT_TRUE(RecordCodec::DecodeIntFields(encoded, &int_fields));
+  ASSERT_EQ(int_fields.size(), 2U);
+  EXPECT_EQ(int_fields[0].first, "id");
+  EXPECT_EQ(int_fields[1].first, "category");
+  EXPECT_EQ(int_fields[1].second, -3);
+
+  EXPECT_FALSE(RecordCodec::Decode(encoded.substr(0, encoded.size() - 1), &decoded));
+
+  // key 的字典序与数值序一致
+  EXPECT_LT(RecordCodec::EncodeKey(255), RecordCodec::EncodeKey(256));
+  uint64_t id = 0;
+  ASSERT_TRUE(RecordCodec::DecodeKey(RecordCodec::EncodeKey(1234567890123ULL), &id));
+  EXPECT_EQ(id, 1234567890123ULL);
+}
+
+// NOLINTNEXTLINE
+TEST(RecordCodecTest, LongFieldNameTest) {
+  rapidjson::Document doc;
+  doc.SetObject();
+  std::string name(RecordCodec::MAX_FIELD_NAME_LENGTH + 1, 'a');
+  doc.AddMember(rapidjson::Value(name.c_str(), doc.GetAllocator()), 1, doc.GetAllocator());
+  EXPECT_THROW(RecordCodec::Encode(doc), std::runtime_error);
+
+  name.pop_back();
+  doc.RemoveAllMembers();
+  doc.AddMember(rapidjson::Value(name.c_str(), doc.GetAllocator()), 1, doc.GetAllocator());
+  rapidjson::Document decoded;
+  ASSERT_TRUE(RecordCodec::Decode(RecordCodec::Encode(doc), &decoded));
+  EXPECT_TRUE(decoded.HasMember(name.c_str()));
+}
+}  // namespace vectordb
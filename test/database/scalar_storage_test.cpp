@@ -35,4 +35,149 @@ TEST(ScalarTest, SampleTest){
     EXPECT_EQ(res2["value"],11);
 
 }
-}  // namespace vectordb 
\ No newline at end of file
+
+// NOLINTNEXTLINE
+TEST(ScalarTest, MultiGetTest){
+    VdbServerInit(1);
+    std::experimental::filesystem::remove_all(Cfg::Instance().TestRocksDbPath());
+    ScalarStorage storage(Cfg::Instance().TestRocksDbPath());
+
+    for (int i = 1; i <= 3; ++i) {
+        rapidjson::Document doc;
+        doc.SetObject();
+        doc.AddMember("value", i, doc.GetAllocator());
+        doc.AddMember("other", i * 10, doc.GetAllocator());
+        storage.InsertScalar(i, doc);
+    }
+
+    auto res = storage.MultiGetScalar({3, 4, 1}, {"value"});
+    ASSERT_EQ(res.size(), 3);
+    EXPECT_EQ(res[0]["value"], 3);
+    EXPECT_FALSE(res[0].HasMember("other"));
+    EXPECT_FALSE(res[1].IsObject());
+    EXPECT_EQ(res[2]["value"], 1);
+
+    auto full = storage.MultiGetScalar({2});
+    EXPECT_EQ(full[0]["other"], 20);
+}
+
+// NOLINTNEXTLINE
+TEST(ScalarTest, ParallelMultiGetTest){
+    VdbServerInit(1);
+    std::experimental::filesystem::remove_all(Cfg::Instance().TestRocksDbPath());
+    TaskScheduler decode_scheduler(2);
+    ScalarStorage storage(Cfg::Instance().TestRocksDbPath(), RocksDbCfg(), &decode_scheduler);
+
+    // 超过一个解码块, 在共用线程池上并行解码
+    const int n = ScalarStorage::MULTI_GET_DECODE_CHUNK * 4;
+    std::vector<uint64_t> ids;
+    for (int i = 0; i < n; ++i) {
+        rapidjson::Document doc;
+        doc.SetObject();
+        doc.AddMember("value", i, doc.GetAllocator());
+        storage.InsertScalar(i, doc);
+        ids.push_back(n - 1 - i);
+    }
+
+    auto res = storage.MultiGetScalar(ids);
+    ASSERT_EQ(res.size(), n);
+    for (int i = 0; i < n; ++i) {
+        EXPECT_EQ(res[i]["value"].GetInt(), n - 1 - i);
+    }
+}
+
+// NOLINTNEXTLINE
+TEST(ScalarTest, MigrationTest){
+    VdbServerInit(1);
+    std::experimental::filesystem::remove_all(Cfg::Instance().TestRocksDbPath());
+    {
+        // 旧格式: default column family 中十进制 key + JSON value
+        rocksdb::DB* db = nullptr;
+        rocksdb::Options options;
+        options.create_if_missing = true;
+        ASSERT_TRUE(rocksdb::DB::Open(options, Cfg::Instance().TestRocksDbPath(), &db).ok());
+        db->Put(rocksdb::WriteOptions(), "42", R"({"id":42,"vectors":[1.5],"value":7})");
+        delete db;
+    }
+
+    ScalarStorage storage(Cfg::Instance().TestRocksDbPath());
+    auto res = storage.GetScalar(42);
+    ASSERT_TRUE(res.IsObject());
+    EXPECT_EQ(res["value"], 7);
+    EXPECT_FLOAT_EQ(res["vectors"][0].GetFloat(), 1.5);
+
+    std::string version;
+    ASSERT_TRUE(storage.GetMeta(ScalarStorage::SCALAR_FORMAT_VERSION_KEY, &version));
+    EXPECT_EQ(version, std::to_string(ScalarStorage::SCALAR_FORMAT_VERSION));
+    EXPECT_FALSE(storage.Stats().empty());
+}
+
+// NOLINTNEXTLINE
+TEST(ScalarTest, MigrationKeepsUnparsableRecordTest){
+    VdbServerInit(1);
+    std::experimental::filesystem::remove_all(Cfg::Instance().TestRocksDbPath());
+    {
+        rocksdb::DB* db = nullptr;
+        rocksdb::Options options;
+        options.create_if_missing = true;
+        ASSERT_TRUE(rocksdb::DB::Open(options, Cfg::Instance().TestRocksDbPath(), &db).ok());
+        db->Put(rocksdb::WriteOptions(), "42", R"({"id":42,"value":7})");
+        db->Put(rocksdb::WriteOptions(), "43", "{not json");
+        delete db;
+    }
+
+    {
+        ScalarStorage storage(Cfg::Instance().TestRocksDbPath());
+        EXPECT_EQ(storage.GetScalar(42)["value"], 7);
+        EXPECT_FALSE(storage.GetScalar(43).IsObject());
+        std::string skipped;
+        ASSERT_TRUE(storage.GetMeta(ScalarStorage::MIGRATION_SKIPPED_KEY, &skipped));
+        EXPECT_EQ(skipped, "1");
+    }
+
+    // 转换失败的记录原样留在 default CF 中, 转换成功的旧 key 已删除
+    std::vector<rocksdb::ColumnFamilyDescriptor> descriptors = {
+        {rocksdb::kDefaultColumnFamilyName, rocksdb::ColumnFamilyOptions()},
+        {ScalarStorage::CF_VECTORS, rocksdb::ColumnFamilyOptions()},
+        {ScalarStorage::CF_ATTRIBUTES, rocksdb::ColumnFamilyOptions()},
+        {ScalarStorage::CF_META, rocksdb::ColumnFamilyOptions()},
+    };
+    std::vector<rocksdb::ColumnFamilyHandle*> handles;
+    rocksdb::DB* db = nullptr;
+    ASSERT_TRUE(rocksdb::DB::OpenForReadOnly(rocksdb::DBOptions(), Cfg::Instance().TestRocksDbPath(), descriptors,
+                                             &handles, &db).ok());
+    std::string value;
+    EXPECT_TRUE(db->Get(rocksdb::ReadOptions(), "43", &value).ok());
+    EXPECT_EQ(value, "{not json");
+    EXPECT_TRUE(db->Get(rocksdb::ReadOptions(), "42", &value).IsNotFound());
+    for (auto* handle : handles) {
+        db->DestroyColumnFamilyHandle(handle);
+    }
+    delete db;
+}
+
+// NOLINTNEXTLINE
+TEST(ScalarTest, AppliedLogIdTest){
+    VdbServerInit(1);
+    std::experimental::filesystem::remove_all(Cfg::Instance().TestRocksDbPath());
+    {
+        ScalarStorage storage(Cfg::Instance().TestRocksDbPath());
+        EXPECT_EQ(storage.AppliedLogId(), 0);
+
+        rapidjson::Document doc;
+        doc.SetObject();
+        doc.AddMember("value", 1, doc.GetAllocator());
+        storage.InsertScalar(1, doc, 5);
+        // log_id 为 0 的写入不改变已应用的日志 id
+        storage.InsertScalar(2, doc);
+        EXPECT_EQ(storage.AppliedLogId(), 5);
+
+        storage.InsertScalarBatch({{3, &doc}, {4, &doc}}, 9);
+        EXPECT_EQ(storage.AppliedLogId(), 9);
+    }
+
+    ScalarStorage storage(Cfg::Instance().TestRocksDbPath());
+    EXPECT_EQ(storage.AppliedLogId(), 9);
+    EXPECT_EQ(storage.GetScalar(4)["value"], 1);
+}
+}  // namespace vectordb
@@ -0,0 +1,78 @@
+#include "database/vector_store.h"
+#include <experimental/filesystem>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include "common/vector_init.h"
+#include "gtest/gtest.h"
+namespace vectordb {
+
+namespace {
+auto ResetStorePath(const std::string& name) -> std::string {
+  std::string dir = Cfg::Instance().TestRocksDbPath() + "_vector_store_test";
+  std::experimental::filesystem::remove_all(dir);
+  std::experimental::filesystem::create_directories(dir);
+  return dir + "/" + name;
+}
+}  // namespace
+
+// NOLINTNEXTLINE
+TEST(VectorStoreTest, SampleTest) {
+  VdbServerInit(1);
+  VectorStore store(ResetStorePath("sample"));
+  store.Put(0, {0.0, 0.0});
+  store.Put(2, {3.0, 4.0});
+  EXPECT_EQ(store.Dim(), 2);
+  EXPECT_THROW(store.Put(1, {1.0}), std::runtime_error);
+
+  std::vector<float> vec;
+  EXPECT_TRUE(store.Get(2, &vec));
+  EXPECT_FLOAT_EQ(vec[1], 4.0);
+  EXPECT_FALSE(store.Get(1, &vec));
+
+  std::vector<float> query = {0.0, 0.0};
+  std::vector<float> distances;
+  store.ComputeL2(query.data(), {2, 1, 0, -1}, &distances);
+  EXPECT_FLOAT_EQ(distances[0], 25.0);
+  EXPECT_TRUE(std::isinf(distances[1]));
+  EXPECT_FLOAT_EQ(distances[2], 0.0);
+  EXPECT_TRUE(std::isinf(distances[3]));
+
+  std::vector<float> ones = {1.0, 1.0};
+  std::vector<float> products;
+  store.ComputeInnerProduct(ones.data(), {2, 1, 0}, &products);
+  EXPECT_FLOAT_EQ(products[0], 7.0);
+  EXPECT_TRUE(std::isinf(products[1]) && products[1] < 0);
+  EXPECT_FLOAT_EQ(products[2], 0.0);
+}
+
+// NOLINTNEXTLINE
+TEST(VectorStoreTest, ReopenTest) {
+  VdbServerInit(1);
+  std::string path = ResetStorePath("reopen");
+  size_t count = VectorStore::INITIAL_CAPACITY + 10;  // 触发一次扩容
+  {
+    VectorStore store(path);
+    for (size_t i = 0; i < count; ++i) {
+      store.Put(i, {static_cast<float>(i), 1.0});
+    }
+    store.Put(5, {50.0, 2.0});  // 更新写到新槽位
+    store.Remove(7);
+    EXPECT_EQ(store.Size(), count - 1);
+  }
+
+  VectorStore store(path);
+  EXPECT_EQ(store.Dim(), 2);
+  EXPECT_EQ(store.Size(), count - 1);
+  std::vector<float> vec;
+  ASSERT_TRUE(store.Get(5, &vec));
+  EXPECT_FLOAT_EQ(vec[0], 50.0);
+  EXPECT_FALSE(store.Contains(7));
+  ASSERT_TRUE(store.Get(count - 1, &vec));
+  EXPECT_FLOAT_EQ(vec[0], static_cast<float>(count - 1));
+
+  for (size_t i = 0; i < count; ++i) {
+    EXPECT_EQ(store.Contains(i), i != 7);
+  }
+}
+}  // namespace vectordb
@@ -0,0 +1,94 @@
+#include "database/wal_record.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "common/vector_init.h"
+namespace vectordb {
+
+namespace {
+// 测试目录取自配置中的 TEST_WAL_PATH, 与它同级
+auto TestWalFile() -> std::string {
+  std::string path = Cfg::Instance().TestWalPath() + "_wal_record_test.log";
+  std::filesystem::create_directories(std::filesystem::path(path).parent_path());
+  return path;
+}
+
+void WriteWal(const std::string& path, const std::vector<std::string>& frames) {
+  std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+  file.write(WalRecord::MAGIC, sizeof(WalRecord::MAGIC));
+  for (const auto& frame : frames) {
+    file.write(frame.data(), static_cast<std::streamsize>(frame.size()));
+  }
+}
+}  // namespace
+
+// NOLINTNEXTLINE
+TEST(WalRecordTest, ReadBackTest) {
+  VdbServerInit(1);
+  std::string path = TestWalFile();
+  // payload 中带换行, 旧的按行格式无法处理
+  std::vector<std::string> frames = {WalRecord::Encode(1, WalRecord::Op::UPSERT, "a\nb"),
+                                     WalRecord::EncodeBlock({WalRecord::Encode(2, WalRecord::Op::UPSERT, "c"),
+                                                             WalRecord::Encode(3, WalRecord::Op::UPSERT, "d")}),
+                                     WalRecord::Encode(4, WalRecord::Op::UPSERT, "")};
+  WriteWal(path, frames);
+
+  WalReader reader(path);
+  ASSERT_TRUE(reader.IsOpen());
+  WalRecord::Entry entry;
+  std::vector<uint64_t> ids;
+  while (reader.Next(&entry)) {
+    ids.push_back(entry.log_id_);
+    if (entry.log_id_ == 1) {
+      EXPECT_EQ(entry.payload_, "a\nb");
+    }
+    EXPECT_EQ(entry.op_, WalRecord::Op::UPSERT);
+  }
+  EXPECT_EQ(ids, (std::vector<uint64_t>{1, 2, 3, 4}));
+  EXPECT_FALSE(reader.Corrupted());
+  EXPECT_EQ(reader.ValidOffset(), std::filesystem::file_size(path));
+  std::remove(path.c_str());
+}
+
+// NOLINTNEXTLINE
+TEST(WalRecordTest, TornTailTest) {
+  VdbServerInit(1);
+  std::string path = TestWalFile();
+  std::string first = WalRecord::Encode(1, WalRecord::Op::UPSERT, "first");
+  std::string second = WalRecord::Encode(2, WalRecord::Op::UPSERT, "second");
+
+  // 最后一帧只写了一半
+  WriteWal(path, {first, second.substr(0, second.size() - 3)});
+  {
+    WalReader reader(path);
+    WalRecord::Entry entry;
+    EXPECT_TRUE(reader.Next(&entry));
+    EXPECT_FALSE(reader.Next(&entry));
+    EXPECT_TRUE(reader.Corrupted());
+    EXPECT_EQ(reader.ValidOffset(), sizeof(WalRecord::MAGIC) + first.size());
+  }
+
+  // 校验和不匹配
+  second[second.size() - 1] ^= 0x1;
+  WriteWal(path, {first, second});
+  {
+    WalReader reader(path);
+    WalRecord::Entry entry;
+    EXPECT_TRUE(reader.Next(&entry));
+    EXPECT_FALSE(reader.Next(&entry));
+    EXPECT_TRUE(reader.Corrupted());
+  }
+
+  // 没有魔数的非空文件是旧格式
+  {
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    file << "legacy line\n";
+  }
+  WalReader legacy(path);
+  EXPECT_TRUE(legacy.IsLegacy());
+  std::remove(path.c_str());
+}
+}  // namespace vectordb
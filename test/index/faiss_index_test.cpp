@@ -107,4 +107,51 @@ TEST(IndexTest, FaissSampleTest) {
       break;
   }
 }
-}  // namespace vectordb
\ No newline at end of file
+
+// NOLINTNEXTLINE
+TEST(IndexTest, FaissTombstoneTest) {
+  auto *id_map = new faiss::IndexIDMap(new faiss::IndexFlat(1, faiss::METRIC_L2));
+  id_map->own_fields = true;
+  FaissIndex faiss_index(id_map);
+  faiss_index.InsertVectors({0.1}, 1);
+  faiss_index.InsertVectors({0.2}, 2);
+  faiss_index.InsertVectors({0.3}, 3);
+
+  // upsert: 旧行只记墓碑, 新行追加
+  faiss_index.RemoveVectors({2});
+  faiss_index.InsertVectors({0.9}, 2);
+  EXPECT_EQ(faiss_index.DeletedCount(), 1);
+
+  auto results = faiss_index.SearchVectors({0.2}, 1);
+  EXPECT_NE(results.first.at(0), 2);
+  results = faiss_index.SearchVectors({0.9}, 1);
+  EXPECT_EQ(results.first.at(0), 2);
+
+  faiss_index.Compact();
+  EXPECT_EQ(faiss_index.DeletedCount(), 0);
+  results = faiss_index.SearchVectors({0.9}, 3);
+  EXPECT_EQ(results.first.at(0), 2);
+  EXPECT_EQ(results.first.at(2), 1);
+}
+
+// NOLINTNEXTLINE
+TEST(IndexTest, FaissRangeSearchTest) {
+  auto *id_map = new faiss::IndexIDMap(new faiss::IndexFlat(1, faiss::METRIC_L2));
+  id_map->own_fields = true;
+  FaissIndex faiss_index(id_map);
+  for (int i = 1; i <= 5; ++i) {
+    faiss_index.InsertVectors({static_cast<float>(i)}, i);
+  }
+  faiss_index.RemoveVectors({2});
+
+  // 半径为 L2 平方距离: 距离 0 的 id 3, 距离 1 的 id 4(2 已删除)
+  auto results = faiss_index.RangeSearchVectors({3.0}, 1.5, 10);
+  ASSERT_EQ(results.first.size(), 2);
+  EXPECT_EQ(results.first[0], 3);
+  EXPECT_EQ(results.first[1], 4);
+
+  results = faiss_index.RangeSearchVectors({3.0}, 5.0, 2);
+  EXPECT_EQ(results.first.size(), 2);
+  EXPECT_EQ(results.first[0], 3);
+}
+}  // namespace vectordb
@@ -5,6 +5,7 @@
 #include "gtest/gtest.h"
 #include "index/index_factory.h"
 #include "common/vector_init.h"
+#include <experimental/filesystem>
 namespace vectordb {
 // NOLINTNEXTLINE
 TEST(IndexTest, HNSWSampleTest) {
@@ -79,4 +80,64 @@ TEST(IndexTest, HNSWSampleTest) {
 
   
 }
-}  // namespace vectordb
\ No newline at end of file
+
+// NOLINTNEXTLINE
+TEST(IndexTest, HNSWCompactTest) {
+  HNSWLibIndex hnsw_index(2, 8, IndexFactory::MetricType::L2);
+  for (int64_t i = 0; i < 8; ++i) {
+    hnsw_index.InsertVectors({static_cast<float>(i), 0}, i);
+  }
+  // upsert 已存在的 id 不产生墓碑
+  hnsw_index.RemoveVectors({3});
+  hnsw_index.InsertVectors({3.1, 0}, 3);
+  EXPECT_EQ(hnsw_index.DeletedRatio(), 0);
+
+  // 新 id 复用被删除的槽位, 容量已满也不会抛异常
+  hnsw_index.RemoveVectors({0, 1});
+  hnsw_index.InsertVectors({100, 0}, 100);
+  EXPECT_GT(hnsw_index.DeletedRatio(), 0);
+
+  hnsw_index.Compact();
+  EXPECT_EQ(hnsw_index.DeletedRatio(), 0);
+
+  auto results = hnsw_index.SearchVectors({100, 0}, 1);
+  EXPECT_EQ(results.first.at(0), 100);
+  results = hnsw_index.SearchVectors({0, 0}, 1);
+  EXPECT_EQ(results.first.at(0), 2);
+}
+
+// NOLINTNEXTLINE
+TEST(IndexTest, HNSWCompactAfterReloadTest) {
+  Init();
+  std::experimental::filesystem::create_directories(Cfg::Instance().TestSnapPath());
+  std::string path =
+      (std::experimental::filesystem::path(Cfg::Instance().TestSnapPath()) / "hnsw_reload.index").string();
+  HNSWLibIndex hnsw_index(2, 8, IndexFactory::MetricType::L2);
+  for (int64_t i = 0; i < 8; ++i) {
+    hnsw_index.InsertVectors({static_cast<float>(i), 0}, i);
+  }
+  hnsw_index.SaveIndex(path);
+
+  // 重新加载后重建基于加载的数据, 加载前的删除不会被重放到新图上
+  hnsw_index.RemoveVectors({0, 1, 2});
+  hnsw_index.LoadIndex(path);
+  hnsw_index.Compact();
+  EXPECT_EQ(hnsw_index.DeletedRatio(), 0);
+  EXPECT_EQ(hnsw_index.SearchVectors({0, 0}, 1).first.at(0), 0);
+}
+
+// NOLINTNEXTLINE
+TEST(IndexTest, SharedCompactSchedulerTest) {
+  TaskScheduler scheduler(1);
+  {
+    // 多个组的索引共用一个压缩线程, IndexFactory 析构时删除索引并把它们移出线程池
+    IndexFactory first(&scheduler);
+    IndexFactory second(&scheduler);
+    first.InitAll(2, 8);
+    second.InitAll(2, 8);
+    auto *hnsw_index = static_cast<HNSWLibIndex *>(second.GetIndex(IndexFactory::IndexType::HNSW));
+    hnsw_index->InsertVectors({1, 0}, 1);
+    EXPECT_EQ(hnsw_index->SearchVectors({1, 0}, 1).first.at(0), 1);
+  }
+}
+}  // namespace vectordb
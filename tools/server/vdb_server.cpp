@@ -1,4 +1,5 @@
 #include <string>
+#include "cluster/raft_group_manager.h"
 #include "common/vector_cfg.h"
 #include "common/vector_init.h"
 #include "httpserver/http_server.h"
@@ -19,21 +20,14 @@ auto main(int argc, char *argv[]) -> int {
 
   // 创建并启动HTTP服务器
 
-  vectordb::VectorDatabase vector_database(vectordb::Cfg::Instance().RocksDbPath(),
-                                           vectordb::Cfg::Instance().WalPath());
-  vector_database.ReloadDatabase();
-  vectordb::global_logger->info("VectorDatabase initialized");
-
-  int raft_node_id = vectordb::Cfg::Instance().RaftNodeId();
-  std::string endpoint = vectordb::Cfg::Instance().RaftEndpoint();
-  int raft_port = vectordb::Cfg::Instance().RaftPort();
-
-  vectordb::RaftStuff raft_stuff(raft_node_id, endpoint, raft_port, &vector_database);
-  vectordb::global_logger->info("RaftStuff object created with node_id: {}, endpoint: {}, port: {}", raft_node_id, endpoint,
-                                raft_port);  // 添加调试日志
+  // 每个 raft 组各有一个 VectorDatabase 和 RaftStuff, 组 0 使用配置中的目录和端口
+  vectordb::RaftGroupManager raft_groups;
+  raft_groups.Init();
+  vectordb::global_logger->info("{} raft groups initialized on node {}", raft_groups.Groups().size(),
+                                vectordb::Cfg::Instance().RaftNodeId());
 
   vectordb::HttpServer server;
-  server.Init(&vector_database, &raft_stuff);
+  server.Init(&raft_groups);
   vectordb::global_logger->info("HttpServer created");
 
   std::string server_addr =